@@ -0,0 +1,46 @@
+#include <algorithm>
+#include "NetworkPool.h"
+#include "Utils/Trace.h"
+
+NetworkPool::NetworkPool()
+{
+}
+
+NetworkPool::~NetworkPool()
+{
+	Stop();
+	Wait();
+}
+
+void NetworkPool::Start(unsigned int threadCount)
+{
+	if (!threadCount)
+		threadCount = std::clamp(std::thread::hardware_concurrency() / 2, 2u, 8u);
+
+	work = std::make_unique<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>>(ctx.get_executor());
+	for (unsigned int i = 0; i < threadCount; ++i)
+	{
+		threads.emplace_back([this]()
+			{
+				TRACE_THREAD_NAME("network");
+				ctx.run();
+			});
+	}
+}
+
+void NetworkPool::Stop()
+{
+	work.reset();
+	ctx.stop();
+}
+
+void NetworkPool::Wait()
+{
+	threads.clear();
+	ctx.restart();
+}
+
+void NetworkPool::Dispatch(boost::asio::awaitable<void>&& coroutine)
+{
+	boost::asio::co_spawn(ctx, std::move(coroutine), boost::asio::detached);
+}
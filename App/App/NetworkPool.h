@@ -0,0 +1,33 @@
+#pragma once
+#include <memory>
+#include <thread>
+#include <vector>
+#include "Utils/Boost.h"
+#include <boost/asio.hpp>
+
+// Threads running the HTTP/WebSocket stack, apart from the RealTimeThread. This only keeps network load
+// from delaying ticks when there are cores to spare; with fewer than 4 hardware threads the pool competes
+// with the tick thread instead, see Bench/TickLoadBench. One io_context run by all threads; each connection is bound to its own strand, so its
+// handlers never run concurrently while different connections progress in parallel.
+class NetworkPool
+{
+private:
+	boost::asio::io_context ctx;
+	std::unique_ptr<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> work;
+	std::vector<std::jthread> threads;
+
+public:
+	NetworkPool();
+	~NetworkPool();
+
+	// 0 - half of the hardware threads, 2 to 8
+	void Start(unsigned int threadCount = 0);
+	void Stop();
+	void Wait();
+
+	unsigned int GetThreadCount() const { return (unsigned int)threads.size(); }
+	boost::asio::io_context::executor_type GetExecutor() { return ctx.get_executor(); }
+
+	// Runs the coroutine on the pool; it is sequential by itself, state shared with other coroutines needs a strand
+	void Dispatch(boost::asio::awaitable<void>&& coroutine);
+};
@@ -1,6 +1,18 @@
+#include <algorithm>
+#include <cmath>
 #include "RealTimeThread.h"
+#include "Utils/Logger.h"
+#include "Utils/Trace.h"
 
-RealTimeThread::RealTimeThread()
+using Clock = std::chrono::steady_clock;
+
+static uint64_t ToMicros(Clock::duration duration)
+{
+	return (uint64_t)std::max<long long>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count(), 0);
+}
+
+RealTimeThread::RealTimeThread() : work(ctx.get_executor()), period(std::chrono::milliseconds(20)), overrunPolicy(OverrunPolicy::Skip),
+	wakeRequested(false), stats{}, unloggedOverruns(0)
 {
 }
 
@@ -12,16 +24,74 @@ void RealTimeThread::Start()
 {
 	thread = std::jthread([this](std::stop_token token)
 		{
+			TRACE_THREAD_NAME("tick");
+			auto deadline = Clock::now();
 			while (!token.stop_requested())
 			{
-				if (Tick)
-					Tick();
+				if (wakeRequested.exchange(false) && Clock::now() < deadline)
+					RunWakeup();
+				else
+					deadline = RunTick(deadline);
 
-				ctx.run_for(std::chrono::milliseconds(20));
+				// I/O until the next deadline or a wake up; 0 handlers run means the deadline passed or the context stopped
+				while (!wakeRequested.load(std::memory_order_relaxed) && ctx.run_one_until(deadline))
+					;
 			}
 		});
 }
 
+// Returns the next deadline
+Clock::time_point RealTimeThread::RunTick(Clock::time_point deadline)
+{
+	auto start = Clock::now();
+	stats.lateness.Record(ToMicros(start - deadline));
+
+	if (Tick)
+	{
+		TRACE_SCOPE("tick");
+		Tick();
+	}
+
+	auto end = Clock::now();
+	stats.duration.Record(ToMicros(end - start));
+	++stats.ticks;
+
+	if (end - start > period)
+	{
+		++stats.overruns;
+		++unloggedOverruns;
+		if (end - lastOverrunLog >= std::chrono::seconds(1))
+		{
+			Logger::LogWarn("Tick overrun: {:.1f} ms, period {:.1f} ms ({} since last report)", ToMicros(end - start) / 1000.0, ToMicros(period) / 1000.0, unloggedOverruns);
+			lastOverrunLog = end;
+			unloggedOverruns = 0;
+		}
+	}
+
+	deadline += period;
+	if (end >= deadline)
+	{
+		// behind by 'missed' periods: run them back to back, or drop them and stay on the period grid
+		auto missed = (unsigned long long)((end - deadline) / period) + 1;
+		if (overrunPolicy == OverrunPolicy::Skip || missed > MaxCatchUp)
+		{
+			deadline += missed * period;
+			stats.skippedTicks += missed;
+		}
+	}
+	return deadline;
+}
+
+void RealTimeThread::RunWakeup()
+{
+	++stats.wakeups;
+	if (Wakeup)
+	{
+		TRACE_SCOPE("wakeup");
+		Wakeup();
+	}
+}
+
 void RealTimeThread::Stop()
 {
 	if (thread.joinable())
@@ -40,7 +110,35 @@ bool RealTimeThread::IsStopping()
 	return thread.get_stop_token().stop_requested();
 }
 
+void RealTimeThread::SetRate(unsigned int hz)
+{
+	hz = std::clamp(hz, 1u, 1000u);
+	period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / hz));
+}
+
+unsigned int RealTimeThread::GetRate() const
+{
+	return (unsigned int)std::lround(1.0 / std::chrono::duration<double>(period).count());
+}
+
+void RealTimeThread::Wake()
+{
+	// one pending wake up is enough, the posted handler only breaks run_one_until
+	if (!wakeRequested.exchange(true))
+		boost::asio::post(ctx, []() {});
+}
+
+void RealTimeThread::ResetStats()
+{
+	stats = {};
+}
+
 void RealTimeThread::Dispatch(boost::asio::awaitable<void>&& coroutine)
 {
 	boost::asio::co_spawn(ctx, std::move(coroutine), boost::asio::detached);
 }
+
+void RealTimeThread::Post(std::function<void()>&& task)
+{
+	boost::asio::post(ctx, std::move(task));
+}
@@ -1,15 +1,51 @@
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include "Utils/Boost.h"
 #include <boost/asio.hpp>
 #include "Utils/Function.hpp"
+#include "Utils/Histogram.h"
 
+// Calls Tick at a fixed rate against absolute deadlines and runs the io_context in between.
+// A late tick does not shift the schedule: missed ticks are caught up back to back (up to MaxCatchUp)
+// or skipped to the next period boundary. Wake() runs Wakeup, not Tick, right away without moving the schedule.
 class RealTimeThread
 {
+public:
+	enum class OverrunPolicy
+	{
+		CatchUp,
+		Skip,
+	};
+
+	struct Stats
+	{
+		Histogram duration; // Tick() run time, us
+		Histogram lateness; // tick start after its deadline, us
+		unsigned long long ticks;
+		unsigned long long wakeups; // Wakeup() runs between ticks, from Wake()
+		unsigned long long skippedTicks;
+		unsigned long long overruns; // Tick() longer than the period
+	};
+
 private:
 	std::jthread thread;
 	boost::asio::io_context ctx;
+	boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work; // keeps run_one_until waiting, not spinning
+	std::chrono::steady_clock::duration period;
+	OverrunPolicy overrunPolicy;
+	std::atomic_bool wakeRequested;
+	Stats stats;
+	std::chrono::steady_clock::time_point lastOverrunLog;
+	unsigned long long unloggedOverruns;
+
+	std::chrono::steady_clock::time_point RunTick(std::chrono::steady_clock::time_point deadline);
+	void RunWakeup();
 
 public:
+	static constexpr unsigned int MaxCatchUp = 5;
+
 	RealTimeThread();
 	~RealTimeThread();
 
@@ -18,7 +54,24 @@ public:
 	void Wait();
 	bool IsStopping();
 
+	// Call before Start, or from the thread itself
+	void SetRate(unsigned int hz);
+	unsigned int GetRate() const;
+	void SetOverrunPolicy(OverrunPolicy policy) { overrunPolicy = policy; }
+	OverrunPolicy GetOverrunPolicy() const { return overrunPolicy; }
+
+	// Thread safe: runs Wakeup as soon as the current handler returns, e.g. when simulator data is waiting.
+	// Past the deadline the regular tick runs instead.
+	void Wake();
+
+	// From the thread itself
+	const Stats& GetStats() const { return stats; }
+	void ResetStats();
+
 	void Dispatch(boost::asio::awaitable<void>&& coroutine);
+	void Post(std::function<void()>&& task);
+	boost::asio::io_context::executor_type GetExecutor() { return ctx.get_executor(); }
 
 	FunctionS<void()> Tick;
+	FunctionS<void()> Wakeup; // light work only, the periodic work belongs to Tick
 };
@@ -0,0 +1,261 @@
+// Tick latency while large files are downloaded: a 1 ms deadline timer runs on the thread that accepts
+// the connections, as the tick thread did before the network pool, and each mode serves the same file:
+// - file_body: Beast reads the file and writes the body on that thread
+// - FileSender: only the header is written there, the body goes out with sendfile() from the sender thread
+// Lateness depends on the machine's timer jitter, so an idle run gives its floor; CPU time the accepting
+// thread spends per GB served is the steadier number.
+//
+//   cmake -S App -B build -DMAPLEBERRY_BENCH=ON && cmake --build build --target FileSenderBench && build/Bench/FileSenderBench
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Utils/Boost.h"
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include "HttpServer/FileSender.hpp"
+#include "Utils/Histogram.h"
+#include "Utils/Time.h"
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <Windows.h>
+#endif
+
+using tcp = boost::asio::ip::tcp;
+namespace http = boost::beast::http;
+using namespace std::chrono_literals;
+
+static constexpr uint64_t FileSize = 64 << 20;
+static constexpr unsigned int Clients = 4;
+static constexpr unsigned int DownloadsPerClient = 8;
+
+enum class Mode
+{
+	Idle,
+	FileBody,
+	FileSender,
+};
+
+struct Result
+{
+	Histogram lateness; // us
+	double seconds = 0;
+	double tickCpu = 0; // seconds
+	uint64_t bytes = 0;
+};
+
+static double ThreadCpuSeconds()
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+	auto ticks = [](FILETIME t) { return ((unsigned long long)t.dwHighDateTime << 32) | t.dwLowDateTime; };
+	return (ticks(kernel) + ticks(user)) * 1e-7;
+#else
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+static boost::asio::awaitable<void> TickLoop(Histogram& lateness, const bool& stop)
+{
+	boost::asio::steady_timer timer(co_await boost::asio::this_coro::executor);
+	auto deadline = std::chrono::steady_clock::now();
+	while (!stop)
+	{
+		deadline += 1ms;
+		timer.expires_at(deadline);
+		co_await timer.async_wait(boost::asio::use_awaitable);
+
+		auto now = std::chrono::steady_clock::now();
+		lateness.Record(std::chrono::duration_cast<std::chrono::microseconds>(now - deadline).count());
+		if (now - deadline > 1ms)
+			deadline = now; // missed ticks are skipped, not caught up
+	}
+}
+
+static boost::asio::awaitable<void> Serve(tcp::socket socket, FileSender* sender, std::string path)
+{
+	boost::beast::error_code ec;
+	boost::beast::flat_buffer buffer;
+	http::request<http::empty_body> request;
+	co_await http::async_read(socket, buffer, request, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+	if (ec)
+		co_return;
+
+	http::file_body::value_type file;
+	file.open(path.c_str(), boost::beast::file_mode::scan, ec);
+	if (ec)
+		co_return;
+
+	auto size = file.size();
+	if (sender)
+	{
+		http::response<http::empty_body> response{ http::status::ok, request.version() };
+		response.content_length(size);
+		co_await http::async_write(socket, response, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+		if (!ec)
+			ec = co_await sender->Send(socket, file.file().native_handle(), 0, size, 30s);
+	}
+	else
+	{
+		http::response<http::file_body> response{
+			std::piecewise_construct,
+			std::make_tuple(std::move(file)),
+			std::make_tuple(http::status::ok, request.version()),
+		};
+		response.content_length(size);
+		co_await http::async_write(socket, response, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+	}
+
+	socket.shutdown(tcp::socket::shutdown_send, ec);
+}
+
+static boost::asio::awaitable<void> Accept(tcp::acceptor& acceptor, FileSender* sender, std::string path)
+{
+	auto ctx = co_await boost::asio::this_coro::executor;
+	while (true)
+	{
+		boost::beast::error_code ec;
+		auto socket = co_await acceptor.async_accept(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+		if (ec)
+			co_return;
+		boost::asio::co_spawn(ctx, Serve(std::move(socket), sender, path), boost::asio::detached);
+	}
+}
+
+static uint64_t Download(tcp::endpoint endpoint)
+{
+	boost::asio::io_context ioc;
+	std::vector<char> data(256 << 10);
+	const std::string request = "GET /file HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+	uint64_t total = 0;
+
+	for (unsigned int i = 0; i < DownloadsPerClient; i++)
+	{
+		tcp::socket socket(ioc);
+		socket.connect(endpoint);
+		boost::asio::write(socket, boost::asio::buffer(request));
+
+		std::string header;
+		bool inBody = false;
+		uint64_t body = 0;
+		boost::beast::error_code ec;
+		while (body < FileSize)
+		{
+			auto read = socket.read_some(boost::asio::buffer(data), ec);
+			if (ec)
+				break;
+			if (inBody)
+			{
+				body += read;
+				continue;
+			}
+
+			header.append(data.data(), read);
+			auto end = header.find("\r\n\r\n");
+			if (end != std::string::npos)
+			{
+				inBody = true;
+				body = header.size() - end - 4;
+			}
+		}
+
+		if (body != FileSize)
+			std::fprintf(stderr, "download %u: got %llu of %llu bytes\n", i, (unsigned long long)body, (unsigned long long)FileSize);
+		total += body;
+	}
+	return total;
+}
+
+static Result Run(Mode mode, const std::string& path)
+{
+	Result result;
+	bool stop = false;
+	boost::asio::io_context tick(1);
+	tcp::acceptor acceptor(tick, { boost::asio::ip::make_address("127.0.0.1"), 0 });
+	std::unique_ptr<FileSender> sender;
+	if (mode == Mode::FileSender)
+		sender = std::make_unique<FileSender>();
+
+	boost::asio::co_spawn(tick, TickLoop(result.lateness, stop), boost::asio::detached);
+	boost::asio::co_spawn(tick, Accept(acceptor, sender.get(), path), boost::asio::detached);
+	std::thread tickThread([&]()
+		{
+			auto cpu = ThreadCpuSeconds();
+			tick.run();
+			result.tickCpu = ThreadCpuSeconds() - cpu;
+		});
+
+	auto start = Time::SteadyNow();
+	if (mode == Mode::Idle)
+		std::this_thread::sleep_for(2s);
+	else
+	{
+		std::vector<std::thread> clients;
+		std::vector<uint64_t> bytes(Clients);
+		for (unsigned int i = 0; i < Clients; i++)
+			clients.emplace_back([&, i]() { bytes[i] = Download(acceptor.local_endpoint()); });
+		for (auto& client : clients)
+			client.join();
+		for (auto b : bytes)
+			result.bytes += b;
+	}
+	result.seconds = (Time::SteadyNow() - start) / 1000;
+
+	boost::asio::post(tick, [&]()
+		{
+			stop = true;
+			acceptor.close();
+		});
+	tickThread.join();
+	return result;
+}
+
+int main()
+{
+	auto path = (std::filesystem::temp_directory_path() / "mapleberry-filesender-bench.bin").string();
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		std::vector<char> block(1 << 20);
+		for (size_t i = 0; i < block.size(); i++)
+			block[i] = (char)(i * 31);
+		for (uint64_t written = 0; written < FileSize; written += block.size())
+			file.write(block.data(), block.size());
+	}
+
+	std::printf("%u clients x %u downloads of %llu MB, 1 ms tick on the accepting thread\n", Clients, DownloadsPerClient, (unsigned long long)(FileSize >> 20));
+	std::printf("%-12s %10s %12s | %10s %10s %10s %10s %8s\n", "", "MB/s", "tick cpu/GB", "late p50", "p99", "p99.9", "max us", "ticks");
+
+	const std::pair<Mode, const char*> modes[] = {
+		{ Mode::Idle, "idle" },
+		{ Mode::FileBody, "file_body" },
+		{ Mode::FileSender, "FileSender" },
+	};
+	for (auto [mode, name] : modes)
+	{
+		if (mode == Mode::FileSender && !FileSender::IsSupported())
+		{
+			std::printf("%-12s not supported on this platform\n", name);
+			continue;
+		}
+
+		auto result = Run(mode, path);
+		auto& h = result.lateness;
+		auto gb = result.bytes / double(1 << 30);
+		std::printf("%-12s %10.0f %10.0fms | %10llu %10llu %10llu %10llu %8llu\n", name, result.bytes / result.seconds / (1 << 20),
+			gb > 0 ? result.tickCpu * 1000 / gb : 0.0,
+			(unsigned long long)h.GetPercentile(50), (unsigned long long)h.GetPercentile(99), (unsigned long long)h.GetPercentile(99.9),
+			(unsigned long long)h.GetMax(), (unsigned long long)h.GetCount());
+	}
+
+	std::filesystem::remove(path);
+	return 0;
+}
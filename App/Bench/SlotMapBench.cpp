@@ -0,0 +1,225 @@
+// AirplaneRadar storage cost per operation: the SlotMap + ObjectId index used now against the
+// std::vector with linear lookup and erase it replaced. Sizes span a quiet airport to a busy region.
+//
+//   cmake -S App -B build -DMAPLEBERRY_BENCH=ON && cmake --build build --target SlotMapBench && build/Bench/SlotMapBench
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "Utils/SlotMap.h"
+#include "Utils/Time.h"
+
+// Same layout as Airplane in TrafficRadar/AirplaneRadar.cpp
+struct BenchAirplane
+{
+	SlotHandle handle{};
+	unsigned int objId{};
+	double spawnTime{};
+	bool isUser = false;
+	bool spawned = false;
+
+	unsigned int identId{};
+	char callsign[16]{};
+	char model[8]{};
+
+	unsigned int radarId{};
+	bool tracked = false;
+};
+
+struct Result
+{
+	double add = 0;
+	double update = 0;
+	double remove = 0;
+};
+
+static constexpr int Rounds = 7;
+static constexpr size_t UpdatesPerRound = 200000;
+static constexpr size_t OpsPerRound = 100000; // small fleets repeat add/remove so the timer resolution does not dominate
+
+// Sim object ids are sparse and not ordered
+static std::vector<unsigned int> MakeIds(size_t count, std::mt19937& rng)
+{
+	std::vector<unsigned int> ids(count);
+	std::iota(ids.begin(), ids.end(), 1u);
+	for (auto& id : ids)
+		id = id * 7919 + 100;
+	std::shuffle(ids.begin(), ids.end(), rng);
+	return ids;
+}
+
+static Result RunSlotMap(size_t count, std::mt19937& rng)
+{
+	Result best{ 1e30, 1e30, 1e30 };
+	for (int round = 0; round < Rounds; round++)
+	{
+		auto ids = MakeIds(count, rng);
+		SlotMap<BenchAirplane> airplanes;
+		std::unordered_map<unsigned int, SlotHandle> index;
+		auto reps = std::max<size_t>(1, OpsPerRound / count);
+
+		auto add = [&]()
+			{
+				for (auto id : ids)
+				{
+					auto handle = airplanes.Insert({});
+					index[id] = handle;
+					auto& airplane = *airplanes.Get(handle);
+					airplane.handle = handle;
+					airplane.objId = id;
+				}
+			};
+		auto remove = [&]()
+			{
+				for (auto id : ids)
+				{
+					auto i = index.find(id);
+					auto handle = i->second;
+					index.erase(i);
+					airplanes.Remove(handle);
+				}
+			};
+
+		double addTime = 0, removeTime = 0;
+		for (size_t rep = 1; rep < reps; rep++)
+		{
+			auto start = Time::SteadyNow();
+			add();
+			auto added = Time::SteadyNow();
+			std::shuffle(ids.begin(), ids.end(), rng);
+			auto removeStart = Time::SteadyNow();
+			remove();
+			auto removed = Time::SteadyNow();
+			addTime += added - start;
+			removeTime += removed - removeStart;
+		}
+		auto start = Time::SteadyNow();
+		add();
+		addTime += Time::SteadyNow() - start;
+
+		// Request callbacks carry the handle, see AirplaneRadar::Track
+		std::vector<SlotHandle> handles;
+		for (auto id : ids)
+			handles.push_back(index[id]);
+		std::uniform_int_distribution<size_t> pick(0, count - 1);
+		std::vector<size_t> order(UpdatesPerRound);
+		for (auto& i : order)
+			i = pick(rng);
+
+		auto updateStart = Time::SteadyNow();
+		for (auto i : order)
+		{
+			if (auto airplane = airplanes.Get(handles[i]))
+				airplane->spawnTime += 1.0;
+		}
+		auto updated = Time::SteadyNow();
+
+		std::shuffle(ids.begin(), ids.end(), rng);
+		auto removeStart = Time::SteadyNow();
+		remove();
+		removeTime += Time::SteadyNow() - removeStart;
+
+		best.add = std::min(best.add, addTime / (count * reps));
+		best.update = std::min(best.update, (updated - updateStart) / UpdatesPerRound);
+		best.remove = std::min(best.remove, removeTime / (count * reps));
+	}
+	return best;
+}
+
+static Result RunVector(size_t count, std::mt19937& rng)
+{
+	Result best{ 1e30, 1e30, 1e30 };
+	auto find = [](std::vector<BenchAirplane>& airplanes, unsigned int id)
+		{
+			return std::find_if(airplanes.begin(), airplanes.end(), [id](auto& a) { return a.objId == id; });
+		};
+
+	for (int round = 0; round < Rounds; round++)
+	{
+		auto ids = MakeIds(count, rng);
+		std::vector<BenchAirplane> airplanes;
+		auto reps = std::max<size_t>(1, OpsPerRound / count);
+
+		auto add = [&]()
+			{
+				for (auto id : ids)
+				{
+					if (find(airplanes, id) != airplanes.end())
+						continue;
+					airplanes.emplace_back().objId = id;
+				}
+			};
+		auto remove = [&]()
+			{
+				for (auto id : ids)
+				{
+					auto airplane = find(airplanes, id);
+					if (airplane != airplanes.end())
+						airplanes.erase(airplane);
+				}
+			};
+
+		double addTime = 0, removeTime = 0;
+		for (size_t rep = 1; rep < reps; rep++)
+		{
+			auto start = Time::SteadyNow();
+			add();
+			auto added = Time::SteadyNow();
+			std::shuffle(ids.begin(), ids.end(), rng);
+			auto removeStart = Time::SteadyNow();
+			remove();
+			auto removed = Time::SteadyNow();
+			addTime += added - start;
+			removeTime += removed - removeStart;
+		}
+		auto start = Time::SteadyNow();
+		add();
+		addTime += Time::SteadyNow() - start;
+
+		std::uniform_int_distribution<size_t> pick(0, count - 1);
+		std::vector<unsigned int> order(UpdatesPerRound);
+		for (auto& id : order)
+			id = ids[pick(rng)];
+
+		// Large fleets would take minutes at full length; per-op cost is what is reported
+		auto updates = std::min(UpdatesPerRound, std::max<size_t>(1000, 20000000 / count));
+		auto updateStart = Time::SteadyNow();
+		for (size_t i = 0; i < updates; i++)
+		{
+			auto airplane = find(airplanes, order[i]);
+			if (airplane != airplanes.end())
+				airplane->spawnTime += 1.0;
+		}
+		auto updated = Time::SteadyNow();
+
+		std::shuffle(ids.begin(), ids.end(), rng);
+		auto removeStart = Time::SteadyNow();
+		remove();
+		removeTime += Time::SteadyNow() - removeStart;
+
+		best.add = std::min(best.add, addTime / (count * reps));
+		best.update = std::min(best.update, (updated - updateStart) / updates);
+		best.remove = std::min(best.remove, removeTime / (count * reps));
+	}
+	return best;
+}
+
+int main()
+{
+	std::mt19937 rng(12345);
+	const size_t sizes[] = { 10, 100, 1000, 10000 };
+
+	std::printf("ns/op, best of %d rounds\n", Rounds);
+	std::printf("%8s | %10s %10s %10s | %10s %10s %10s\n", "aircraft", "slot add", "update", "remove", "vec add", "update", "remove");
+	for (auto count : sizes)
+	{
+		auto slot = RunSlotMap(count, rng);
+		auto vec = RunVector(count, rng);
+		std::printf("%8zu | %10.1f %10.1f %10.1f | %10.1f %10.1f %10.1f\n", count,
+			slot.add * 1e6, slot.update * 1e6, slot.remove * 1e6,
+			vec.add * 1e6, vec.update * 1e6, vec.remove * 1e6);
+	}
+	return 0;
+}
@@ -0,0 +1,200 @@
+// Tick cadence under WebSocket load: a RealTimeThread at the shipping rate sends conflated aircraft updates
+// to 64 connected clients every tick, with the sockets' I/O either on the tick thread itself, as before the
+// network pool, or on a NetworkPool with the tick thread as owner, as WebCast sets them up now.
+// Clients are Beast sockets on two threads of their own that read and discard.
+// Needs 4 or more hardware threads to say anything about the pool: below that its threads, the clients and
+// the tick thread share the cores, and the pool run comes out slower.
+//
+//   cmake -S App -B build -DMAPLEBERRY_BENCH=ON && cmake --build build --target TickLoadBench && build/Bench/TickLoadBench
+#include <atomic>
+#include <cstdio>
+#include <list>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "Utils/Boost.h"
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include "App/NetworkPool.h"
+#include "App/RealTimeThread.h"
+#include "HttpServer/WebSocket.hpp"
+#include "Utils/SharedBuffer.h"
+#include "Utils/Time.h"
+
+using tcp = boost::asio::ip::tcp;
+namespace websocket = boost::beast::websocket;
+using namespace std::chrono_literals;
+
+static constexpr unsigned int Clients = 64;
+static constexpr unsigned int Aircraft = 200; // one keyed update each per tick
+static constexpr size_t UpdateSize = 64;
+static constexpr auto RunTime = 5s;
+
+// Tick is a FunctionS, so the state it works on is file scope
+static std::list<WebSocket>* sockets;
+static std::vector<SharedBuffer> updates;
+static std::atomic_bool sending;
+
+static void OnTick()
+{
+	if (!sending)
+		return;
+
+	for (unsigned int i = 0; i < Aircraft; i++)
+	{
+		for (auto& ws : *sockets)
+			ws.Send(updates[i], i + 1);
+	}
+}
+
+struct Result
+{
+	RealTimeThread::Stats stats;
+	unsigned int rate;
+	double framesPerSecond;
+};
+
+struct ClientSide
+{
+	boost::asio::io_context ctx;
+	std::vector<std::unique_ptr<websocket::stream<tcp::socket>>> streams;
+	std::atomic<unsigned long long> frames{ 0 };
+	std::vector<std::thread> threads;
+
+	static boost::asio::awaitable<void> Read(websocket::stream<tcp::socket>& ws, std::atomic<unsigned long long>& frames)
+	{
+		boost::beast::flat_buffer buffer;
+		boost::beast::error_code ec;
+		while (true)
+		{
+			co_await ws.async_read(buffer, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+			if (ec)
+				break;
+			buffer.clear();
+			frames.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+};
+
+static Result Run(bool networkPool)
+{
+	RealTimeThread thread;
+	NetworkPool network;
+	boost::asio::io_context setup;
+	tcp::acceptor acceptor(setup, { boost::asio::ip::make_address("127.0.0.1"), 0 });
+
+	// handshakes one by one: the client thread connects while this one accepts
+	ClientSide clients;
+	std::thread connector([&]()
+		{
+			for (unsigned int i = 0; i < Clients; i++)
+			{
+				auto& ws = clients.streams.emplace_back(std::make_unique<websocket::stream<tcp::socket>>(clients.ctx));
+				ws->next_layer().connect(acceptor.local_endpoint());
+				ws->handshake("127.0.0.1", "/");
+			}
+		});
+
+	sockets = new std::list<WebSocket>();
+	for (unsigned int i = 0; i < Clients; i++)
+	{
+		auto executor = networkPool ? boost::asio::make_strand(network.GetExecutor()) : boost::asio::any_io_executor(thread.GetExecutor());
+		websocket::stream<boost::beast::tcp_stream> ws(acceptor.accept(executor));
+		ws.accept();
+		sockets->emplace_back(std::move(ws), boost::beast::flat_buffer(), thread.GetExecutor()).RunAsync();
+	}
+	connector.join();
+
+	for (auto& ws : clients.streams)
+		boost::asio::co_spawn(clients.ctx, ClientSide::Read(*ws, clients.frames), boost::asio::detached);
+	for (int i = 0; i < 2; i++)
+		clients.threads.emplace_back([&]() { clients.ctx.run(); });
+
+	thread.Tick = &OnTick;
+	sending = true;
+	if (networkPool)
+		network.Start();
+	thread.Start();
+
+	std::this_thread::sleep_for(1s); // queues and socket buffers settle
+	thread.Post([&thread]() { thread.ResetStats(); });
+	auto frames = clients.frames.load();
+	auto start = Time::SteadyNow();
+	std::this_thread::sleep_for(RunTime);
+
+	Result result{};
+	std::atomic_bool copied = false;
+	thread.Post([&]()
+		{
+			result.stats = thread.GetStats();
+			result.rate = thread.GetRate();
+			copied = true;
+		});
+	while (!copied)
+		std::this_thread::sleep_for(1ms);
+	result.framesPerSecond = (clients.frames.load() - frames) / ((Time::SteadyNow() - start) / 1000);
+
+	// clients hang up, the server side winds down on its own; sockets are destroyed once no task is left
+	sending = false;
+	for (auto& ws : clients.streams)
+		boost::asio::post(clients.ctx, [&ws]() { ws->async_close(websocket::close_code::normal, [](auto) {}); });
+	auto deadline = Time::SteadyNow() + 5000;
+	auto running = [&]()
+		{
+			std::atomic_bool any = false;
+			std::atomic_bool checked = false;
+			thread.Post([&]()
+				{
+					for (auto& ws : *sockets)
+						any = any || ws.IsRunning();
+					checked = true;
+				});
+			while (!checked)
+				std::this_thread::sleep_for(1ms);
+			return any.load();
+		};
+	bool stuck;
+	while ((stuck = running()) && Time::SteadyNow() < deadline)
+		std::this_thread::sleep_for(10ms);
+
+	thread.Stop();
+	thread.Wait();
+	network.Stop();
+	network.Wait();
+	clients.ctx.stop();
+	for (auto& t : clients.threads)
+		t.join();
+	if (!stuck)
+		delete sockets; // otherwise left to the OS, a task may still hold one
+	return result;
+}
+
+static void Print(const char* name, const Result& r)
+{
+	auto& s = r.stats;
+	std::printf("%-14s %6llu %9llu %6llu %8llu | %8llu %8llu %8llu | %8llu %8llu %8llu | %10.0f\n", name,
+		s.ticks, s.overruns, s.skippedTicks, s.wakeups,
+		(unsigned long long)s.lateness.GetPercentile(50), (unsigned long long)s.lateness.GetPercentile(99), (unsigned long long)s.lateness.GetMax(),
+		(unsigned long long)s.duration.GetPercentile(50), (unsigned long long)s.duration.GetPercentile(99), (unsigned long long)s.duration.GetMax(),
+		r.framesPerSecond);
+}
+
+int main()
+{
+	for (unsigned int i = 0; i < Aircraft; i++)
+		updates.push_back(SharedBuffer::Copy(std::string(UpdateSize, (char)i).data(), UpdateSize));
+
+	auto tickThread = Run(false);
+	auto networkPool = Run(true);
+
+	std::printf("%u clients, %u keyed %zu-byte updates per tick, %lld s at %u Hz, %u hardware threads\n", Clients, Aircraft, UpdateSize,
+		(long long)RunTime.count(), tickThread.rate, std::thread::hardware_concurrency());
+	std::printf("%-14s %6s %9s %6s %8s | %8s %8s %8s | %8s %8s %8s | %10s\n", "I/O on", "ticks", "overruns", "skip", "wakeups",
+		"late p50", "p99", "max us", "run p50", "p99", "max us", "frames/s");
+	Print("tick thread", tickThread);
+	Print("network pool", networkPool);
+	if (std::thread::hardware_concurrency() < 4)
+		std::printf("fewer than 4 hardware threads: the pool competes with the tick thread, not a measure of its gain\n");
+	return 0;
+}
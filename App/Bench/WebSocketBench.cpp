@@ -0,0 +1,234 @@
+// WebSocket send path throughput, in messages per second per server core: the current writer (one writer
+// coroutine per socket fed in batches, HttpServer/WebSocket.cpp) against the coroutine-per-message path it
+// replaced, kept below as LegacySocket. The server side runs on one thread and its CPU time is what is
+// divided by; clients are plain Beast sockets on their own threads that read and discard.
+//
+//   cmake -S App -B build -DMAPLEBERRY_BENCH=ON && cmake --build build --target WebSocketBench && build/Bench/WebSocketBench
+#include <cstdio>
+#include <ctime>
+#include <deque>
+#include <list>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Utils/Boost.h"
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include "HttpServer/WebSocket.hpp"
+#include "Utils/SharedBuffer.h"
+#include "Utils/Time.h"
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <Windows.h>
+#endif
+
+using tcp = boost::asio::ip::tcp;
+namespace websocket = boost::beast::websocket;
+
+static constexpr size_t Clients = 8;
+static constexpr size_t MessagesPerClient = 200000;
+static constexpr size_t MessageSize = 64; // one conflated aircraft update
+static constexpr size_t MessagesPerStep = 64; // per socket, before the producer yields to I/O
+
+static double ThreadCpuSeconds()
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+	auto ticks = [](FILETIME t) { return ((unsigned long long)t.dwHighDateTime << 32) | t.dwLowDateTime; };
+	return (ticks(kernel) + ticks(user)) * 1e-7;
+#else
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+// Send path before the single writer: every Send spawns a coroutine that queues the frame, and the first
+// frame after an idle period spawns a flush coroutine. Conflation and limits as they were, metrics left out.
+class LegacySocket
+{
+public:
+	LegacySocket(websocket::stream<boost::beast::tcp_stream>&& ws) : ws(std::move(ws)), ctx(this->ws.get_executor())
+	{
+	}
+
+	void RunAsync()
+	{
+		boost::asio::co_spawn(ctx, RunInternal(), boost::asio::detached);
+	}
+
+	void Send(const SharedBuffer& message, unsigned long long conflationKey = 0)
+	{
+		if (!ws.is_open())
+			return;
+
+		boost::asio::co_spawn(ctx, SendInternal({ message, false, conflationKey }), boost::asio::detached);
+	}
+
+private:
+	struct Frame
+	{
+		SharedBuffer buffer;
+		bool isText;
+		unsigned long long conflationKey;
+	};
+
+	boost::asio::awaitable<void> RunInternal()
+	{
+		boost::beast::flat_buffer buffer;
+		boost::beast::error_code ec;
+		while (!ec)
+			co_await ws.async_read(buffer, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+	}
+
+	boost::asio::awaitable<void> SendInternal(Frame frame)
+	{
+		if (!ws.is_open())
+			co_return;
+
+		if (!frame.conflationKey)
+			conflatedFrames.clear();
+		else
+		{
+			auto [i, inserted] = conflatedFrames.try_emplace(frame.conflationKey, sendQueueFront + sendQueue.size());
+			if (!inserted)
+			{
+				auto& queued = sendQueue[i->second - sendQueueFront];
+				queuedBytes += frame.buffer.size() - queued.buffer.size();
+				queued.buffer = std::move(frame.buffer);
+				co_return;
+			}
+		}
+
+		queuedBytes += frame.buffer.size();
+		sendQueue.push_back(std::move(frame));
+		if (!writing)
+		{
+			writing = true;
+			boost::asio::co_spawn(ctx, FlushSendInternal(), boost::asio::detached);
+		}
+	}
+
+	boost::asio::awaitable<void> FlushSendInternal()
+	{
+		while (!sendQueue.empty())
+		{
+			auto frame = std::move(sendQueue.front());
+			sendQueue.pop_front();
+			if (frame.conflationKey)
+			{
+				auto i = conflatedFrames.find(frame.conflationKey);
+				if (i != conflatedFrames.end() && i->second == sendQueueFront)
+					conflatedFrames.erase(i);
+			}
+			++sendQueueFront;
+			queuedBytes -= frame.buffer.size();
+
+			boost::beast::error_code ec;
+			ws.text(frame.isText);
+			co_await ws.async_write(boost::asio::const_buffer{ frame.buffer.data(), frame.buffer.size() }, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+			if (ec)
+				break;
+		}
+		writing = false;
+	}
+
+	websocket::stream<boost::beast::tcp_stream> ws;
+	boost::asio::any_io_executor ctx;
+	std::deque<Frame> sendQueue;
+	std::unordered_map<unsigned long long, size_t> conflatedFrames;
+	size_t sendQueueFront = 0;
+	size_t queuedBytes = 0;
+	bool writing = false;
+};
+
+static void RunClient(tcp::endpoint endpoint)
+{
+	boost::asio::io_context ioc;
+	websocket::stream<tcp::socket> ws(ioc);
+	ws.next_layer().connect(endpoint);
+	ws.handshake("127.0.0.1", "/");
+
+	boost::beast::flat_buffer buffer;
+	for (size_t i = 0; i < MessagesPerClient; i++)
+	{
+		ws.read(buffer);
+		buffer.clear();
+	}
+	ws.close(websocket::close_code::normal);
+}
+
+struct Result
+{
+	double cpu;
+	double wall;
+};
+
+template <class Socket>
+static Result Run(std::function<void(std::list<Socket>&, websocket::stream<boost::beast::tcp_stream>&&, boost::asio::any_io_executor)> create)
+{
+	boost::asio::io_context ctx(1);
+	tcp::acceptor acceptor(ctx, { boost::asio::ip::make_address("127.0.0.1"), 0 });
+
+	std::vector<std::thread> clients;
+	for (size_t i = 0; i < Clients; i++)
+		clients.emplace_back(RunClient, acceptor.local_endpoint());
+
+	std::list<Socket> sockets;
+	for (size_t i = 0; i < Clients; i++)
+	{
+		websocket::stream<boost::beast::tcp_stream> ws(acceptor.accept());
+		ws.accept();
+		create(sockets, std::move(ws), ctx.get_executor());
+	}
+
+	auto message = SharedBuffer::Copy(std::string(MessageSize, 'x').data(), MessageSize);
+	size_t sent = 0;
+	std::function<void()> produce = [&]()
+		{
+			for (size_t i = 0; i < MessagesPerStep; i++)
+			{
+				for (auto& socket : sockets)
+					socket.Send(message);
+			}
+			sent += MessagesPerStep;
+			if (sent < MessagesPerClient)
+				boost::asio::post(ctx, produce);
+		};
+	boost::asio::post(ctx, produce);
+
+	auto cpu = ThreadCpuSeconds();
+	auto wall = Time::SteadyNow();
+	ctx.run();
+	Result result{ ThreadCpuSeconds() - cpu, (Time::SteadyNow() - wall) / 1000 };
+
+	for (auto& client : clients)
+		client.join();
+	return result;
+}
+
+int main()
+{
+	static_assert(MessagesPerClient % MessagesPerStep == 0);
+
+	auto legacy = Run<LegacySocket>([](auto& sockets, auto&& ws, auto)
+		{
+			sockets.emplace_back(std::move(ws)).RunAsync();
+		});
+	auto current = Run<WebSocket>([](auto& sockets, auto&& ws, auto owner)
+		{
+			auto& socket = sockets.emplace_back(std::move(ws), boost::beast::flat_buffer(), owner);
+			socket.SetSendLimits({ SIZE_MAX, SIZE_MAX });
+			socket.RunAsync();
+		});
+
+	double messages = Clients * MessagesPerClient;
+	std::printf("%zu clients x %zu messages of %zu bytes, server on one thread\n", Clients, MessagesPerClient, MessageSize);
+	std::printf("%-26s %14s %14s %10s\n", "", "msg/s/core", "msg/s wall", "cpu s");
+	std::printf("%-26s %14.0f %14.0f %10.2f\n", "coroutine per message", messages / legacy.cpu, messages / legacy.wall, legacy.cpu);
+	std::printf("%-26s %14.0f %14.0f %10.2f\n", "single writer, batched", messages / current.cpu, messages / current.wall, current.cpu);
+	return 0;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <chrono>
+#include <memory>
+#include "Utils/Boost.h"
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core/error.hpp>
+
+// Closes the stream if still armed when the time runs out. The handler may run after the deadline is gone,
+// so the flags live in shared state and the stream is only touched while armed.
+// Touch() restarts the time on progress, for transfers of any size that must not stall; the timer is only
+// moved when it fires, so a touch costs a clock read.
+template <class Stream>
+class Deadline
+{
+public:
+	Deadline(Stream& stream, std::chrono::milliseconds timeout) : stream(stream), timer(stream.get_executor()), timeout(timeout),
+		state(std::make_shared<State>())
+	{
+		lastProgress = std::chrono::steady_clock::now();
+		Wait(lastProgress + timeout);
+	}
+
+	~Deadline()
+	{
+		state->armed = false;
+		timer.cancel();
+	}
+
+	Deadline(const Deadline&) = delete;
+	Deadline& operator=(const Deadline&) = delete;
+
+	void Touch()
+	{
+		lastProgress = std::chrono::steady_clock::now();
+	}
+
+	// Error of the guarded operation, timeout when the deadline closed the stream
+	boost::system::error_code Check(const boost::system::error_code& ec) const
+	{
+		return state->expired ? boost::system::error_code(boost::beast::error::timeout) : ec;
+	}
+
+private:
+	struct State
+	{
+		bool armed = true;
+		bool expired = false;
+	};
+
+	void Wait(std::chrono::steady_clock::time_point at)
+	{
+		timer.expires_at(at);
+		timer.async_wait([this, state = state](const boost::system::error_code& ec)
+			{
+				if (ec || !state->armed)
+					return;
+
+				auto next = lastProgress + timeout;
+				if (std::chrono::steady_clock::now() < next)
+				{
+					Wait(next);
+					return;
+				}
+
+				state->expired = true;
+				boost::system::error_code ignored;
+				stream.close(ignored);
+			});
+	}
+
+	Stream& stream;
+	boost::asio::steady_timer timer;
+	std::chrono::milliseconds timeout;
+	std::chrono::steady_clock::time_point lastProgress;
+	std::shared_ptr<State> state;
+};
@@ -0,0 +1,93 @@
+#include "FileSender.hpp"
+#include <algorithm>
+#include <boost/asio.hpp>
+#include "Deadline.hpp"
+#include "Utils/Trace.h"
+#ifdef __linux__
+#include <cerrno>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+static constexpr uint64_t MaxChunk = 4 << 20; // per sendfile call, keeps other transfers moving
+
+// Runs on the sender thread. 'socket' is a dup of the connection's socket, registered with this
+// thread's reactor only; the original stays with the connection.
+static boost::asio::awaitable<boost::system::error_code> Transfer(int socket, int file, off_t offset, uint64_t size, std::chrono::milliseconds timeout)
+{
+	boost::asio::posix::stream_descriptor stream(co_await boost::asio::this_coro::executor, socket);
+	boost::system::error_code ec;
+	stream.non_blocking(true, ec);
+	if (ec)
+		co_return ec;
+
+	// closes only the dup; the caller sees the timeout and drops the connection
+	Deadline<boost::asio::posix::stream_descriptor> deadline(stream, timeout);
+	while (size > 0)
+	{
+		auto sent = ::sendfile(socket, file, &offset, (size_t)std::min(size, MaxChunk));
+		if (sent > 0)
+		{
+			size -= sent;
+			deadline.Touch();
+			continue;
+		}
+		if (sent == 0)
+			co_return boost::asio::error::eof; // file shrank under us
+		if (errno == EINTR)
+			continue;
+		if (errno != EAGAIN && errno != EWOULDBLOCK)
+			co_return boost::system::error_code(errno, boost::system::system_category());
+
+		co_await stream.async_wait(boost::asio::posix::stream_descriptor::wait_write, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+		ec = deadline.Check(ec);
+		if (ec)
+			co_return ec;
+	}
+	co_return boost::system::error_code();
+}
+#endif
+
+FileSender::FileSender()
+{
+	if (!IsSupported())
+		return;
+
+	work = std::make_unique<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>>(context.get_executor());
+	thread = std::jthread([this]()
+		{
+			TRACE_THREAD_NAME("file sender");
+			context.run();
+		});
+}
+
+FileSender::~FileSender()
+{
+	work.reset();
+	context.stop();
+}
+
+bool FileSender::IsSupported()
+{
+#ifdef __linux__
+	return true;
+#else
+	return false;
+#endif
+}
+
+boost::asio::awaitable<boost::system::error_code> FileSender::Send(boost::asio::ip::tcp::socket& socket, int file, uint64_t offset, uint64_t size,
+	std::chrono::milliseconds timeout)
+{
+#ifdef __linux__
+	int fd = ::dup(socket.native_handle());
+	if (fd < 0)
+		co_return boost::system::error_code(errno, boost::system::system_category());
+
+	// the completion is delivered through the awaiting coroutine's executor
+	co_return co_await boost::asio::co_spawn(context, Transfer(fd, file, (off_t)offset, size, timeout), boost::asio::use_awaitable);
+#else
+	co_return boost::asio::error::operation_not_supported;
+#endif
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include "Utils/Boost.h"
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+// Streams file bodies from a dedicated I/O thread, so a large download does not hold a network pool thread,
+// and the other connections on it, in file reads. On Linux the data goes from the page cache to the socket
+// with sendfile(), no copies. Elsewhere IsSupported() is false and callers keep using http::file_body,
+// which reads on the connection's pool thread; neither path touches the tick thread.
+class FileSender
+{
+public:
+	FileSender();
+	~FileSender();
+
+	static bool IsSupported();
+
+	// Sends 'size' bytes of 'file' (native handle) from 'offset' to the socket and resumes the caller
+	// on its own executor. The socket must not be used by anything else until this completes.
+	// Fails with beast::error::timeout when the socket takes no data for 'timeout'.
+	boost::asio::awaitable<boost::system::error_code> Send(boost::asio::ip::tcp::socket& socket, int file, uint64_t offset, uint64_t size,
+		std::chrono::milliseconds timeout);
+
+private:
+	boost::asio::io_context context;
+	std::unique_ptr<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> work;
+	std::jthread thread;
+};
@@ -1,19 +1,87 @@
 #include "HttpConnection.hpp"
+#include <algorithm>
+#include <array>
+#include <format>
+#include <memory>
 #include <boost/asio.hpp>
 #include <boost/beast/http.hpp>
+#include "Deadline.hpp"
+#include "Utils/Metrics.h"
 
 namespace http = boost::beast::http;
+using SocketDeadline = Deadline<boost::asio::ip::tcp::socket>;
 
-HttpConnection::HttpConnection(boost::asio::ip::tcp::socket&& socket) : socket(std::move(socket)), upgradable(true)
+HttpConnection::HttpConnection(boost::asio::ip::tcp::socket&& socket, std::chrono::milliseconds writeTimeout) : socket(std::move(socket)),
+	upgradable(true), writeTimeout(writeTimeout)
 {
 }
 
-boost::asio::awaitable<void> HttpConnection::Read()
+boost::asio::awaitable<void> HttpConnection::Read(const Limits& limits, bool idle)
 {
-	co_await http::async_read(this->socket, buffer, request);
+	boost::beast::error_code ec;
+	if (idle && buffer.size() == 0)
+	{
+		SocketDeadline deadline(socket, limits.idleTimeout);
+		co_await socket.async_wait(boost::asio::ip::tcp::socket::wait_read, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+		ec = deadline.Check(ec);
+		if (ec)
+			throw boost::system::system_error(ec);
+	}
+
+	http::request_parser<http::string_body> parser;
+	parser.header_limit(limits.headerSize);
+	parser.body_limit(limits.bodySize);
+	{
+		SocketDeadline deadline(socket, limits.headerTimeout);
+		co_await http::async_read_header(this->socket, buffer, parser, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+		ec = deadline.Check(ec);
+		if (ec)
+			throw boost::system::system_error(ec);
+	}
+	if (!parser.is_done())
+	{
+		SocketDeadline deadline(socket, limits.bodyTimeout);
+		co_await http::async_read(this->socket, buffer, parser, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+		ec = deadline.Check(ec);
+		if (ec)
+			throw boost::system::system_error(ec);
+	}
+	request = parser.release();
 }
 
+// Chunk by chunk, so the deadline measures progress: a large body may take long, a client that stops reading may not
 boost::asio::awaitable<void> HttpConnection::Write(http::message_generator msg)
 {
-	co_await boost::beast::async_write(this->socket, std::move(msg));
+	boost::beast::error_code ec;
+	SocketDeadline deadline(socket, writeTimeout);
+	while (!msg.is_done())
+	{
+		auto buffers = msg.prepare(ec);
+		if (ec)
+			throw boost::system::system_error(ec);
+
+		auto written = co_await socket.async_write_some(buffers, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+		ec = deadline.Check(ec);
+		if (ec)
+			throw boost::system::system_error(ec);
+
+		msg.consume(written);
+		deadline.Touch();
+	}
+}
+
+void HttpConnection::CountResponse(unsigned int status)
+{
+	static constexpr unsigned int codes[] = { 200, 304, 400, 404, 500, 503 };
+	static const auto counters = []()
+		{
+			std::array<Metrics::Counter*, std::size(codes) + 1> counters;
+			for (size_t i = 0; i < std::size(codes); ++i)
+				counters[i] = &Metrics::AddCounter("http_responses_total", "HTTP responses, by status code", std::format("code=\"{}\"", codes[i]));
+			counters.back() = &Metrics::AddCounter("http_responses_total", "HTTP responses, by status code", "code=\"other\"");
+			return counters;
+		}();
+
+	auto i = std::find(std::begin(codes), std::end(codes), status) - std::begin(codes);
+	counters[i]->Add();
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <chrono>
 #include "Utils/Boost.h"
 #include <boost/asio/awaitable.hpp>
 #include <boost/asio/ip/tcp.hpp>
@@ -9,13 +10,37 @@
 
 struct HttpConnection
 {
+	// Deadlines and sizes for one request and its response; a read or write over a deadline closes the socket
+	struct Limits
+	{
+		std::chrono::milliseconds idleTimeout{ 60000 }; // keep-alive, until the first byte of the next request
+		std::chrono::milliseconds headerTimeout{ 10000 };
+		std::chrono::milliseconds bodyTimeout{ 30000 };
+		std::chrono::milliseconds writeTimeout{ 30000 }; // without progress while writing a response
+		uint32_t headerSize = 16 << 10;
+		uint64_t bodySize = 1 << 20;
+	};
+
 	boost::asio::ip::tcp::socket socket;
 	boost::beast::flat_buffer buffer;
 	boost::beast::http::request<boost::beast::http::string_body> request;
 	bool upgradable;
+	std::chrono::milliseconds writeTimeout; // for Write and bodies sent around it, see FileSender
 
-	HttpConnection(boost::asio::ip::tcp::socket&& socket);
+	HttpConnection(boost::asio::ip::tcp::socket&& socket, std::chrono::milliseconds writeTimeout);
 
-	boost::asio::awaitable<void> Read();
+	// Both throw boost::system::system_error, with beast::error::timeout when a deadline passed
+	boost::asio::awaitable<void> Read(const Limits& limits, bool idle);
 	boost::asio::awaitable<void> Write(boost::beast::http::message_generator msg);
+
+	// Counts the status in http_responses_total before writing
+	template <class Body>
+	boost::asio::awaitable<void> Write(boost::beast::http::response<Body>&& response)
+	{
+		CountResponse(response.result_int());
+		co_await Write(boost::beast::http::message_generator(std::move(response)));
+	}
+
+private:
+	static void CountResponse(unsigned int status);
 };
@@ -1,12 +1,19 @@
 #include "HttpServer.hpp"
+#include <algorithm>
 #include <boost/asio.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include "HttpMessage.hpp"
+#include "Utils/Metrics.h"
+#include "Utils/Time.h"
+#include "Utils/Trace.h"
 
 namespace http = boost::beast::http;
 
-HttpServer::HttpServer()
+static auto& RequestDuration = Metrics::AddHistogram("http_request_duration_seconds", "Time from a parsed request to its response written",
+	{ 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10 });
+
+HttpServer::HttpServer() : accepted(0), rejected(0), timedOut(0), active(0)
 {
 }
 
@@ -14,28 +21,93 @@ HttpServer::~HttpServer()
 {
 }
 
-boost::asio::awaitable<void> HttpServer::Run(boost::asio::ip::tcp::endpoint endpoint)
+static boost::asio::ip::tcp::acceptor CreateAcceptor(const boost::asio::any_io_executor& ctx, const boost::asio::ip::tcp::endpoint& endpoint, bool reusePort)
+{
+	boost::asio::ip::tcp::acceptor acceptor{ ctx };
+	acceptor.open(endpoint.protocol());
+	acceptor.set_option(boost::asio::socket_base::reuse_address(true));
+#ifdef __linux__
+	if (reusePort)
+		acceptor.set_option(boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true));
+#endif
+	acceptor.bind(endpoint);
+	acceptor.listen();
+	return acceptor;
+}
+
+boost::asio::awaitable<void> HttpServer::Run(boost::asio::ip::tcp::endpoint endpoint, unsigned int shards)
 {
+#ifndef __linux__
+	shards = 1;
+#endif
+	shards = std::max(shards, 1u);
 	auto ctx = co_await boost::asio::this_coro::executor;
-	boost::asio::ip::tcp::acceptor acceptor{ ctx, endpoint };
-	boost::beast::error_code ec;
 
+	for (unsigned int i = 1; i < shards; ++i)
+		boost::asio::co_spawn(ctx, Accept(CreateAcceptor(ctx, endpoint, true)), boost::asio::detached);
+	co_await Accept(CreateAcceptor(ctx, endpoint, shards > 1));
+}
+
+boost::asio::awaitable<void> HttpServer::Accept(boost::asio::ip::tcp::acceptor acceptor)
+{
+	boost::beast::error_code ec;
 	while (true)
 	{
-		boost::asio::ip::tcp::socket socket = co_await acceptor.async_accept(ctx, boost::asio::redirect_error(ec));
+		auto strand = boost::asio::make_strand(acceptor.get_executor());
+		boost::asio::ip::tcp::socket socket = co_await acceptor.async_accept(strand, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
 		if (ec)
 			continue;
 
-		HttpConnection connection{ std::move(socket) };
-		boost::asio::co_spawn(ctx, RunConnection(std::move(connection)), boost::asio::detached);
+		// the local UI keeps working while LAN clients use up the regular slots
+		auto limit = limits.maxConnections;
+		boost::system::error_code endpointError;
+		auto remote = socket.remote_endpoint(endpointError);
+		if (!endpointError && remote.address().is_loopback())
+			limit += limits.localReserve;
+
+		if (active.fetch_add(1, std::memory_order_relaxed) >= limit)
+		{
+			active.fetch_sub(1, std::memory_order_relaxed);
+			rejected.fetch_add(1, std::memory_order_relaxed);
+			socket.close(ec);
+			continue;
+		}
+		accepted.fetch_add(1, std::memory_order_relaxed);
+
+		HttpConnection connection{ std::move(socket), limits.connection.writeTimeout };
+		boost::asio::co_spawn(strand, RunConnection(std::move(connection)), boost::asio::detached);
 	}
 }
 
+HttpServer::Stats HttpServer::GetStats() const
+{
+	return { accepted.load(), rejected.load(), timedOut.load(), active.load() };
+}
+
 boost::asio::awaitable<void> HttpServer::RunConnection(HttpConnection connection)
 {
+	try
+	{
+		co_await ServeConnection(connection);
+	}
+	catch (const boost::system::system_error& e)
+	{
+		if (e.code() == boost::beast::error::timeout)
+			timedOut.fetch_add(1, std::memory_order_relaxed);
+	}
+	catch (...)
+	{
+	}
+	active.fetch_sub(1, std::memory_order_relaxed);
+}
+
+boost::asio::awaitable<void> HttpServer::ServeConnection(HttpConnection& connection)
+{
+	bool idle = false;
 	do
 	{
-		co_await connection.Read();
+		co_await connection.Read(limits.connection, idle);
+		idle = true;
 
 		auto method = connection.request.method();
 		bool allowed = false;
@@ -49,6 +121,9 @@ boost::asio::awaitable<void> HttpServer::RunConnection(HttpConnection connection
 			case http::verb::put:
 				allowed = true;
 				break;
+
+			default:
+				break;
 		}
 
 		if (!allowed)
@@ -79,7 +154,12 @@ boost::asio::awaitable<void> HttpServer::RunConnection(HttpConnection connection
 			co_return;
 		}
 
-		co_await onRequest(connection);
+		{
+			TRACE_SCOPE("http.request"); // recorded on the thread that finishes it
+			auto start = Time::SteadyNow();
+			co_await onRequest(connection);
+			RequestDuration.Observe((Time::SteadyNow() - start) / 1000.0);
+		}
 		if (!connection.request.keep_alive())
 			break;
 
@@ -1,4 +1,5 @@
 #pragma once
+#include <atomic>
 #include <vector>
 #include <functional>
 #include "Utils/Boost.h"
@@ -10,10 +11,32 @@
 class HttpServer
 {
 public:
+	struct Limits
+	{
+		HttpConnection::Limits connection;
+		unsigned int maxConnections = 128; // including upgraded ones until they are handed to onUpgrade
+		unsigned int localReserve = 8; // extra slots only loopback clients (the local UI) may take
+	};
+
+	struct Stats
+	{
+		unsigned long long accepted;
+		unsigned long long rejected; // over maxConnections
+		unsigned long long timedOut; // idle, header, body or write deadline passed
+		unsigned int active;
+	};
+
 	HttpServer();
 	~HttpServer();
 
-	boost::asio::awaitable<void> Run(boost::asio::ip::tcp::endpoint endpoint);
+	// Call before Run
+	void SetLimits(const Limits& limits) { this->limits = limits; }
+	Stats GetStats() const;
+
+	// Accepts on 'shards' listening sockets bound with SO_REUSEPORT, so the kernel spreads incoming connections
+	// over them. Linux only: elsewhere 'shards' is ignored and a single acceptor takes every connection.
+	// Either way each connection runs on its own strand of the caller's executor, which must not be a strand itself.
+	boost::asio::awaitable<void> Run(boost::asio::ip::tcp::endpoint endpoint, unsigned int shards = 1);
 
 	boost::asio::awaitable<void> RespondBadRequest(HttpConnection& connection);
 	boost::asio::awaitable<void> RespondNotFound(HttpConnection& connection);
@@ -23,5 +46,14 @@ public:
 	std::function<boost::asio::awaitable<void>(HttpConnection& connection)> onRequest;
 
 private:
+	boost::asio::awaitable<void> Accept(boost::asio::ip::tcp::acceptor acceptor);
 	boost::asio::awaitable<void> RunConnection(HttpConnection connection);
+	boost::asio::awaitable<void> ServeConnection(HttpConnection& connection);
+
+	Limits limits;
+	// updated from every connection strand
+	std::atomic<unsigned long long> accepted;
+	std::atomic<unsigned long long> rejected;
+	std::atomic<unsigned long long> timedOut;
+	std::atomic<unsigned int> active;
 };
@@ -1,16 +1,36 @@
 #include "WebSocket.hpp"
+#include <iterator>
+#include <memory>
 #include <boost/asio.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/websocket.hpp>
+#include "Utils/Metrics.h"
+#include "Utils/Trace.h"
 
-WebSocket::WebSocket(boost::beast::websocket::stream<boost::beast::tcp_stream>&& ws, boost::beast::flat_buffer&& buffer) : ws(std::move(ws)), buffer(std::move(buffer)), ctx(this->ws.get_executor())
+static auto& QueuedBytes = Metrics::AddGauge("websocket_send_queue_bytes", "Bytes waiting in the send queues of all sockets, not yet handed to a writer");
+static auto& QueuedFrames = Metrics::AddGauge("websocket_send_queue_frames", "Frames waiting in the send queues of all sockets, not yet handed to a writer");
+static auto& FramesSent = Metrics::AddCounter("websocket_frames_sent_total", "Frames written to sockets");
+static auto& BytesSent = Metrics::AddCounter("websocket_bytes_sent_total", "Payload bytes written to sockets");
+static auto& SlowClientsClosed = Metrics::AddCounter("websocket_slow_clients_closed_total", "Sockets closed because their send queue went over the limits");
+
+WebSocket::WebSocket(boost::beast::websocket::stream<boost::beast::tcp_stream>&& ws, boost::beast::flat_buffer&& buffer, boost::asio::any_io_executor owner) :
+	ws(std::move(ws)), buffer(std::move(buffer)), ctx(this->ws.get_executor()), owner(std::move(owner)), writeSignal(ctx)
 {
 	runningTasks = 0;
+	sendQueueFront = 0;
+	queuedBytes = 0;
+	handoff = nullptr;
+	writerIdle = true;
+	closed = false;
+	closing = false;
+	writerStopped = false;
 	remoteEndpoint = this->ws.next_layer().socket().remote_endpoint();
 }
 
 WebSocket::~WebSocket()
 {
+	ClearSendQueue();
+	delete handoff.exchange(nullptr);
 }
 
 bool WebSocket::IsRunning()
@@ -21,6 +41,7 @@ bool WebSocket::IsRunning()
 void WebSocket::RunAsync()
 {
 	boost::asio::co_spawn(ctx, RunInternal(runningTasks), boost::asio::detached);
+	boost::asio::co_spawn(ctx, WriteInternal(runningTasks), boost::asio::detached);
 }
 
 boost::asio::awaitable<void> WebSocket::RunInternal(TaskRef ref)
@@ -30,7 +51,7 @@ boost::asio::awaitable<void> WebSocket::RunInternal(TaskRef ref)
 	{
 		buffer.consume(buffer.size());
 
-		co_await ws.async_read(buffer, boost::asio::redirect_error(ec));
+		co_await ws.async_read(buffer, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
 		if (ec)
 		{
 			if (ws.is_open())
@@ -42,80 +63,173 @@ boost::asio::awaitable<void> WebSocket::RunInternal(TaskRef ref)
 				break;
 		}
 
-		if (onReceive)
-		{
-			auto data = buffer.cdata();
-			auto ref = FixedArrayCharS::CreateArrayRef((char*)data.data(), data.size());
-			onReceive(*this, { ref, ws.got_text() });
-		}
+		// delivered on the owner thread; the read buffer is reused right away, so the message is copied
+		auto data = buffer.cdata();
+		auto message = SharedBuffer::Copy(static_cast<const char*>(data.data()), data.size());
+		boost::asio::post(owner, [this, message = std::move(message), isText = ws.got_text(), ref = TaskRef(runningTasks)]()
+			{
+				TRACE_SCOPE("ws.receive");
+				if (onReceive)
+					onReceive(*this, { FixedArrayCharS::CreateArrayRef(const_cast<char*>(message.data()), message.size()), isText });
+			});
 	}
 
-	if (onClose)
-		onClose(*this);
+	writerStopped = true;
+	writeSignal.cancel();
+	closed = true;
+
+	boost::asio::post(owner, [this, ref = TaskRef(runningTasks)]()
+		{
+			ClearSendQueue();
+			if (onClose)
+				onClose(*this);
+		});
 }
 
-boost::asio::awaitable<void> WebSocket::FlushSendInternal(TaskRef ref)
+// One writer per connection: writes the batch handed off by the owner back to back, then asks for the next one
+boost::asio::awaitable<void> WebSocket::WriteInternal(TaskRef ref)
 {
-	while (!sendQueue.empty())
+	boost::beast::error_code ec;
+	while (!writerStopped)
 	{
-		auto& message = sendQueue.front();
-		auto& data = message.buffer;
+		std::unique_ptr<Batch> batch(handoff.exchange(nullptr, std::memory_order_acquire));
+		if (!batch)
+		{
+			writeSignal.expires_at(std::chrono::steady_clock::time_point::max());
+			co_await writeSignal.async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+			continue;
+		}
 
-		boost::asio::const_buffer buffer{ data, data.size() };
-		ws.text(message.isText);
+		TRACE_SCOPE("ws.write");
+		for (auto& frame : *batch)
+		{
+			auto& data = frame.buffer;
+			ws.text(frame.isText);
+			co_await ws.async_write(boost::asio::const_buffer{ data.data(), data.size() }, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+			if (ec)
+				break;
+			FramesSent.Add();
+			BytesSent.Add(data.size());
+		}
 
-		boost::beast::error_code ec;
-		co_await ws.async_write(buffer, boost::asio::redirect_error(ec));
 		if (ec)
 		{
-			while (!sendQueue.empty())
-				sendQueue.pop();
-
 			if (ws.is_open())
-			{
 				co_await CloseInternal(boost::beast::websocket::internal_error, runningTasks);
-				continue;
-			}
 			break;
 		}
 
-		sendQueue.pop();
+		writerIdle.store(true, std::memory_order_release);
+		boost::asio::post(owner, [this, ref = TaskRef(runningTasks)]()
+			{
+				HandOff();
+			});
 	}
 }
 
 void WebSocket::Send(const std::string& message)
 {
-	if (!ws.is_open())
+	if (closed || closing)
 		return;
 
-	Message msg{ FixedArrayCharS::Copy(message.data(), message.size()), true };
-	boost::asio::co_spawn(ctx, SendInternal(std::move(msg), runningTasks), boost::asio::detached);
+	Enqueue({ SharedBuffer::Copy(message.data(), message.size()), true, 0 });
 }
 
 void WebSocket::Send(const FixedArrayCharS& message)
 {
-	if (!ws.is_open())
+	Send(SharedBuffer::Copy(message));
+}
+
+void WebSocket::Send(const SharedBuffer& message, unsigned long long conflationKey)
+{
+	if (closed || closing)
 		return;
 
-	Message msg{ FixedArrayCharS::Copy(message), false };
-	boost::asio::co_spawn(ctx, SendInternal(std::move(msg), runningTasks), boost::asio::detached);
+	Enqueue({ message, false, conflationKey });
 }
 
-boost::asio::awaitable<void> WebSocket::SendInternal(Message message, TaskRef ref)
+void WebSocket::Enqueue(Frame&& frame)
 {
-	if (!ws.is_open())
-		co_return;
+	if (!frame.conflationKey)
+		conflatedFrames.clear(); // later frames must not overtake this one
+	else
+	{
+		auto [i, inserted] = conflatedFrames.try_emplace(frame.conflationKey, sendQueueFront + sendQueue.size());
+		if (!inserted)
+		{
+			// latest value wins, keeping the position of the queued frame
+			auto& queued = sendQueue[i->second - sendQueueFront];
+			queuedBytes += frame.buffer.size() - queued.buffer.size();
+			QueuedBytes.Add((int64_t)frame.buffer.size() - (int64_t)queued.buffer.size());
+			queued.buffer = std::move(frame.buffer);
+			CheckSendLimits();
+			return;
+		}
+	}
+
+	queuedBytes += frame.buffer.size();
+	QueuedBytes.Add((int64_t)frame.buffer.size());
+	QueuedFrames.Add(1);
+	sendQueue.push_back(std::move(frame));
+	if (CheckSendLimits())
+		HandOff();
+}
+
+// Owner side: gives everything queued to the writer, if it is idle
+void WebSocket::HandOff()
+{
+	if (sendQueue.empty() || closed || !writerIdle.exchange(false, std::memory_order_acq_rel))
+		return;
+
+	auto batch = new Batch(std::make_move_iterator(sendQueue.begin()), std::make_move_iterator(sendQueue.end()));
+	ClearSendQueue();
+	handoff.store(batch, std::memory_order_release);
+
+	boost::asio::post(ctx, [this, ref = TaskRef(runningTasks)]()
+		{
+			writeSignal.cancel();
+		});
+}
+
+bool WebSocket::CheckSendLimits()
+{
+	if (queuedBytes <= sendLimits.soft)
+	{
+		overLimitSince = {};
+		return true;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	if (overLimitSince == std::chrono::steady_clock::time_point{})
+		overLimitSince = now;
 
-	sendQueue.push(std::move(message));
-	if (sendQueue.size() == 1)
-		boost::asio::co_spawn(ctx, FlushSendInternal(runningTasks), boost::asio::detached);
+	if (queuedBytes <= sendLimits.hard && now - overLimitSince <= sendLimits.timeout)
+		return true;
+
+	// client does not keep up - drop the backlog and disconnect
+	SlowClientsClosed.Add();
+	ClearSendQueue();
+	Close(boost::beast::websocket::close_code::try_again_later);
+	return false;
+}
+
+void WebSocket::ClearSendQueue()
+{
+	QueuedBytes.Add(-(int64_t)queuedBytes);
+	QueuedFrames.Add(-(int64_t)sendQueue.size());
+	sendQueueFront += sendQueue.size();
+	sendQueue.clear();
+	conflatedFrames.clear();
+	queuedBytes = 0;
+	overLimitSince = {};
 }
 
 void WebSocket::Close(boost::beast::websocket::close_code code)
 {
-	if (!ws.is_open())
+	if (closed || closing)
 		return;
 
+	closing = true;
 	boost::asio::co_spawn(ctx, CloseInternal(code, runningTasks), boost::asio::detached);
 }
 
@@ -125,8 +239,5 @@ boost::asio::awaitable<void> WebSocket::CloseInternal(boost::beast::websocket::c
 		co_return;
 
 	boost::beast::error_code ec;
-	co_await ws.async_close(boost::beast::websocket::close_reason{ code }, boost::asio::redirect_error(ec));
-
-	while (!sendQueue.empty())
-		sendQueue.pop();
+	co_await ws.async_close(boost::beast::websocket::close_reason{ code }, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
 }
@@ -1,13 +1,19 @@
-#include <queue>
+#include <chrono>
+#include <atomic>
+#include <deque>
 #include <functional>
+#include <unordered_map>
+#include <vector>
 #include "Utils/Boost.h"
 #include <boost/asio/awaitable.hpp>
 #include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/beast/core/flat_buffer.hpp>
 #include <boost/beast/core/tcp_stream.hpp>
 #include <boost/beast/websocket/rfc6455.hpp>
 #include <boost/beast/websocket/stream.hpp>
 #include "Utils/FixedArray.h"
+#include "Utils/SharedBuffer.h"
 
 struct TaskRef
 {
@@ -32,10 +38,14 @@ struct TaskRef
 	}
 };
 
+// Socket I/O runs on the stream's executor (a strand of the network pool). Everything else - Send, Close,
+// onReceive and onClose - belongs to the 'owner' executor, the thread that also destroys the object.
+// Frames cross over in batches through an atomic pointer: the writer takes a batch when it is idle, and
+// what is queued while it writes stays on the owner side, where conflation and send limits apply.
 class WebSocket
 {
 public:
-	WebSocket(boost::beast::websocket::stream<boost::beast::tcp_stream>&& ws, boost::beast::flat_buffer&& buffer);
+	WebSocket(boost::beast::websocket::stream<boost::beast::tcp_stream>&& ws, boost::beast::flat_buffer&& buffer, boost::asio::any_io_executor owner);
 	~WebSocket();
 
 	WebSocket(WebSocket&&) = default;
@@ -48,8 +58,22 @@ public:
 		return remoteEndpoint;
 	}
 
+	// Queued bytes above 'soft' for longer than 'timeout', or above 'hard' at any time, close the connection
+	struct SendLimits
+	{
+		size_t soft = 1 << 20;
+		size_t hard = 8 << 20;
+		std::chrono::milliseconds timeout{ 5000 };
+	};
+
+	void SetSendLimits(const SendLimits& limits) { sendLimits = limits; }
+	size_t GetQueuedBytes() const { return queuedBytes; }
+
 	void Send(const std::string& message);
 	void Send(const FixedArrayCharS& message);
+	// Shares the buffer, no copy. A frame with a non-zero conflation key replaces a queued frame with the same key
+	// that was sent after the last unkeyed frame; unkeyed frames are never dropped or reordered.
+	void Send(const SharedBuffer& message, unsigned long long conflationKey = 0);
 	void Close(boost::beast::websocket::close_code code = boost::beast::websocket::close_code::normal);
 
 	struct Message
@@ -72,15 +96,45 @@ public:
 	std::function<void(WebSocket& ws)> onClose;
 
 private:
+	struct Frame
+	{
+		SharedBuffer buffer;
+		bool isText;
+		unsigned long long conflationKey;
+	};
+	using Batch = std::vector<Frame>;
+
 	boost::asio::awaitable<void> RunInternal(TaskRef ref);
-	boost::asio::awaitable<void> FlushSendInternal(TaskRef ref);
-	boost::asio::awaitable<void> SendInternal(Message message, TaskRef ref);
+	boost::asio::awaitable<void> WriteInternal(TaskRef ref);
+	void Enqueue(Frame&& frame);
+	void HandOff();
 	boost::asio::awaitable<void> CloseInternal(boost::beast::websocket::close_code code, TaskRef ref);
+	bool CheckSendLimits();
+	void ClearSendQueue();
 
 	boost::beast::websocket::stream<boost::beast::tcp_stream> ws;
 	boost::beast::flat_buffer buffer;
 	boost::asio::any_io_executor ctx;
-	std::queue<Message> sendQueue;
+	boost::asio::any_io_executor owner;
+
+	// owner side
+	std::deque<Frame> sendQueue; // waiting frames, the batch being written is not included
+	std::unordered_map<unsigned long long, size_t> conflatedFrames; // conflation key -> frame sequence number
+	size_t sendQueueFront; // sequence number of sendQueue.front()
+	size_t queuedBytes;
+	SendLimits sendLimits;
+	std::chrono::steady_clock::time_point overLimitSince;
+	bool closing; // Close() was called, later sends are dropped and the close is not repeated
+
+	// handoff
+	std::atomic<Batch*> handoff; // next batch for the writer, owned by whoever takes it
+	std::atomic_bool writerIdle; // the writer finished its batch; the owner may hand off the next one
+	std::atomic_bool closed; // the reader ended, later sends are dropped
+
+	// strand side
+	boost::asio::steady_timer writeSignal; // writer sleeps on it while there is no batch, canceled to wake up
+	bool writerStopped;
+
 	std::atomic_int runningTasks;
 	boost::asio::ip::tcp::endpoint remoteEndpoint;
 };
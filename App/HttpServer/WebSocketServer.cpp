@@ -4,9 +4,10 @@
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/websocket.hpp>
+#include "HttpMessage.hpp"
 #include "version.hpp"
 
-WebSocketServer::WebSocketServer()
+WebSocketServer::WebSocketServer() : openSockets(0), rejected(0)
 {
 }
 
@@ -16,6 +17,7 @@ WebSocketServer::~WebSocketServer()
 
 void WebSocketServer::Shutdown()
 {
+	openSockets -= (unsigned int)wss.size();
 	wss.clear();
 }
 
@@ -28,7 +30,7 @@ boost::asio::awaitable<void> WebSocketServer::Run()
 	boost::asio::steady_timer timer(ctx, 40ms);
 	while (true)
 	{
-		co_await timer.async_wait();
+		co_await timer.async_wait(boost::asio::use_awaitable);
 		timer.expires_after(40ms);
 
 		for (auto i = wss.begin(); i != wss.end(); ++i)
@@ -41,12 +43,31 @@ boost::asio::awaitable<void> WebSocketServer::Run()
 		{
 			wss.erase(i);
 		}
+		openSockets -= (unsigned int)oldSockets.size();
 		oldSockets.clear();
 	}
 }
 
 boost::asio::awaitable<void> WebSocketServer::Accept(HttpConnection connection)
 {
+	auto limit = limits.maxSockets;
+	boost::system::error_code ec;
+	auto remote = connection.socket.remote_endpoint(ec);
+	if (!ec && remote.address().is_loopback())
+		limit += limits.localReserve;
+
+	if (openSockets.fetch_add(1) >= limit)
+	{
+		--openSockets;
+		++rejected;
+		auto response = HttpMessage::Create<http::string_body>(connection.request, http::status::service_unavailable);
+		response.keep_alive(false);
+		response.body() = "503 Service Unavailable";
+		response.prepare_payload();
+		co_await connection.Write(std::move(response));
+		co_return;
+	}
+
 	boost::beast::websocket::stream<boost::beast::tcp_stream> ws{ std::move(connection.socket) };
 	ws.set_option(boost::beast::websocket::stream_base::timeout::suggested(boost::beast::role_type::server));
 	ws.set_option(boost::beast::websocket::stream_base::decorator([](boost::beast::websocket::response_type& response)
@@ -54,13 +75,18 @@ boost::asio::awaitable<void> WebSocketServer::Accept(HttpConnection connection)
 																	  response.set(http::field::server, TEAPOT_VERSION);
 																  }));
 
-	boost::beast::error_code ec;
-	co_await ws.async_accept(connection.request, boost::asio::redirect_error(ec));
+	co_await ws.async_accept(connection.request, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
 	if (ec)
+	{
+		--openSockets;
 		co_return;
+	}
 
-	auto& object = wss.emplace_back(std::move(ws), std::move(connection.buffer));
-	if (onOpen)
-		onOpen(object);
-	object.RunAsync();
+	boost::asio::post(owner, [this, ws = std::move(ws), buffer = std::move(connection.buffer)]() mutable
+		{
+			auto& object = wss.emplace_back(std::move(ws), std::move(buffer), owner);
+			if (onOpen)
+				onOpen(object);
+			object.RunAsync();
+		});
 }
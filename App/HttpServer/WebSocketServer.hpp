@@ -1,4 +1,6 @@
 #pragma once
+#include <atomic>
+#include <list>
 #include "WebSocket.hpp"
 #include "HttpConnection.hpp"
 
@@ -7,17 +9,40 @@ namespace http = boost::beast::http;
 class WebSocketServer
 {
 public:
+	struct Limits
+	{
+		unsigned int maxSockets = 64;
+		unsigned int localReserve = 4; // extra sockets only loopback clients (the local UI) may open
+	};
+
+	struct Stats
+	{
+		unsigned long long rejected; // over maxSockets, answered with 503
+		unsigned int open;
+	};
+
 	WebSocketServer();
 	~WebSocketServer();
 
+	// Call before Run
+	void SetLimits(const Limits& limits) { this->limits = limits; }
+	Stats GetStats() const { return { rejected.load(), openSockets.load() }; }
+
 	void Shutdown();
+	// Executor that owns the sockets: Run() and the callbacks of every socket run on it
+	void SetOwner(boost::asio::any_io_executor executor) { owner = std::move(executor); }
 	boost::asio::awaitable<void> Run();
+	// Handshake on the connection's executor, then the socket is handed to the owner
 	boost::asio::awaitable<void> Accept(HttpConnection connection);
 
 	std::function<void(WebSocket& ws)> onOpen;
 
 	//private:
 	std::list<WebSocket> wss;
+	boost::asio::any_io_executor owner;
+	Limits limits;
+	std::atomic<unsigned int> openSockets; // from handshake until the socket is erased
+	std::atomic<unsigned long long> rejected;
 
 public:
 	bool IsUpgrade(http::request<http::string_body>& request)
@@ -0,0 +1,457 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <SimConnect.h>
+#include "NativeTransport.h"
+
+using namespace SimConnect;
+static_assert(ObjectIdUser == SIMCONNECT_OBJECT_ID_USER);
+
+static const char* StringifyError(DWORD e);
+static SIMCONNECT_DATATYPE VarTypeToDataType(DataModel::VarType type);
+static SIMCONNECT_PERIOD RequestPeriodToNative(RequestPeriod period);
+static ObjectType NativeToObjectType(SIMCONNECT_SIMOBJECT_TYPE type);
+static SIMCONNECT_SIMOBJECT_TYPE ObjectTypeToNative(ObjectType type);
+
+NativeTransport::NativeTransport() : hSimConnect(0), hDataEvent(0)
+{
+}
+
+NativeTransport::~NativeTransport()
+{
+	Close();
+}
+
+bool NativeTransport::Open(const char* name)
+{
+	hDataEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+	auto hr = SimConnect_Open(&hSimConnect, name, 0, 0, hDataEvent, 0);
+	if (FAILED(hr))
+	{
+		hSimConnect = 0;
+		CloseHandle(hDataEvent);
+		hDataEvent = 0;
+		return false;
+	}
+
+	if (dataPending)
+		StartWaiter();
+	return true;
+}
+
+void NativeTransport::Close()
+{
+	if (waiter.joinable())
+	{
+		waiter.request_stop();
+		waiter.join();
+	}
+
+	if (hSimConnect)
+	{
+		SimConnect_Close(hSimConnect);
+		hSimConnect = 0;
+	}
+
+	if (hDataEvent)
+	{
+		CloseHandle(hDataEvent);
+		hDataEvent = 0;
+	}
+}
+
+void NativeTransport::SetDataPendingCallback(std::function<void()> callback)
+{
+	if (waiter.joinable())
+	{
+		waiter.request_stop();
+		waiter.join();
+	}
+
+	dataPending = std::move(callback);
+	if (hSimConnect && dataPending)
+		StartWaiter();
+}
+
+void NativeTransport::StartWaiter()
+{
+	waiter = std::jthread([this](std::stop_token token)
+		{
+			// timeout only bounds how long Close waits for the thread
+			while (!token.stop_requested())
+			{
+				if (WaitForSingleObject(hDataEvent, 100) == WAIT_OBJECT_0)
+					dataPending();
+			}
+		});
+}
+
+bool NativeTransport::GetNextDispatch(Packet& packet)
+{
+	if (!hSimConnect)
+		return false;
+
+	SIMCONNECT_RECV* pData = nullptr;
+	DWORD cbData = 0;
+
+	auto hr = SimConnect_GetNextDispatch(hSimConnect, &pData, &cbData);
+	if (FAILED(hr))
+		return false;
+
+	packet.nativeId = pData->dwID;
+	switch (pData->dwID)
+	{
+		case SIMCONNECT_RECV_ID_NULL:
+		{
+			packet.type = PacketType::NONE;
+			break;
+		}
+
+		case SIMCONNECT_RECV_ID_EXCEPTION:
+		{
+			auto* info = reinterpret_cast<SIMCONNECT_RECV_EXCEPTION*>(pData);
+			packet.type = PacketType::EXCEPTION;
+			packet.exception.exception = info->dwException;
+			packet.exception.argId = info->dwIndex;
+			packet.exception.exceptionName = StringifyError(info->dwException);
+			packet.sendId = info->dwSendID;
+			break;
+		}
+
+		case SIMCONNECT_RECV_ID_OPEN:
+		{
+			auto* info = reinterpret_cast<SIMCONNECT_RECV_OPEN*>(pData);
+			packet.type = PacketType::OPEN;
+			packet.server.appName = info->szApplicationName;
+			packet.server.appVersionMajor = info->dwApplicationVersionMajor;
+			packet.server.appVersionMinor = info->dwApplicationVersionMinor;
+			packet.server.serverVersionMajor = info->dwSimConnectVersionMajor;
+			packet.server.serverVersionMinor = info->dwSimConnectVersionMinor;
+			break;
+		}
+
+		case SIMCONNECT_RECV_ID_QUIT:
+		{
+			packet.type = PacketType::QUIT;
+			break;
+		}
+
+		case SIMCONNECT_RECV_ID_EVENT_OBJECT_ADDREMOVE:
+		{
+			auto* info = reinterpret_cast<SIMCONNECT_RECV_EVENT_OBJECT_ADDREMOVE*>(pData);
+			packet.type = PacketType::EVENT_OBJECT_ADDREMOVE;
+			packet.eventId = info->uEventID;
+			packet.objectType = NativeToObjectType(info->eObjType);
+			packet.data[0] = info->dwData;
+			break;
+		}
+
+		case SIMCONNECT_RECV_ID_SIMOBJECT_DATA:
+		case SIMCONNECT_RECV_ID_SIMOBJECT_DATA_BYTYPE:
+		{
+			auto* info = reinterpret_cast<SIMCONNECT_RECV_SIMOBJECT_DATA*>(pData);
+			packet.type = pData->dwID == SIMCONNECT_RECV_ID_SIMOBJECT_DATA ? PacketType::SIMOBJECT_DATA : PacketType::SIMOBJECT_DATA_BYTYPE;
+			packet.requestId = info->dwRequestID;
+			packet.objectId = info->dwObjectID;
+			packet.entryNumber = info->dwentrynumber;
+			packet.outOf = info->dwoutof;
+			packet.objectData = &info->dwData;
+			break;
+		}
+
+		case SIMCONNECT_RECV_ID_EVENT:
+		{
+			auto* info = reinterpret_cast<SIMCONNECT_RECV_EVENT*>(pData);
+			packet.type = PacketType::EVENT;
+			packet.eventId = info->uEventID;
+			packet.data[0] = info->dwData;
+			break;
+		}
+
+		case SIMCONNECT_RECV_ID_EVENT_EX1:
+		{
+			auto* info = reinterpret_cast<SIMCONNECT_RECV_EVENT_EX1*>(pData);
+			packet.type = PacketType::EVENT_EX1;
+			packet.eventId = info->uEventID;
+			packet.data[0] = info->dwData0;
+			packet.data[1] = info->dwData1;
+			packet.data[2] = info->dwData2;
+			packet.data[3] = info->dwData3;
+			packet.data[4] = info->dwData4;
+			break;
+		}
+
+		default:
+		{
+			packet.type = PacketType::UNKNOWN;
+			break;
+		}
+	}
+	return true;
+}
+
+unsigned int NativeTransport::GetLastSentPacketId()
+{
+	DWORD id = 0;
+	auto hr = SimConnect_GetLastSentPacketID(hSimConnect, &id);
+	if (FAILED(hr))
+		return 0;
+	return id;
+}
+
+bool NativeTransport::AddToDataDefinition(ModelId modelId, const DataModel::VarDef& var)
+{
+	auto hr = SimConnect_AddToDataDefinition(hSimConnect, modelId, var.name, var.unit, VarTypeToDataType(var.type));
+	return SUCCEEDED(hr);
+}
+
+void NativeTransport::ClearDataDefinition(ModelId modelId)
+{
+	SimConnect_ClearDataDefinition(hSimConnect, modelId);
+}
+
+bool NativeTransport::SubscribeToSystemEvent(EventId eventId, const char* name)
+{
+	auto hr = SimConnect_SubscribeToSystemEvent(hSimConnect, eventId, name);
+	return SUCCEEDED(hr);
+}
+
+bool NativeTransport::RequestDataOnSimObject(RequestId requestId, ModelId modelId, ObjectId objectId, RequestPeriod period)
+{
+	auto hr = SimConnect_RequestDataOnSimObject(hSimConnect, requestId, modelId, objectId, RequestPeriodToNative(period));
+	return SUCCEEDED(hr);
+}
+
+bool NativeTransport::RequestDataOnSimObjectType(RequestId requestId, ModelId modelId, unsigned int radius, ObjectType type)
+{
+	auto hr = SimConnect_RequestDataOnSimObjectType(hSimConnect, requestId, modelId, radius, ObjectTypeToNative(type));
+	return SUCCEEDED(hr);
+}
+
+bool NativeTransport::MapClientEventToSimEvent(EventId eventId, const char* name)
+{
+	auto hr = SimConnect_MapClientEventToSimEvent(hSimConnect, eventId, name);
+	return SUCCEEDED(hr);
+}
+
+bool NativeTransport::AddClientEventToNotificationGroup(GroupId groupId, EventId eventId)
+{
+	auto hr = SimConnect_AddClientEventToNotificationGroup(hSimConnect, groupId, eventId);
+	return SUCCEEDED(hr);
+}
+
+bool NativeTransport::TransmitClientEvent(ObjectId objectId, EventId eventId, unsigned int value)
+{
+	auto hr = SimConnect_TransmitClientEvent(hSimConnect, objectId, eventId, value, SIMCONNECT_GROUP_PRIORITY_HIGHEST, SIMCONNECT_EVENT_FLAG_GROUPID_IS_PRIORITY);
+	return SUCCEEDED(hr);
+}
+
+bool NativeTransport::TransmitClientEventEx1(ObjectId objectId, EventId eventId, const unsigned int data[5])
+{
+	auto hr = SimConnect_TransmitClientEvent_EX1(hSimConnect, objectId, eventId, SIMCONNECT_GROUP_PRIORITY_HIGHEST, SIMCONNECT_EVENT_FLAG_GROUPID_IS_PRIORITY, data[0], data[1], data[2], data[3], data[4]);
+	return SUCCEEDED(hr);
+}
+
+static const char* StringifyError(DWORD e)
+{
+	switch (e)
+	{
+		case SIMCONNECT_EXCEPTION_NONE:
+			return "SIMCONNECT_EXCEPTION_NONE";
+		case SIMCONNECT_EXCEPTION_ERROR:
+			return "SIMCONNECT_EXCEPTION_ERROR";
+		case SIMCONNECT_EXCEPTION_SIZE_MISMATCH:
+			return "SIMCONNECT_EXCEPTION_SIZE_MISMATCH";
+		case SIMCONNECT_EXCEPTION_UNRECOGNIZED_ID:
+			return "SIMCONNECT_EXCEPTION_UNRECOGNIZED_ID";
+		case SIMCONNECT_EXCEPTION_UNOPENED:
+			return "SIMCONNECT_EXCEPTION_UNOPENED";
+		case SIMCONNECT_EXCEPTION_VERSION_MISMATCH:
+			return "SIMCONNECT_EXCEPTION_VERSION_MISMATCH";
+		case SIMCONNECT_EXCEPTION_TOO_MANY_GROUPS:
+			return "SIMCONNECT_EXCEPTION_TOO_MANY_GROUPS";
+		case SIMCONNECT_EXCEPTION_NAME_UNRECOGNIZED:
+			return "SIMCONNECT_EXCEPTION_NAME_UNRECOGNIZED";
+		case SIMCONNECT_EXCEPTION_TOO_MANY_EVENT_NAMES:
+			return "SIMCONNECT_EXCEPTION_TOO_MANY_EVENT_NAMES";
+		case SIMCONNECT_EXCEPTION_EVENT_ID_DUPLICATE:
+			return "SIMCONNECT_EXCEPTION_EVENT_ID_DUPLICATE";
+		case SIMCONNECT_EXCEPTION_TOO_MANY_MAPS:
+			return "SIMCONNECT_EXCEPTION_TOO_MANY_MAPS";
+		case SIMCONNECT_EXCEPTION_TOO_MANY_OBJECTS:
+			return "SIMCONNECT_EXCEPTION_TOO_MANY_OBJECTS";
+		case SIMCONNECT_EXCEPTION_TOO_MANY_REQUESTS:
+			return "SIMCONNECT_EXCEPTION_TOO_MANY_REQUESTS";
+		case SIMCONNECT_EXCEPTION_WEATHER_INVALID_PORT:
+			return "SIMCONNECT_EXCEPTION_WEATHER_INVALID_PORT";
+		case SIMCONNECT_EXCEPTION_WEATHER_INVALID_METAR:
+			return "SIMCONNECT_EXCEPTION_WEATHER_INVALID_METAR";
+		case SIMCONNECT_EXCEPTION_WEATHER_UNABLE_TO_GET_OBSERVATION:
+			return "SIMCONNECT_EXCEPTION_WEATHER_UNABLE_TO_GET_OBSERVATION";
+		case SIMCONNECT_EXCEPTION_WEATHER_UNABLE_TO_CREATE_STATION:
+			return "SIMCONNECT_EXCEPTION_WEATHER_UNABLE_TO_CREATE_STATION";
+		case SIMCONNECT_EXCEPTION_WEATHER_UNABLE_TO_REMOVE_STATION:
+			return "SIMCONNECT_EXCEPTION_WEATHER_UNABLE_TO_REMOVE_STATION";
+		case SIMCONNECT_EXCEPTION_INVALID_DATA_TYPE:
+			return "SIMCONNECT_EXCEPTION_INVALID_DATA_TYPE";
+		case SIMCONNECT_EXCEPTION_INVALID_DATA_SIZE:
+			return "SIMCONNECT_EXCEPTION_INVALID_DATA_SIZE";
+		case SIMCONNECT_EXCEPTION_DATA_ERROR:
+			return "SIMCONNECT_EXCEPTION_DATA_ERROR";
+		case SIMCONNECT_EXCEPTION_INVALID_ARRAY:
+			return "SIMCONNECT_EXCEPTION_INVALID_ARRAY";
+		case SIMCONNECT_EXCEPTION_CREATE_OBJECT_FAILED:
+			return "SIMCONNECT_EXCEPTION_CREATE_OBJECT_FAILED";
+		case SIMCONNECT_EXCEPTION_LOAD_FLIGHTPLAN_FAILED:
+			return "SIMCONNECT_EXCEPTION_LOAD_FLIGHTPLAN_FAILED";
+		case SIMCONNECT_EXCEPTION_OPERATION_INVALID_FOR_OBJECT_TYPE:
+			return "SIMCONNECT_EXCEPTION_OPERATION_INVALID_FOR_OBJECT_TYPE";
+		case SIMCONNECT_EXCEPTION_ILLEGAL_OPERATION:
+			return "SIMCONNECT_EXCEPTION_ILLEGAL_OPERATION";
+		case SIMCONNECT_EXCEPTION_ALREADY_SUBSCRIBED:
+			return "SIMCONNECT_EXCEPTION_ALREADY_SUBSCRIBED";
+		case SIMCONNECT_EXCEPTION_INVALID_ENUM:
+			return "SIMCONNECT_EXCEPTION_INVALID_ENUM";
+		case SIMCONNECT_EXCEPTION_DEFINITION_ERROR:
+			return "SIMCONNECT_EXCEPTION_DEFINITION_ERROR";
+		case SIMCONNECT_EXCEPTION_DUPLICATE_ID:
+			return "SIMCONNECT_EXCEPTION_DUPLICATE_ID";
+		case SIMCONNECT_EXCEPTION_DATUM_ID:
+			return "SIMCONNECT_EXCEPTION_DATUM_ID";
+		case SIMCONNECT_EXCEPTION_OUT_OF_BOUNDS:
+			return "SIMCONNECT_EXCEPTION_OUT_OF_BOUNDS";
+		case SIMCONNECT_EXCEPTION_ALREADY_CREATED:
+			return "SIMCONNECT_EXCEPTION_ALREADY_CREATED";
+		case SIMCONNECT_EXCEPTION_OBJECT_OUTSIDE_REALITY_BUBBLE:
+			return "SIMCONNECT_EXCEPTION_OBJECT_OUTSIDE_REALITY_BUBBLE";
+		case SIMCONNECT_EXCEPTION_OBJECT_CONTAINER:
+			return "SIMCONNECT_EXCEPTION_OBJECT_CONTAINER";
+		case SIMCONNECT_EXCEPTION_OBJECT_AI:
+			return "SIMCONNECT_EXCEPTION_OBJECT_AI";
+		case SIMCONNECT_EXCEPTION_OBJECT_ATC:
+			return "SIMCONNECT_EXCEPTION_OBJECT_ATC";
+		case SIMCONNECT_EXCEPTION_OBJECT_SCHEDULE:
+			return "SIMCONNECT_EXCEPTION_OBJECT_SCHEDULE";
+		case SIMCONNECT_EXCEPTION_JETWAY_DATA:
+			return "SIMCONNECT_EXCEPTION_JETWAY_DATA";
+		case SIMCONNECT_EXCEPTION_ACTION_NOT_FOUND:
+			return "SIMCONNECT_EXCEPTION_ACTION_NOT_FOUND";
+		case SIMCONNECT_EXCEPTION_NOT_AN_ACTION:
+			return "SIMCONNECT_EXCEPTION_NOT_AN_ACTION";
+		case SIMCONNECT_EXCEPTION_INCORRECT_ACTION_PARAMS:
+			return "SIMCONNECT_EXCEPTION_INCORRECT_ACTION_PARAMS";
+		case SIMCONNECT_EXCEPTION_GET_INPUT_EVENT_FAILED:
+			return "SIMCONNECT_EXCEPTION_GET_INPUT_EVENT_FAILED";
+		case SIMCONNECT_EXCEPTION_SET_INPUT_EVENT_FAILED:
+			return "SIMCONNECT_EXCEPTION_SET_INPUT_EVENT_FAILED";
+		default:
+			return "Unknown SimConnect Error";
+	}
+}
+
+static SIMCONNECT_DATATYPE VarTypeToDataType(DataModel::VarType type)
+{
+	using VarType = DataModel::VarType;
+
+	switch (type)
+	{
+		case VarType::INVALID:
+			return SIMCONNECT_DATATYPE_INVALID;
+		case VarType::INT32:
+			return SIMCONNECT_DATATYPE_INT32;
+		case VarType::INT64:
+			return SIMCONNECT_DATATYPE_INT64;
+		case VarType::FLOAT32:
+			return SIMCONNECT_DATATYPE_FLOAT32;
+		case VarType::FLOAT64:
+			return SIMCONNECT_DATATYPE_FLOAT64;
+		case VarType::STRING8:
+			return SIMCONNECT_DATATYPE_STRING8;
+		case VarType::STRING32:
+			return SIMCONNECT_DATATYPE_STRING32;
+		case VarType::STRING64:
+			return SIMCONNECT_DATATYPE_STRING64;
+		case VarType::STRING128:
+			return SIMCONNECT_DATATYPE_STRING128;
+		case VarType::STRING256:
+			return SIMCONNECT_DATATYPE_STRING256;
+		case VarType::STRING260:
+			return SIMCONNECT_DATATYPE_STRING260;
+		case VarType::STRINGV:
+			return SIMCONNECT_DATATYPE_STRINGV;
+		case VarType::INITPOSITION:
+			return SIMCONNECT_DATATYPE_INITPOSITION;
+		case VarType::MARKERSTATE:
+			return SIMCONNECT_DATATYPE_MARKERSTATE;
+		case VarType::WAYPOINT:
+			return SIMCONNECT_DATATYPE_WAYPOINT;
+		case VarType::LATLONALT:
+			return SIMCONNECT_DATATYPE_LATLONALT;
+		case VarType::XYZ:
+			return SIMCONNECT_DATATYPE_XYZ;
+		default:
+			throw std::exception("Unknown VarType value");
+	}
+}
+
+static SIMCONNECT_PERIOD RequestPeriodToNative(RequestPeriod period)
+{
+	switch (period)
+	{
+		case RequestPeriod::NEVER:
+			return SIMCONNECT_PERIOD_NEVER;
+		case RequestPeriod::ONCE:
+			return SIMCONNECT_PERIOD_ONCE;
+		case RequestPeriod::VISUAL_FRAME:
+			return SIMCONNECT_PERIOD_VISUAL_FRAME;
+		case RequestPeriod::SIM_FRAME:
+			return SIMCONNECT_PERIOD_SIM_FRAME;
+		case RequestPeriod::SECOND:
+			return SIMCONNECT_PERIOD_SECOND;
+		default:
+			throw std::exception("Unknown RequestPeriod value");
+	}
+}
+
+static ObjectType NativeToObjectType(SIMCONNECT_SIMOBJECT_TYPE type)
+{
+	switch (type)
+	{
+		case SIMCONNECT_SIMOBJECT_TYPE_USER:
+			return ObjectType::USER;
+		case SIMCONNECT_SIMOBJECT_TYPE_ALL:
+			return ObjectType::ALL;
+		case SIMCONNECT_SIMOBJECT_TYPE_AIRCRAFT:
+			return ObjectType::AIRCRAFT;
+		case SIMCONNECT_SIMOBJECT_TYPE_HELICOPTER:
+			return ObjectType::HELICOPTER;
+		case SIMCONNECT_SIMOBJECT_TYPE_BOAT:
+			return ObjectType::BOAT;
+		case SIMCONNECT_SIMOBJECT_TYPE_GROUND:
+			return ObjectType::GROUND;
+		default:
+			throw std::exception("Unknown SIMOBJECT_TYPE value");
+	}
+}
+
+static SIMCONNECT_SIMOBJECT_TYPE ObjectTypeToNative(ObjectType type)
+{
+	switch (type)
+	{
+		case ObjectType::USER:
+			return SIMCONNECT_SIMOBJECT_TYPE_USER;
+		case ObjectType::ALL:
+			return SIMCONNECT_SIMOBJECT_TYPE_ALL;
+		case ObjectType::AIRCRAFT:
+			return SIMCONNECT_SIMOBJECT_TYPE_AIRCRAFT;
+		case ObjectType::HELICOPTER:
+			return SIMCONNECT_SIMOBJECT_TYPE_HELICOPTER;
+		case ObjectType::BOAT:
+			return SIMCONNECT_SIMOBJECT_TYPE_BOAT;
+		case ObjectType::GROUND:
+			return SIMCONNECT_SIMOBJECT_TYPE_GROUND;
+		default:
+			throw std::exception("Unknown ObjectType value");
+	}
+}
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+#ifdef _WIN32
+#include <functional>
+#include <thread>
+#include "Transport.h"
+
+namespace SimConnect
+{
+	// Transport backed by the SimConnect SDK
+	class NativeTransport : public Transport
+	{
+	private:
+		void* hSimConnect;
+		void* hDataEvent; // signaled by SimConnect when a message is queued
+		std::function<void()> dataPending;
+		std::jthread waiter;
+
+		void StartWaiter();
+
+	public:
+		NativeTransport();
+		~NativeTransport() override;
+
+		bool Open(const char* name) override;
+		void Close() override;
+		bool IsOpen() const override { return hSimConnect != nullptr; }
+		void SetDataPendingCallback(std::function<void()> callback) override;
+
+		bool GetNextDispatch(Packet& packet) override;
+		unsigned int GetLastSentPacketId() override;
+
+		bool AddToDataDefinition(ModelId modelId, const DataModel::VarDef& var) override;
+		void ClearDataDefinition(ModelId modelId) override;
+		bool SubscribeToSystemEvent(EventId eventId, const char* name) override;
+		bool RequestDataOnSimObject(RequestId requestId, ModelId modelId, ObjectId objectId, RequestPeriod period) override;
+		bool RequestDataOnSimObjectType(RequestId requestId, ModelId modelId, unsigned int radius, ObjectType type) override;
+
+		bool MapClientEventToSimEvent(EventId eventId, const char* name) override;
+		bool AddClientEventToNotificationGroup(GroupId groupId, EventId eventId) override;
+		bool TransmitClientEvent(ObjectId objectId, EventId eventId, unsigned int value) override;
+		bool TransmitClientEventEx1(ObjectId objectId, EventId eventId, const unsigned int data[5]) override;
+	};
+}
+#endif
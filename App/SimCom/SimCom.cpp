@@ -1,4 +1,5 @@
 #include "SimCom.h"
+#include "Transport.h"
 #include "Utils/Time.h"
 #include "Utils/version.h"
 #include "Utils/Logger.h"
@@ -62,6 +63,12 @@ void SimCom::RunCallbacks()
 	while (simconnect.RunCallbacks());
 }
 
+void SimCom::SetTransport(std::unique_ptr<SimConnect::Transport> transport)
+{
+	Shutdown();
+	simconnect.SetTransport(std::move(transport));
+}
+
 void SimCom::OnDisconnected(bool reconnect)
 {
 	if (reconnect && allowReconnect)
@@ -24,6 +24,8 @@ public:
 	bool Initialize();
 	void Shutdown();
 	void RunCallbacks();
+	void SetTransport(std::unique_ptr<SimConnect::Transport> transport);
+	void SetDataPendingCallback(const std::function<void()>& callback) { simconnect.SetDataPendingCallback(callback); }
 
 	void AllowReconnect(bool value);
 	auto& GetSimConnect() { return simconnect; }
@@ -1,14 +1,21 @@
-#define WIN32_LEAN_AND_MEAN
-#include <Windows.h>
-#include <SimConnect.h>
+#include <array>
+#include <format>
+#include <stdexcept>
 #include "SimConnect.h"
+#include "Transport.h"
 #include "Utils/Time.h"
 #include "Utils/Logger.h"
+#include "Utils/Metrics.h"
+#include "Utils/Trace.h"
+#ifdef _WIN32
+#include "NativeTransport.h"
+#else
+#include "StandInTransport.h"
+#endif
 
 using namespace SimConnect;
-static_assert(ObjectIdUser == SIMCONNECT_OBJECT_ID_USER);
 
-enum class SystemEvents : DWORD
+enum class SystemEvents : EventId
 {
 	Reserved,
 	ObjectAdded,
@@ -19,7 +26,39 @@ enum class SystemEvents : DWORD
 	UserEvents,
 };
 
-Client::Client() : hSimConnect(0), nextModelId(1), nextRequestId(1), nextEventId((unsigned int)SystemEvents::UserEvents)
+std::unique_ptr<Transport> SimConnect::CreateDefaultTransport()
+{
+#ifdef _WIN32
+	return std::make_unique<NativeTransport>();
+#else
+	return std::make_unique<StandInTransport>();
+#endif
+}
+
+static const std::array<Metrics::Counter*, (size_t)PacketType::UNKNOWN + 1> PacketsReceived = []()
+	{
+		static const char* types[] = { "none", "exception", "open", "quit", "event", "event_object_addremove", "event_ex1", "simobject_data", "simobject_data_bytype", "unknown" };
+		static_assert(std::size(types) == (size_t)PacketType::UNKNOWN + 1);
+
+		std::array<Metrics::Counter*, (size_t)PacketType::UNKNOWN + 1> counters;
+		for (size_t i = 0; i < counters.size(); ++i)
+			counters[i] = &Metrics::AddCounter("simconnect_packets_total", "SimConnect messages dispatched, by type", std::format("type=\"{}\"", types[i]));
+		return counters;
+	}();
+static auto& RequestsOutstanding = Metrics::AddGauge("simconnect_requests_outstanding", "Data requests waiting for or receiving data");
+static auto& RequestsTimedOut = Metrics::AddCounter("simconnect_requests_timed_out_total", "Data requests dropped without an answer");
+static auto& RequestsDismissed = Metrics::AddCounter("simconnect_requests_dismissed_total", "Data requests dropped after an exception from the simulator");
+
+// RequestId layout: low bits - slot index, high bits - slot generation (never 0).
+// 65536 concurrent requests and 65535 generations: a stale packet is only misrouted if its slot went through
+// all of them before it arrived, while the simulator delivers in-flight data within a few dispatches and the
+// timeout wheel drops anything unanswered after a second.
+static constexpr unsigned int RequestSlotBits = 16;
+static constexpr unsigned int RequestSlotMask = (1u << RequestSlotBits) - 1;
+static constexpr unsigned int RequestGenerationMask = ~0u >> RequestSlotBits;
+
+Client::Client() : transport(CreateDefaultTransport()), nextModelId(1), nextEventId((unsigned int)SystemEvents::UserEvents),
+	requestTimeouts(Time::SecondToMs(1)), dispatchSlot(NoSlot), dispatchCanceled(false), resetPending(false)
 {
 }
 
@@ -28,30 +67,35 @@ Client::~Client()
 	Shutdown();
 }
 
+void Client::SetTransport(std::unique_ptr<Transport> value)
+{
+	Shutdown();
+	transport = std::move(value);
+	transport->SetDataPendingCallback(dataPending);
+}
+
+void Client::SetDataPendingCallback(const std::function<void()>& callback)
+{
+	dataPending = callback;
+	transport->SetDataPendingCallback(dataPending);
+}
+
 bool Client::Initialize(const char* name)
 {
-	if (hSimConnect)
+	if (transport->IsOpen())
 		Shutdown();
 
-	auto hr = SimConnect_Open(&hSimConnect, name, 0, 0, 0, 0);
-	if (FAILED(hr))
-	{
-		hSimConnect = 0;
+	if (!transport->Open(name))
 		return false;
-	}
+
 	nextModelId = 1;
-	nextRequestId = 1;
 	nextEventId = (unsigned int)SystemEvents::UserEvents;
 	return true;
 }
 
 void Client::Shutdown()
 {
-	if (hSimConnect)
-	{
-		SimConnect_Close(hSimConnect);
-		hSimConnect = 0;
-	}
+	transport->Close();
 
 	eventConnect = {};
 	eventDisconnect = {};
@@ -61,7 +105,13 @@ void Client::Shutdown()
 	eventSimStart = {};
 	eventSimStop = {};
 	eventPause = {};
-	requests.clear();
+	events.clear();
+	ResetRequests();
+}
+
+bool Client::IsConnected()
+{
+	return transport->IsOpen();
 }
 
 void Client::SetConnectCallback(const std::function<void(const EventServer& event)>& callback)
@@ -84,98 +134,182 @@ static long long CreateTimeStamp()
 	return Time::SteadyNowInt() + Time::SecondToMs(60);
 }
 
-static long long GetExpiredTimeStamp()
+Client::RequestInfo* Client::FindRequest(RequestId requestId)
 {
-	return Time::SteadyNowInt();
+	auto slot = requestId & RequestSlotMask;
+	if (requestId == 0 || slot >= requests.size())
+		return nullptr;
+
+	auto& request = requests[slot];
+	return request.requestId == requestId ? &request : nullptr;
 }
 
-static const char* StringifyError(DWORD e);
-static ObjectType NativeToObjectType(SIMCONNECT_SIMOBJECT_TYPE type);
+RequestId Client::AddRequest(ObjectId objectId, ModelId modelId, bool repeatable, const std::function<void(void* data, ObjectId objId)>& callback)
+{
+	unsigned int slot;
+	if (!freeSlots.empty())
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		if (requests.size() > RequestSlotMask)
+		{
+			Logger::LogError("SimConnect::Client: Too many pending requests");
+			return 0;
+		}
+		slot = (unsigned int)requests.size();
+		requests.emplace_back().generation = 1;
+	}
 
-bool Client::RunCallbacks()
+	auto& request = requests[slot];
+	request.requestId = (request.generation << RequestSlotBits) | slot;
+	request.objectId = objectId;
+	request.modelId = modelId;
+	request.repeatable = repeatable;
+	request.callback = callback;
+	request.timeStamp = CreateTimeStamp();
+	request.packetId = 0;
+
+	requestTimeouts.Schedule(request.requestId, request.timeStamp);
+	return request.requestId;
+}
+
+void Client::SetRequestPacket(RequestId requestId, unsigned int packetId)
 {
-	if (!hSimConnect)
-		return false;
+	auto request = FindRequest(requestId);
+	if (!request || packetId == 0)
+		return;
 
-	SIMCONNECT_RECV* pData = nullptr;
-	DWORD cbData = 0;
+	request->packetId = packetId;
+	requestsByPacket[packetId] = requestId;
+}
 
-	auto hr = SimConnect_GetNextDispatch(hSimConnect, &pData, &cbData);
-	if (FAILED(hr))
-		return false;
+void Client::RemoveRequest(RequestInfo& request)
+{
+	auto slot = request.requestId & RequestSlotMask;
+	if (slot == dispatchSlot)
+	{
+		// callback is running, DispatchData frees the slot once it returns
+		dispatchCanceled = true;
+		return;
+	}
+
+	if (request.packetId != 0)
+		requestsByPacket.erase(request.packetId);
+	request.callback = {};
+	request.complete = {};
+	request.requestId = 0;
+	request.generation = (request.generation % RequestGenerationMask) + 1;
+	freeSlots.push_back(slot);
+}
 
-	switch (pData->dwID)
+void Client::ResetRequests()
+{
+	if (dispatchSlot != NoSlot)
+	{
+		resetPending = true;
+		return;
+	}
+
+	requests.clear();
+	freeSlots.clear();
+	requestsByPacket.clear();
+	requestTimeouts.Clear();
+}
+
+void Client::ExpireRequests()
+{
+	auto now = Time::SteadyNowInt();
+
+	requestTimeouts.Advance(now, [this, now](RequestId requestId)
 	{
-		case SIMCONNECT_RECV_ID_NULL:
+		auto request = FindRequest(requestId);
+		if (!request)
+			return;
+
+		if (request->timeStamp > now)
 		{
-			auto expiredTimeStamp = GetExpiredTimeStamp();
+			requestTimeouts.Schedule(requestId, request->timeStamp);
+			return;
+		}
 
-			for (auto i = requests.begin(); i != requests.end(); ++i)
-			{
-				if (i->timeStamp <= expiredTimeStamp)
-				{
-					Logger::LogDebug("SimConnect::Client: packet {} - request timed out", i->packetId);
-					if (i == requests.begin())
-					{
-						requests.erase(i);
-						i = requests.begin();
-					}
-					else
-						requests.erase(i--);
-				}
-			}
+		Logger::LogDebug("SimConnect::Client: packet {} - request timed out", request->packetId);
+		RequestsTimedOut.Add();
+		RemoveRequest(*request);
+	});
+}
+
+void Client::DispatchData(RequestId requestId, void* data, ObjectId objectId)
+{
+	auto request = FindRequest(requestId);
+	if (!request || !request->callback)
+		return;
+
+	dispatchSlot = requestId & RequestSlotMask;
+	dispatchCanceled = false;
+	request->callback(data, objectId);
+	dispatchSlot = NoSlot;
+
+	if (resetPending)
+	{
+		resetPending = false;
+		ResetRequests();
+	}
+	else if (dispatchCanceled)
+		RemoveRequest(requests[requestId & RequestSlotMask]);
+}
+
+bool Client::RunCallbacks()
+{
+	TRACE_SCOPE("simconnect.dispatch");
+	Packet packet;
+	if (!transport->GetNextDispatch(packet))
+		return false;
+
+	if (packet.type != PacketType::NONE)
+		PacketsReceived[(size_t)packet.type]->Add();
+	switch (packet.type)
+	{
+		case PacketType::NONE:
+		{
+			ExpireRequests();
+			RequestsOutstanding.Set((int64_t)(requests.size() - freeSlots.size()));
 			return false;
 		}
 
-		case SIMCONNECT_RECV_ID_EXCEPTION:
+		case PacketType::EXCEPTION:
 		{
-			auto& info = *reinterpret_cast<SIMCONNECT_RECV_EXCEPTION*>(pData);
+			auto& info = packet.exception;
 #if _DEBUG
-			Logger::LogError("SimConnect::Client Exception: {} {} packet {} index {}", info.dwException, StringifyError(info.dwException), info.dwSendID, info.dwIndex);
+			Logger::LogError("SimConnect::Client Exception: {} {} packet {} index {}", info.exception, info.exceptionName, packet.sendId, info.argId);
 #endif
 
 			if (eventException)
-			{
-				EventException event
-				{
-					info.dwException,
-					info.dwIndex,
-					StringifyError(info.dwException),
-				};
-				eventException(event);
-			}
+				eventException(info);
 
-			for (auto i = requests.begin(); i != requests.end(); ++i)
+			auto i = requestsByPacket.find(packet.sendId);
+			if (i != requestsByPacket.end())
 			{
-				if (i->packetId == info.dwSendID)
-				{
-					Logger::LogDebug("SimConnect::Client: packet {} - request has been dismissed", info.dwSendID);
-					requests.erase(i);
-					break;
-				}
+				Logger::LogDebug("SimConnect::Client: packet {} - request has been dismissed", packet.sendId);
+				RequestsDismissed.Add();
+				if (auto request = FindRequest(i->second))
+					RemoveRequest(*request);
+				else
+					requestsByPacket.erase(i);
 			}
 			break;
 		}
 
-		case SIMCONNECT_RECV_ID_OPEN:
+		case PacketType::OPEN:
 		{
-			if (!eventConnect)
-				break;
-
-			auto* info = reinterpret_cast<SIMCONNECT_RECV_OPEN*>(pData);
-			EventServer event
-			{
-				info->szApplicationName,
-				info->dwApplicationVersionMajor,
-				info->dwApplicationVersionMinor,
-				info->dwSimConnectVersionMajor,
-				info->dwSimConnectVersionMinor,
-			};
-			eventConnect(event);
+			if (eventConnect)
+				eventConnect(packet.server);
 			break;
 		}
 
-		case SIMCONNECT_RECV_ID_QUIT:
+		case PacketType::QUIT:
 		{
 			if (eventDisconnect)
 				eventDisconnect();
@@ -185,37 +319,36 @@ bool Client::RunCallbacks()
 
 		default:
 		{
-			Logger::LogWarn("SimConnect::Client: Unknown event {}", pData->dwID);
+			Logger::LogWarn("SimConnect::Client: Unknown event {}", packet.nativeId);
 			break;
 		}
 
-		case SIMCONNECT_RECV_ID_EVENT_OBJECT_ADDREMOVE:
+		case PacketType::EVENT_OBJECT_ADDREMOVE:
 		{
-			auto* info = reinterpret_cast<SIMCONNECT_RECV_EVENT_OBJECT_ADDREMOVE*>(pData);
-			switch (info->uEventID)
+			switch (packet.eventId)
 			{
-				case (DWORD)SystemEvents::ObjectAdded:
+				case (EventId)SystemEvents::ObjectAdded:
 				{
 					if (eventObjectAdded)
 					{
 						EventObject event
 						{
-							NativeToObjectType(info->eObjType),
-							info->dwData,
+							packet.objectType,
+							packet.data[0],
 						};
 						eventObjectAdded(event);
 					}
 					break;
 				}
 
-				case (DWORD)SystemEvents::ObjectRemoved:
+				case (EventId)SystemEvents::ObjectRemoved:
 				{
 					if (eventObjectRemoved)
 					{
 						EventObject event
 						{
-							NativeToObjectType(info->eObjType),
-							info->dwData,
+							packet.objectType,
+							packet.data[0],
 						};
 						eventObjectRemoved(event);
 					}
@@ -225,68 +358,70 @@ bool Client::RunCallbacks()
 			break;
 		}
 
-		case SIMCONNECT_RECV_ID_SIMOBJECT_DATA:
+		case PacketType::SIMOBJECT_DATA:
 		{
-			auto* info = reinterpret_cast<SIMCONNECT_RECV_SIMOBJECT_DATA*>(pData);
-
-			std::function<void(void* data, ObjectId objId)> callback;
+			auto request = FindRequest(packet.requestId);
+			if (!request)
+				break;
 
-			for (auto i = requests.begin(); i != requests.end(); ++i)
+			if (!request->repeatable)
 			{
-				auto& event = *i;
-				if (event.requestId == info->dwRequestID)
-				{
-					callback = event.callback;
+				auto callback = std::move(request->callback);
+				RemoveRequest(*request);
 
-					if (!event.repeatable)
-						requests.erase(i);
-					break;
-				}
+				if (callback)
+					callback(packet.objectData, packet.objectId);
+			}
+			else
+			{
+				request->timeStamp = CreateTimeStamp();
+				DispatchData(packet.requestId, packet.objectData, packet.objectId);
 			}
-
-			if (callback)
-				callback(&info->dwData, info->dwObjectID);
 			break;
 		}
 
-		case SIMCONNECT_RECV_ID_SIMOBJECT_DATA_BYTYPE:
+		case PacketType::SIMOBJECT_DATA_BYTYPE:
 		{
-			auto* info = reinterpret_cast<SIMCONNECT_RECV_SIMOBJECT_DATA*>(pData);
-			for (auto i = requests.begin(); i != requests.end(); ++i)
+			DispatchData(packet.requestId, packet.objectData, packet.objectId);
+
+			// last entry of the sweep (or an empty sweep) completes the request
+			if (packet.entryNumber >= packet.outOf)
 			{
-				auto& event = *i;
-				if (event.requestId == info->dwRequestID)
-				{
-					event.callback(&info->dwData, info->dwObjectID);
+				auto request = FindRequest(packet.requestId);
+				if (!request)
 					break;
-				}
+
+				auto complete = std::move(request->complete);
+				RemoveRequest(*request);
+
+				if (complete)
+					complete();
 			}
 			break;
 		}
 
-		case SIMCONNECT_RECV_ID_EVENT:
+		case PacketType::EVENT:
 		{
-			auto* info = reinterpret_cast<SIMCONNECT_RECV_EVENT*>(pData);
-			switch (info->uEventID)
+			switch (packet.eventId)
 			{
-				case (DWORD)SystemEvents::SimStart:
+				case (EventId)SystemEvents::SimStart:
 				{
 					if (eventSimStart)
 						eventSimStart();
 					break;
 				}
 
-				case (DWORD)SystemEvents::SimStop:
+				case (EventId)SystemEvents::SimStop:
 				{
 					if (eventSimStop)
 						eventSimStop();
 					break;
 				}
 
-				case (DWORD)SystemEvents::Pause:
+				case (EventId)SystemEvents::Pause:
 				{
 					if (eventPause)
-						eventPause(info->dwData != 0);
+						eventPause(packet.data[0] != 0);
 					break;
 				}
 			}
@@ -294,173 +429,18 @@ bool Client::RunCallbacks()
 			break;
 		}
 
-		case SIMCONNECT_RECV_ID_EVENT_EX1:
+		case PacketType::EVENT_EX1:
 		{
-			auto* info = reinterpret_cast<SIMCONNECT_RECV_EVENT_EX1*>(pData);
-			for (auto& event : events)
-			{
-				if (event.eventId == info->uEventID)
-				{
-					unsigned int data[5]
-					{
-						info->dwData0,
-						info->dwData1,
-						info->dwData2,
-						info->dwData3,
-						info->dwData4
-					};
-					event.callback(data);
-					break;
-				}
-			}
+			auto index = packet.eventId - (EventId)SystemEvents::UserEvents;
+			if (packet.eventId >= (EventId)SystemEvents::UserEvents && index < events.size() && events[index])
+				events[index](packet.data);
+			break;
 		}
 	}
 
 	return true;
 }
 
-static const char* StringifyError(DWORD e)
-{
-	switch (e)
-	{
-		case SIMCONNECT_EXCEPTION_NONE:
-			return "SIMCONNECT_EXCEPTION_NONE";
-		case SIMCONNECT_EXCEPTION_ERROR:
-			return "SIMCONNECT_EXCEPTION_ERROR";
-		case SIMCONNECT_EXCEPTION_SIZE_MISMATCH:
-			return "SIMCONNECT_EXCEPTION_SIZE_MISMATCH";
-		case SIMCONNECT_EXCEPTION_UNRECOGNIZED_ID:
-			return "SIMCONNECT_EXCEPTION_UNRECOGNIZED_ID";
-		case SIMCONNECT_EXCEPTION_UNOPENED:
-			return "SIMCONNECT_EXCEPTION_UNOPENED";
-		case SIMCONNECT_EXCEPTION_VERSION_MISMATCH:
-			return "SIMCONNECT_EXCEPTION_VERSION_MISMATCH";
-		case SIMCONNECT_EXCEPTION_TOO_MANY_GROUPS:
-			return "SIMCONNECT_EXCEPTION_TOO_MANY_GROUPS";
-		case SIMCONNECT_EXCEPTION_NAME_UNRECOGNIZED:
-			return "SIMCONNECT_EXCEPTION_NAME_UNRECOGNIZED";
-		case SIMCONNECT_EXCEPTION_TOO_MANY_EVENT_NAMES:
-			return "SIMCONNECT_EXCEPTION_TOO_MANY_EVENT_NAMES";
-		case SIMCONNECT_EXCEPTION_EVENT_ID_DUPLICATE:
-			return "SIMCONNECT_EXCEPTION_EVENT_ID_DUPLICATE";
-		case SIMCONNECT_EXCEPTION_TOO_MANY_MAPS:
-			return "SIMCONNECT_EXCEPTION_TOO_MANY_MAPS";
-		case SIMCONNECT_EXCEPTION_TOO_MANY_OBJECTS:
-			return "SIMCONNECT_EXCEPTION_TOO_MANY_OBJECTS";
-		case SIMCONNECT_EXCEPTION_TOO_MANY_REQUESTS:
-			return "SIMCONNECT_EXCEPTION_TOO_MANY_REQUESTS";
-		case SIMCONNECT_EXCEPTION_WEATHER_INVALID_PORT:
-			return "SIMCONNECT_EXCEPTION_WEATHER_INVALID_PORT";
-		case SIMCONNECT_EXCEPTION_WEATHER_INVALID_METAR:
-			return "SIMCONNECT_EXCEPTION_WEATHER_INVALID_METAR";
-		case SIMCONNECT_EXCEPTION_WEATHER_UNABLE_TO_GET_OBSERVATION:
-			return "SIMCONNECT_EXCEPTION_WEATHER_UNABLE_TO_GET_OBSERVATION";
-		case SIMCONNECT_EXCEPTION_WEATHER_UNABLE_TO_CREATE_STATION:
-			return "SIMCONNECT_EXCEPTION_WEATHER_UNABLE_TO_CREATE_STATION";
-		case SIMCONNECT_EXCEPTION_WEATHER_UNABLE_TO_REMOVE_STATION:
-			return "SIMCONNECT_EXCEPTION_WEATHER_UNABLE_TO_REMOVE_STATION";
-		case SIMCONNECT_EXCEPTION_INVALID_DATA_TYPE:
-			return "SIMCONNECT_EXCEPTION_INVALID_DATA_TYPE";
-		case SIMCONNECT_EXCEPTION_INVALID_DATA_SIZE:
-			return "SIMCONNECT_EXCEPTION_INVALID_DATA_SIZE";
-		case SIMCONNECT_EXCEPTION_DATA_ERROR:
-			return "SIMCONNECT_EXCEPTION_DATA_ERROR";
-		case SIMCONNECT_EXCEPTION_INVALID_ARRAY:
-			return "SIMCONNECT_EXCEPTION_INVALID_ARRAY";
-		case SIMCONNECT_EXCEPTION_CREATE_OBJECT_FAILED:
-			return "SIMCONNECT_EXCEPTION_CREATE_OBJECT_FAILED";
-		case SIMCONNECT_EXCEPTION_LOAD_FLIGHTPLAN_FAILED:
-			return "SIMCONNECT_EXCEPTION_LOAD_FLIGHTPLAN_FAILED";
-		case SIMCONNECT_EXCEPTION_OPERATION_INVALID_FOR_OBJECT_TYPE:
-			return "SIMCONNECT_EXCEPTION_OPERATION_INVALID_FOR_OBJECT_TYPE";
-		case SIMCONNECT_EXCEPTION_ILLEGAL_OPERATION:
-			return "SIMCONNECT_EXCEPTION_ILLEGAL_OPERATION";
-		case SIMCONNECT_EXCEPTION_ALREADY_SUBSCRIBED:
-			return "SIMCONNECT_EXCEPTION_ALREADY_SUBSCRIBED";
-		case SIMCONNECT_EXCEPTION_INVALID_ENUM:
-			return "SIMCONNECT_EXCEPTION_INVALID_ENUM";
-		case SIMCONNECT_EXCEPTION_DEFINITION_ERROR:
-			return "SIMCONNECT_EXCEPTION_DEFINITION_ERROR";
-		case SIMCONNECT_EXCEPTION_DUPLICATE_ID:
-			return "SIMCONNECT_EXCEPTION_DUPLICATE_ID";
-		case SIMCONNECT_EXCEPTION_DATUM_ID:
-			return "SIMCONNECT_EXCEPTION_DATUM_ID";
-		case SIMCONNECT_EXCEPTION_OUT_OF_BOUNDS:
-			return "SIMCONNECT_EXCEPTION_OUT_OF_BOUNDS";
-		case SIMCONNECT_EXCEPTION_ALREADY_CREATED:
-			return "SIMCONNECT_EXCEPTION_ALREADY_CREATED";
-		case SIMCONNECT_EXCEPTION_OBJECT_OUTSIDE_REALITY_BUBBLE:
-			return "SIMCONNECT_EXCEPTION_OBJECT_OUTSIDE_REALITY_BUBBLE";
-		case SIMCONNECT_EXCEPTION_OBJECT_CONTAINER:
-			return "SIMCONNECT_EXCEPTION_OBJECT_CONTAINER";
-		case SIMCONNECT_EXCEPTION_OBJECT_AI:
-			return "SIMCONNECT_EXCEPTION_OBJECT_AI";
-		case SIMCONNECT_EXCEPTION_OBJECT_ATC:
-			return "SIMCONNECT_EXCEPTION_OBJECT_ATC";
-		case SIMCONNECT_EXCEPTION_OBJECT_SCHEDULE:
-			return "SIMCONNECT_EXCEPTION_OBJECT_SCHEDULE";
-		case SIMCONNECT_EXCEPTION_JETWAY_DATA:
-			return "SIMCONNECT_EXCEPTION_JETWAY_DATA";
-		case SIMCONNECT_EXCEPTION_ACTION_NOT_FOUND:
-			return "SIMCONNECT_EXCEPTION_ACTION_NOT_FOUND";
-		case SIMCONNECT_EXCEPTION_NOT_AN_ACTION:
-			return "SIMCONNECT_EXCEPTION_NOT_AN_ACTION";
-		case SIMCONNECT_EXCEPTION_INCORRECT_ACTION_PARAMS:
-			return "SIMCONNECT_EXCEPTION_INCORRECT_ACTION_PARAMS";
-		case SIMCONNECT_EXCEPTION_GET_INPUT_EVENT_FAILED:
-			return "SIMCONNECT_EXCEPTION_GET_INPUT_EVENT_FAILED";
-		case SIMCONNECT_EXCEPTION_SET_INPUT_EVENT_FAILED:
-			return "SIMCONNECT_EXCEPTION_SET_INPUT_EVENT_FAILED";
-		default:
-			return "Unknown SimConnect Error";
-	}
-}
-
-static SIMCONNECT_DATATYPE VarTypeToDataType(DataModel::VarType type)
-{
-	using VarType = DataModel::VarType;
-
-	switch (type)
-	{
-		case VarType::INVALID:
-			return SIMCONNECT_DATATYPE_INVALID;
-		case VarType::INT32:
-			return SIMCONNECT_DATATYPE_INT32;
-		case VarType::INT64:
-			return SIMCONNECT_DATATYPE_INT64;
-		case VarType::FLOAT32:
-			return SIMCONNECT_DATATYPE_FLOAT32;
-		case VarType::FLOAT64:
-			return SIMCONNECT_DATATYPE_FLOAT64;
-		case VarType::STRING8:
-			return SIMCONNECT_DATATYPE_STRING8;
-		case VarType::STRING32:
-			return SIMCONNECT_DATATYPE_STRING32;
-		case VarType::STRING64:
-			return SIMCONNECT_DATATYPE_STRING64;
-		case VarType::STRING128:
-			return SIMCONNECT_DATATYPE_STRING128;
-		case VarType::STRING256:
-			return SIMCONNECT_DATATYPE_STRING256;
-		case VarType::STRING260:
-			return SIMCONNECT_DATATYPE_STRING260;
-		case VarType::STRINGV:
-			return SIMCONNECT_DATATYPE_STRINGV;
-		case VarType::INITPOSITION:
-			return SIMCONNECT_DATATYPE_INITPOSITION;
-		case VarType::MARKERSTATE:
-			return SIMCONNECT_DATATYPE_MARKERSTATE;
-		case VarType::WAYPOINT:
-			return SIMCONNECT_DATATYPE_WAYPOINT;
-		case VarType::LATLONALT:
-			return SIMCONNECT_DATATYPE_LATLONALT;
-		case VarType::XYZ:
-			return SIMCONNECT_DATATYPE_XYZ;
-		default:
-			throw std::exception("Unknown VarType value");
-	}
-}
-
 static const char* StringifyVarType(DataModel::VarType type)
 {
 	using VarType = DataModel::VarType;
@@ -502,26 +482,7 @@ static const char* StringifyVarType(DataModel::VarType type)
 		case VarType::XYZ:
 			return "XYZ";
 		default:
-			throw std::exception("Unknown VarType value");
-	}
-}
-
-static SIMCONNECT_PERIOD RequestPeriodToNative(RequestPeriod period)
-{
-	switch (period)
-	{
-		case RequestPeriod::NEVER:
-			return SIMCONNECT_PERIOD_NEVER;
-		case RequestPeriod::ONCE:
-			return SIMCONNECT_PERIOD_ONCE;
-		case RequestPeriod::VISUAL_FRAME:
-			return SIMCONNECT_PERIOD_VISUAL_FRAME;
-		case RequestPeriod::SIM_FRAME:
-			return SIMCONNECT_PERIOD_SIM_FRAME;
-		case RequestPeriod::SECOND:
-			return SIMCONNECT_PERIOD_SECOND;
-		default:
-			throw std::exception("Unknown RequestPeriod value");
+			throw std::invalid_argument("Unknown VarType value");
 	}
 }
 
@@ -539,7 +500,7 @@ static bool IsRepeatable(RequestPeriod period)
 		case SECOND:
 			return true;
 		default:
-			throw std::exception("Unknown RequestPeriod value");
+			throw std::invalid_argument("Unknown RequestPeriod value");
 	}
 }
 
@@ -558,49 +519,7 @@ static const char* StringifyRequestPeriod(RequestPeriod period)
 		case RequestPeriod::SECOND:
 			return "SECOND";
 		default:
-			throw std::exception("Unknown RequestPeriod value");
-	}
-}
-
-static ObjectType NativeToObjectType(SIMCONNECT_SIMOBJECT_TYPE type)
-{
-	switch (type)
-	{
-		case SIMCONNECT_SIMOBJECT_TYPE_USER:
-			return ObjectType::USER;
-		case SIMCONNECT_SIMOBJECT_TYPE_ALL:
-			return ObjectType::ALL;
-		case SIMCONNECT_SIMOBJECT_TYPE_AIRCRAFT:
-			return ObjectType::AIRCRAFT;
-		case SIMCONNECT_SIMOBJECT_TYPE_HELICOPTER:
-			return ObjectType::HELICOPTER;
-		case SIMCONNECT_SIMOBJECT_TYPE_BOAT:
-			return ObjectType::BOAT;
-		case SIMCONNECT_SIMOBJECT_TYPE_GROUND:
-			return ObjectType::GROUND;
-		default:
-			throw std::exception("Unknown SIMOBJECT_TYPE value");
-	}
-}
-
-static SIMCONNECT_SIMOBJECT_TYPE ObjectTypeToNative(ObjectType type)
-{
-	switch (type)
-	{
-		case ObjectType::USER:
-			return SIMCONNECT_SIMOBJECT_TYPE_USER;
-		case ObjectType::ALL:
-			return SIMCONNECT_SIMOBJECT_TYPE_ALL;
-		case ObjectType::AIRCRAFT:
-			return SIMCONNECT_SIMOBJECT_TYPE_AIRCRAFT;
-		case ObjectType::HELICOPTER:
-			return SIMCONNECT_SIMOBJECT_TYPE_HELICOPTER;
-		case ObjectType::BOAT:
-			return SIMCONNECT_SIMOBJECT_TYPE_BOAT;
-		case ObjectType::GROUND:
-			return SIMCONNECT_SIMOBJECT_TYPE_GROUND;
-		default:
-			throw std::exception("Unknown ObjectType value");
+			throw std::invalid_argument("Unknown RequestPeriod value");
 	}
 }
 
@@ -621,22 +540,21 @@ static const char* StringifyObjectType(ObjectType type)
 		case ObjectType::GROUND:
 			return "GROUND";
 		default:
-			throw std::exception("Unknown ObjectType value");
+			throw std::invalid_argument("Unknown ObjectType value");
 	}
 }
 
 unsigned int Client::LogLastPacket(const std::string_view& name)
 {
-	DWORD id = 0;
-	auto hr = SimConnect_GetLastSentPacketID(hSimConnect, &id);
-	if (SUCCEEDED(hr))
+	auto id = transport->GetLastSentPacketId();
+	if (id != 0)
 		Logger::LogDebug("SimConnect::Client: Last Packet ID: {} - {}", id, name);
 	return id;
 }
 
 bool Client::RegisterDataModel(DataModel& model)
 {
-	if (nextModelId == ~0)
+	if (nextModelId == ~0u)
 		nextModelId = 1;
 	auto id = nextModelId++;
 	
@@ -648,13 +566,13 @@ bool Client::RegisterDataModel(DataModel& model)
 	{
 		auto& var = array[i];
 
-		auto hr = SimConnect_AddToDataDefinition(hSimConnect, id, var.name, var.unit, VarTypeToDataType(var.type));
+		bool success = transport->AddToDataDefinition(id, var);
 		LogLastPacket("SimConnect_AddToDataDefinition");
-		if (FAILED(hr))
+		if (!success)
 		{
 			Logger::LogError("SimConnect::Client: Failed to add var {} to model {}", var.name, model.GetName());
 			Logger::LogDebug("Var: {} {} {}", var.name, var.unit, StringifyVarType(var.type));
-			SimConnect_ClearDataDefinition(hSimConnect, id);
+			transport->ClearDataDefinition(id);
 			model.modelId = 0;
 			return false;
 		}
@@ -665,9 +583,9 @@ bool Client::RegisterDataModel(DataModel& model)
 
 void Client::SubscribeToObjectAdded(const std::function<void(EventObject event)>& callback)
 {
-	auto hr = SimConnect_SubscribeToSystemEvent(hSimConnect, (DWORD)SystemEvents::ObjectAdded, "ObjectAdded");
+	bool success = transport->SubscribeToSystemEvent((EventId)SystemEvents::ObjectAdded, "ObjectAdded");
 	LogLastPacket("SimConnect_SubscribeToSystemEvent(ObjectAdded)");
-	if (FAILED(hr))
+	if (!success)
 		Logger::LogError("Failed to subscribe to system event ObjectAdded");
 	else
 		eventObjectAdded = callback;
@@ -675,9 +593,9 @@ void Client::SubscribeToObjectAdded(const std::function<void(EventObject event)>
 
 void Client::SubscribeToObjectRemoved(const std::function<void(EventObject event)>& callback)
 {
-	auto hr = SimConnect_SubscribeToSystemEvent(hSimConnect, (DWORD)SystemEvents::ObjectRemoved, "ObjectRemoved");
+	bool success = transport->SubscribeToSystemEvent((EventId)SystemEvents::ObjectRemoved, "ObjectRemoved");
 	LogLastPacket("SimConnect_SubscribeToSystemEvent(ObjectRemoved)");
-	if (FAILED(hr))
+	if (!success)
 		Logger::LogError("Failed to subscribe to system event ObjectRemoved");
 	else
 		eventObjectRemoved = callback;
@@ -685,9 +603,9 @@ void Client::SubscribeToObjectRemoved(const std::function<void(EventObject event
 
 void Client::SubscribeToSimStart(const std::function<void()>& callback)
 {
-	auto hr = SimConnect_SubscribeToSystemEvent(hSimConnect, (DWORD)SystemEvents::SimStart, "SimStart");
+	bool success = transport->SubscribeToSystemEvent((EventId)SystemEvents::SimStart, "SimStart");
 	LogLastPacket("SimConnect_SubscribeToSystemEvent(SimStart)");
-	if (FAILED(hr))
+	if (!success)
 		Logger::LogError("Failed to subscribe to system event SimStart");
 	else
 		eventSimStart = callback;
@@ -695,9 +613,9 @@ void Client::SubscribeToSimStart(const std::function<void()>& callback)
 
 void Client::SubscribeToSimStop(const std::function<void()> callback)
 {
-	auto hr = SimConnect_SubscribeToSystemEvent(hSimConnect, (DWORD)SystemEvents::SimStop, "SimStop");
+	bool success = transport->SubscribeToSystemEvent((EventId)SystemEvents::SimStop, "SimStop");
 	LogLastPacket("SimConnect_SubscribeToSystemEvent(SimStop)");
-	if (FAILED(hr))
+	if (!success)
 		Logger::LogError("Failed to subscribe to system event SimStop");
 	else
 		eventSimStop = callback;
@@ -705,9 +623,9 @@ void Client::SubscribeToSimStop(const std::function<void()> callback)
 
 void Client::SubscribeToPause(const std::function<void(bool paused)>& callback)
 {
-	auto hr = SimConnect_SubscribeToSystemEvent(hSimConnect, (DWORD)SystemEvents::Pause, "Pause");
+	bool success = transport->SubscribeToSystemEvent((EventId)SystemEvents::Pause, "Pause");
 	LogLastPacket("SimConnect_SubscribeToSystemEvent(Pause)");
-	if (FAILED(hr))
+	if (!success)
 		Logger::LogError("Failed to subscribe to system event Pause");
 	else
 		eventPause = callback;
@@ -715,137 +633,112 @@ void Client::SubscribeToPause(const std::function<void(bool paused)>& callback)
 
 RequestId Client::RequestDataOnSimObject(ObjectId objectId, const DataModel& model, const std::function<void(void* data, ObjectId objId)>& callback, RequestPeriod period)
 {
-	if (nextRequestId == ~0)
-		nextRequestId = 1;
-	auto requestId = nextRequestId++;
+	auto requestId = AddRequest(objectId, model.modelId, IsRepeatable(period), callback);
+	if (requestId == 0)
+		return 0;
 
-	auto hr = SimConnect_RequestDataOnSimObject(hSimConnect, requestId, model.modelId, objectId, RequestPeriodToNative(period));
+	bool success = transport->RequestDataOnSimObject(requestId, model.modelId, objectId, period);
 	auto packetId = LogLastPacket("SimConnect_RequestDataOnSimObject");
-	if (FAILED(hr))
+	if (!success)
 	{
 		Logger::LogError("SimConnect::Client: Failed to request data on object {}", objectId);
 		Logger::LogDebug("Args: {} [{}] {} {} [{}]", model.GetName(), model.modelId, objectId, StringifyRequestPeriod(period), (unsigned int)period);
+		RemoveRequest(*FindRequest(requestId));
 		return 0;
 	}
 	else
 	{
-		RequestInfo event
-		{
-			requestId,
-			objectId,
-			model.modelId,
-			IsRepeatable(period),
-			callback,
-			CreateTimeStamp(),
-			packetId,
-		};
-		requests.emplace_back(std::move(event));
+		SetRequestPacket(requestId, packetId);
 		return requestId;
 	}
 }
 
 void Client::CancelDataOnSimObject(RequestId requestId)
 {
-	for (auto i = requests.begin(); i != requests.end(); ++i)
-	{
-		auto& request = *i;
+	auto request = FindRequest(requestId);
+	if (!request)
+		return;
 
-		if (request.requestId == requestId)
-		{
-			CancelDataOnSimObject(request.objectId, request.modelId, request.requestId);
-			requests.erase(i);
-			return;
-		}
-	}
+	CancelDataOnSimObject(request->objectId, request->modelId, request->requestId);
+	RemoveRequest(*request);
 }
 
 void Client::CancelDataOnSimObject(ObjectId objectId, ModelId modelId, RequestId requestId)
 {
-	auto hr = SimConnect_RequestDataOnSimObject(hSimConnect, requestId, modelId, objectId, RequestPeriodToNative(RequestPeriod::NEVER));
-	auto packetId = LogLastPacket("SimConnect_RequestDataOnSimObject(RequestPeriod::NEVER)");
-	if (FAILED(hr))
+	bool success = transport->RequestDataOnSimObject(requestId, modelId, objectId, RequestPeriod::NEVER);
+	LogLastPacket("SimConnect_RequestDataOnSimObject(RequestPeriod::NEVER)");
+	if (!success)
 	{
 		Logger::LogError("SimConnect::Client: Failed to cancel request data on object {}", objectId);
 		Logger::LogDebug("Args: {} {} {} {} [{}]", objectId, modelId, objectId, StringifyRequestPeriod(RequestPeriod::NEVER), (unsigned int)RequestPeriod::NEVER);
 	}
 }
 
-RequestId Client::RequestDataOnSimObjectType(ObjectType type, const DataModel& model, const std::function<void(void* data, ObjectId objId)>& callback, unsigned int radius)
+RequestId Client::RequestDataOnSimObjectType(ObjectType type, const DataModel& model, const std::function<void(void* data, ObjectId objId)>& callback, unsigned int radius, const std::function<void()>& complete)
 {
-	if (nextRequestId == ~0)
-		nextRequestId = 1;
-	auto requestId = nextRequestId++;
+	auto requestId = AddRequest(0, model.modelId, false, callback);
+	if (requestId == 0)
+		return 0;
+	FindRequest(requestId)->complete = complete;
 
-	auto hr = SimConnect_RequestDataOnSimObjectType(hSimConnect, requestId, model.modelId, radius, ObjectTypeToNative(type));
+	bool success = transport->RequestDataOnSimObjectType(requestId, model.modelId, radius, type);
 	auto packetId = LogLastPacket("SimConnect_RequestDataOnSimObjectType");
-	if (FAILED(hr))
+	if (!success)
 	{
 		Logger::LogError("SimConnect::Client: Failed to request data on object type {}", StringifyObjectType(type));
 		Logger::LogDebug("Args: {} [{}] {} [{}] {}", model.GetName(), model.modelId, StringifyObjectType(type), (unsigned int)type, radius);
+		RemoveRequest(*FindRequest(requestId));
 		return 0;
 	}
 	else
 	{
-		RequestInfo event
-		{
-			requestId,
-			0,
-			model.modelId,
-			false,
-			callback,
-			CreateTimeStamp(),
-			packetId,
-		};
-		requests.emplace_back(std::move(event));
+		SetRequestPacket(requestId, packetId);
 		return requestId;
 	}
 }
 
 EventId Client::MapEvent(const char* event, const std::function<void(unsigned int data[5])>& callback)
 {
-	if (nextEventId == ~0)
+	if (nextEventId == ~0u)
 		return 0;
 	auto id = nextEventId++;
 
-	auto hr = SimConnect_MapClientEventToSimEvent(hSimConnect, id, event);
+	bool success = transport->MapClientEventToSimEvent(id, event);
 	LogLastPacket("SimConnect_MapClientEventToSimEvent()");
-	if (FAILED(hr))
+	if (!success)
 	{
 		Logger::LogError("Failed to map event {}", event);
 		return 0;
 	}
 	else
 	{
-		EventInfo event
-		{
-			id,
-			callback,
-		};
-		events.emplace_back(std::move(event));
+		events.resize(id - (EventId)SystemEvents::UserEvents + 1);
+		events.back() = callback;
 		return id;
 	}
 }
 
 void Client::AddEventToGroup(EventId evid, GroupId gid)
 {
-	auto hr = SimConnect_AddClientEventToNotificationGroup(hSimConnect, gid, evid);
+	bool success = transport->AddClientEventToNotificationGroup(gid, evid);
 	LogLastPacket("SimConnect_AddClientEventToNotificationGroup()");
-	if (FAILED(hr))
+	if (!success)
 		Logger::LogError("Failed to add event {} to {}", evid, gid);
 }
 
 void Client::TransmitEvent(EventId evid, unsigned int value)
 {
-	auto hr = SimConnect_TransmitClientEvent(hSimConnect, 0, evid, value, SIMCONNECT_GROUP_PRIORITY_HIGHEST, SIMCONNECT_EVENT_FLAG_GROUPID_IS_PRIORITY);
+	bool success = transport->TransmitClientEvent(0, evid, value);
 	LogLastPacket("SimConnect_TransmitClientEvent()");
-	if (FAILED(hr))
+	if (!success)
 		Logger::LogError("Failed to transmit event {}", evid);
 }
 
 void Client::TransmitEventEx(ObjectId objectId, EventId evid, unsigned int value, unsigned int value1, unsigned int value2, unsigned int value3, unsigned int value4)
 {
-	SimConnect_TransmitClientEvent_EX1(hSimConnect, objectId, evid, SIMCONNECT_GROUP_PRIORITY_HIGHEST, SIMCONNECT_EVENT_FLAG_GROUPID_IS_PRIORITY, value, value1, value2, value3, value4);
-	auto hr = LogLastPacket("SimConnect_TransmitClientEvent_EX1()");
-	if (FAILED(hr))
+	unsigned int data[5]{ value, value1, value2, value3, value4 };
+	bool success = transport->TransmitClientEventEx1(objectId, evid, data);
+	LogLastPacket("SimConnect_TransmitClientEvent_EX1()");
+	if (!success)
 		Logger::LogError("Failed to transmit event {}", evid);
 }
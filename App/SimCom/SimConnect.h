@@ -1,6 +1,11 @@
 #pragma once
+#include <deque>
 #include <functional>
+#include <memory>
 #include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Utils/TimerWheel.h"
 
 namespace SimConnect
 {
@@ -57,7 +62,7 @@ namespace SimConnect
 	struct EventInputDef
 	{
 		const char* name;
-		unsigned __int64 hash;
+		unsigned long long hash;
 	};
 
 	struct ObjectData
@@ -101,29 +106,28 @@ namespace SimConnect
 		virtual const char* GetName() const = 0;
 	};
 
+	class Transport;
+
 	class Client
 	{
 	private:
 		struct RequestInfo
 		{
-			RequestId requestId;
+			RequestId requestId; // 0 - free slot
 			ObjectId objectId;
 			ModelId modelId;
 
 			bool repeatable;
 			std::function<void(void* data, ObjectId objId)> callback;
+			std::function<void()> complete; // by-type request - after the last entry
 			long long timeStamp;
 			unsigned int packetId;
+			unsigned int generation;
 		};
-		struct EventInfo
-		{
-			EventId eventId;
-			std::function<void(unsigned int data[5])> callback;
-		};
+		static constexpr unsigned int NoSlot = ~0u;
 
-		void* hSimConnect;
+		std::unique_ptr<Transport> transport;
 		ModelId nextModelId;
-		RequestId nextRequestId;
 		EventId nextEventId;
 
 		std::function<void(const EventServer& event)> eventConnect;
@@ -134,8 +138,25 @@ namespace SimConnect
 		std::function<void()> eventSimStart;
 		std::function<void()> eventSimStop;
 		std::function<void(bool paused)> eventPause;
-		std::vector<RequestInfo> requests;
-		std::vector<EventInfo> events;
+		std::function<void()> dataPending;
+
+		// RequestId encodes slot index and slot generation; deque keeps callbacks in place while they run
+		std::deque<RequestInfo> requests;
+		std::vector<unsigned int> freeSlots;
+		std::unordered_map<unsigned int, RequestId> requestsByPacket;
+		TimerWheel<RequestId> requestTimeouts;
+		unsigned int dispatchSlot;
+		bool dispatchCanceled;
+		bool resetPending;
+		std::deque<std::function<void(unsigned int data[5])>> events; // indexed from first user EventId
+
+		RequestInfo* FindRequest(RequestId requestId);
+		RequestId AddRequest(ObjectId objectId, ModelId modelId, bool repeatable, const std::function<void(void* data, ObjectId objId)>& callback);
+		void SetRequestPacket(RequestId requestId, unsigned int packetId);
+		void RemoveRequest(RequestInfo& request);
+		void ResetRequests();
+		void ExpireRequests();
+		void DispatchData(RequestId requestId, void* data, ObjectId objectId);
 
 		unsigned int LogLastPacket(const std::string_view& name);
 		void CancelDataOnSimObject(ObjectId objectId, ModelId modelId, RequestId requestId);
@@ -144,6 +165,10 @@ namespace SimConnect
 		Client();
 		~Client();
 
+		void SetTransport(std::unique_ptr<Transport> transport);
+		// Called from a transport thread when packets are waiting for RunCallbacks
+		void SetDataPendingCallback(const std::function<void()>& callback);
+
 		bool Initialize(const char* name);
 		void Shutdown();
 
@@ -161,13 +186,13 @@ namespace SimConnect
 		bool RegisterDataModel(DataModel& model);
 		RequestId RequestDataOnSimObject(ObjectId objectId, const DataModel& model, const std::function<void(void* data, ObjectId objId)>& callback, RequestPeriod period = RequestPeriod::ONCE);
 		void CancelDataOnSimObject(RequestId requestId);
-		RequestId RequestDataOnSimObjectType(ObjectType type, const DataModel& model, const std::function<void(void* data, ObjectId objId)>& callback, unsigned int radius);
+		RequestId RequestDataOnSimObjectType(ObjectType type, const DataModel& model, const std::function<void(void* data, ObjectId objId)>& callback, unsigned int radius, const std::function<void()>& complete = {});
 
 		EventId MapEvent(const char* event, const std::function<void(unsigned int data[5])>& callback);
 		void AddEventToGroup(EventId evid, GroupId gid);
 		void TransmitEvent(EventId evid, unsigned int value);
 		void TransmitEventEx(ObjectId objectId, EventId evid, unsigned int value, unsigned int value1 = 0, unsigned int value2 = 0, unsigned int value3 = 0, unsigned int value4 = 0);
 
-		bool IsConnected() { return hSimConnect != nullptr; }
+		bool IsConnected();
 	};
 }
@@ -0,0 +1,656 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <numbers>
+#include <string_view>
+#include "StandInTransport.h"
+#include "Utils/Time.h"
+
+using namespace SimConnect;
+
+static constexpr ObjectId UserObjectId = 1;
+static constexpr unsigned int ExceptionUnrecognizedId = 3;
+static constexpr double MetersPerDegree = 111120.0;
+
+static const char* const Models[] = { "A320", "B738", "A359", "B77W", "E190", "C172", "AT76", "B38M" };
+
+static unsigned int GetVarSize(DataModel::VarType type)
+{
+	using VarType = DataModel::VarType;
+
+	switch (type)
+	{
+		case VarType::INT32:
+		case VarType::FLOAT32:
+		case VarType::STRINGV:
+			return 4;
+		case VarType::INT64:
+		case VarType::FLOAT64:
+		case VarType::STRING8:
+			return 8;
+		case VarType::STRING32:
+			return 32;
+		case VarType::STRING64:
+			return 64;
+		case VarType::STRING128:
+			return 128;
+		case VarType::STRING256:
+			return 256;
+		case VarType::STRING260:
+			return 260;
+		case VarType::INITPOSITION:
+			return 56;
+		case VarType::MARKERSTATE:
+			return 68;
+		case VarType::WAYPOINT:
+			return 48;
+		case VarType::LATLONALT:
+		case VarType::XYZ:
+			return 24;
+		default:
+			return 0;
+	}
+}
+
+StandInTransport::StandInTransport() : StandInTransport(Scenario{})
+{
+}
+
+StandInTransport::StandInTransport(const Scenario& scenario) : scenario(scenario), open(false)
+{
+	Reset();
+}
+
+StandInTransport::~StandInTransport()
+{
+}
+
+void StandInTransport::Reset()
+{
+	quitQueued = false;
+	pumped = false;
+	openTime = 0;
+	lastPump = 0;
+	spawnBudget = 0;
+	churnBudget = 0;
+	lastPacketId = 0;
+	nextObjectId = UserObjectId + 1;
+	spawnedCount = 0;
+	random.seed(5170);
+
+	eventObjectAdded = 0;
+	eventObjectRemoved = 0;
+
+	models.clear();
+	objects.clear();
+	spawnOrder.clear();
+	periodic.clear();
+	pending.clear();
+}
+
+bool StandInTransport::Open(const char* name)
+{
+	Reset();
+	open = true;
+	openTime = Time::SteadyNowInt();
+	lastPump = openTime;
+
+	CreateObject(ObjectType::AIRCRAFT, true);
+
+	Pending item{};
+	item.type = PacketType::OPEN;
+	pending.push_back(item);
+	return true;
+}
+
+void StandInTransport::Close()
+{
+	open = false;
+	Reset();
+}
+
+void StandInTransport::Spawn(unsigned int count, ObjectType type)
+{
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		auto& object = CreateObject(type, false);
+		if (eventObjectAdded == 0)
+			continue;
+
+		Pending item{};
+		item.type = PacketType::EVENT_OBJECT_ADDREMOVE;
+		item.eventId = eventObjectAdded;
+		item.objectType = object.type;
+		item.objectId = object.objectId;
+		pending.push_back(item);
+	}
+}
+
+void StandInTransport::Despawn(unsigned int count)
+{
+	while (count > 0 && !spawnOrder.empty())
+	{
+		auto objectId = spawnOrder.front();
+		spawnOrder.pop_front();
+		if (!objects.contains(objectId))
+			continue;
+
+		RemoveObject(objectId);
+		--count;
+	}
+}
+
+void StandInTransport::Quit()
+{
+	if (!open || quitQueued)
+		return;
+	quitQueued = true;
+
+	Pending item{};
+	item.type = PacketType::QUIT;
+	pending.push_back(item);
+}
+
+bool StandInTransport::GetNextDispatch(Packet& packet)
+{
+	if (!open)
+		return false;
+
+	if (pending.empty() && !pumped)
+	{
+		Pump();
+		pumped = true;
+	}
+
+	packet = {};
+	if (pending.empty())
+	{
+		pumped = false;
+		packet.type = PacketType::NONE;
+		return true;
+	}
+
+	auto item = pending.front();
+	pending.pop_front();
+
+	packet.type = item.type;
+	switch (item.type)
+	{
+		case PacketType::OPEN:
+		{
+			packet.server = { "Stand-in", 1, 0, 12, 0 };
+			break;
+		}
+
+		case PacketType::EXCEPTION:
+		{
+			packet.exception.exception = item.exception;
+			packet.exception.exceptionName = item.exception == ExceptionUnrecognizedId ? "SIMCONNECT_EXCEPTION_UNRECOGNIZED_ID" : "SIMCONNECT_EXCEPTION_ERROR";
+			packet.sendId = item.sendId;
+			break;
+		}
+
+		case PacketType::EVENT_OBJECT_ADDREMOVE:
+		{
+			packet.eventId = item.eventId;
+			packet.objectType = item.objectType;
+			packet.data[0] = item.objectId;
+			break;
+		}
+
+		case PacketType::SIMOBJECT_DATA:
+		case PacketType::SIMOBJECT_DATA_BYTYPE:
+		{
+			auto* object = FindObject(item.objectId);
+			if (object)
+				Move(*object, Time::SteadyNowInt());
+
+			static const Model empty;
+			WriteData(item.modelId < models.size() ? models[item.modelId] : empty, object);
+
+			packet.requestId = item.requestId;
+			packet.objectId = item.objectId;
+			packet.entryNumber = item.entryNumber;
+			packet.outOf = item.outOf;
+			packet.objectData = dataBuffer.data();
+			break;
+		}
+
+		default:
+			break;
+	}
+	return true;
+}
+
+void StandInTransport::Pump()
+{
+	auto now = Time::SteadyNowInt();
+	double dt = double(now - lastPump) / 1000.0;
+	lastPump = now;
+
+	if (scenario.quitAfter > 0 && now - openTime >= scenario.quitAfter)
+		Quit();
+	if (quitQueued)
+		return;
+
+	churnBudget += scenario.churnRate * dt;
+	if (churnBudget >= 1)
+	{
+		auto count = (unsigned int)churnBudget;
+		churnBudget -= count;
+		Despawn(count);
+	}
+
+	auto aiCount = (unsigned int)objects.size() - 1;
+	if (aiCount < scenario.objectCount)
+	{
+		unsigned int count = scenario.objectCount - aiCount;
+		if (scenario.spawnRate > 0)
+		{
+			spawnBudget += scenario.spawnRate * dt;
+			count = std::min(count, (unsigned int)spawnBudget);
+			spawnBudget -= count;
+		}
+
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			auto ratio = scenario.helicopterRatio;
+			bool helicopter = ratio > 0 && (spawnedCount % ratio) == ratio - 1;
+			Spawn(1, helicopter ? ObjectType::HELICOPTER : ObjectType::AIRCRAFT);
+		}
+	}
+	else
+		spawnBudget = 0;
+
+	for (auto& request : periodic)
+	{
+		if (request.nextDue > now)
+			continue;
+
+		QueueData(PacketType::SIMOBJECT_DATA, request.requestId, request.modelId, request.objectId, 1, 1);
+		request.nextDue += request.period;
+		if (request.nextDue <= now)
+			request.nextDue = now + request.period;
+	}
+}
+
+StandInTransport::SimObject& StandInTransport::CreateObject(ObjectType type, bool isUser)
+{
+	std::uniform_real_distribution<double> offset(-scenario.spread, scenario.spread);
+	std::uniform_real_distribution<double> heading(0, 360);
+	std::uniform_int_distribution<int> altitude(10, 390);
+	std::uniform_int_distribution<int> speed(140, 480);
+	std::uniform_int_distribution<size_t> model(0, std::size(Models) - 1);
+
+	auto objectId = isUser ? UserObjectId : nextObjectId++;
+	auto& object = objects[objectId];
+	object.objectId = objectId;
+	object.type = type;
+	object.isUser = isUser;
+	object.longitude = scenario.longitude + (isUser ? 0 : offset(random));
+	object.latitude = scenario.latitude + (isUser ? 0 : offset(random));
+	object.heading = heading(random);
+	object.altitude = altitude(random) * 100;
+	object.groundSpeed = type == ObjectType::HELICOPTER ? speed(random) / 4 : speed(random);
+	object.lastMove = Time::SteadyNowInt();
+
+	std::memset(object.model, 0, sizeof(object.model));
+	std::strncpy(object.model, type == ObjectType::HELICOPTER ? "H145" : Models[model(random)], sizeof(object.model) - 1);
+	std::snprintf(object.callsign, sizeof(object.callsign), "SIM%04u", objectId % 10000);
+
+	if (!isUser)
+	{
+		spawnOrder.push_back(objectId);
+		++spawnedCount;
+	}
+	return object;
+}
+
+void StandInTransport::RemoveObject(ObjectId objectId)
+{
+	auto i = objects.find(objectId);
+	if (i == objects.end())
+		return;
+	auto type = i->second.type;
+	objects.erase(i);
+
+	for (size_t j = 0; j < periodic.size();)
+	{
+		if (periodic[j].objectId == objectId)
+		{
+			periodic[j] = periodic.back();
+			periodic.pop_back();
+		}
+		else
+			++j;
+	}
+
+	if (eventObjectRemoved == 0)
+		return;
+
+	Pending item{};
+	item.type = PacketType::EVENT_OBJECT_ADDREMOVE;
+	item.eventId = eventObjectRemoved;
+	item.objectType = type;
+	item.objectId = objectId;
+	pending.push_back(item);
+}
+
+void StandInTransport::Move(SimObject& object, long long now)
+{
+	double hours = double(now - object.lastMove) / 3600000.0;
+	object.lastMove = now;
+	if (hours <= 0)
+		return;
+
+	double distance = object.groundSpeed * hours / 60.0; // degrees of arc
+	double heading = object.heading * std::numbers::pi / 180.0;
+	double latitude = object.latitude * std::numbers::pi / 180.0;
+
+	object.latitude += distance * std::cos(heading);
+	object.longitude += distance * std::sin(heading) / std::max(std::cos(latitude), 0.01);
+
+	if (object.latitude > 89 || object.latitude < -89)
+	{
+		object.latitude = std::clamp(object.latitude, -89.0, 89.0);
+		object.heading = std::fmod(object.heading + 180, 360);
+	}
+	if (object.longitude > 180)
+		object.longitude -= 360;
+	else if (object.longitude < -180)
+		object.longitude += 360;
+}
+
+void StandInTransport::QueueData(PacketType type, RequestId requestId, ModelId modelId, ObjectId objectId, unsigned int entryNumber, unsigned int outOf)
+{
+	Pending item{};
+	item.type = type;
+	item.requestId = requestId;
+	item.modelId = modelId;
+	item.objectId = objectId;
+	item.entryNumber = entryNumber;
+	item.outOf = outOf;
+	pending.push_back(item);
+}
+
+void StandInTransport::QueueException(unsigned int exception, unsigned int sendId)
+{
+	Pending item{};
+	item.type = PacketType::EXCEPTION;
+	item.exception = exception;
+	item.sendId = sendId;
+	pending.push_back(item);
+}
+
+void StandInTransport::WriteData(const Model& model, const SimObject* object)
+{
+	dataBuffer.assign(std::max(model.size, 4u), 0);
+	if (!object)
+		return;
+
+	for (auto& field : model.fields)
+	{
+		double value = 0;
+		const char* text = nullptr;
+
+		switch (field.var)
+		{
+			case SimVar::LONGITUDE:
+				value = object->longitude;
+				break;
+			case SimVar::LATITUDE:
+				value = object->latitude;
+				break;
+			case SimVar::HEADING:
+				value = object->heading;
+				break;
+			case SimVar::ALTITUDE:
+			case SimVar::GROUND_ALTITUDE:
+				value = object->altitude;
+				break;
+			case SimVar::GROUND_SPEED:
+				value = object->groundSpeed;
+				break;
+			case SimVar::IS_USER:
+				value = object->isUser ? 1 : 0;
+				break;
+			case SimVar::MODEL:
+				text = object->model;
+				break;
+			case SimVar::CALLSIGN:
+			case SimVar::FLIGHT_NUMBER:
+				text = object->callsign;
+				break;
+			case SimVar::AIRLINE:
+				text = "SIM";
+				break;
+			case SimVar::TITLE:
+				text = "Stand-in Aircraft";
+				break;
+			default:
+				continue;
+		}
+
+		auto* dest = dataBuffer.data() + field.offset;
+		switch (field.type)
+		{
+			case DataModel::VarType::INT32:
+			{
+				auto v = (int)value;
+				std::memcpy(dest, &v, sizeof(v));
+				break;
+			}
+			case DataModel::VarType::INT64:
+			{
+				auto v = (long long)value;
+				std::memcpy(dest, &v, sizeof(v));
+				break;
+			}
+			case DataModel::VarType::FLOAT32:
+			{
+				auto v = (float)value;
+				std::memcpy(dest, &v, sizeof(v));
+				break;
+			}
+			case DataModel::VarType::FLOAT64:
+			{
+				std::memcpy(dest, &value, sizeof(value));
+				break;
+			}
+			default:
+			{
+				if (text)
+					std::strncpy(dest, text, field.size - 1);
+				break;
+			}
+		}
+	}
+}
+
+StandInTransport::SimObject* StandInTransport::FindObject(ObjectId objectId)
+{
+	if (objectId == ObjectIdUser)
+		objectId = UserObjectId;
+
+	auto i = objects.find(objectId);
+	if (i == objects.end())
+		return nullptr;
+	return &i->second;
+}
+
+static bool StartsWith(const char* str, std::string_view prefix)
+{
+	return std::string_view(str).starts_with(prefix);
+}
+
+bool StandInTransport::AddToDataDefinition(ModelId modelId, const DataModel::VarDef& var)
+{
+	++lastPacketId;
+	if (modelId >= models.size())
+		models.resize(modelId + 1);
+	auto& model = models[modelId];
+
+	auto size = GetVarSize(var.type);
+	if (size == 0 || !var.name)
+		return true;
+
+	SimVar simVar = SimVar::NONE;
+	std::string_view name = var.name;
+	if (name == "PLANE LONGITUDE")
+		simVar = SimVar::LONGITUDE;
+	else if (name == "PLANE LATITUDE")
+		simVar = SimVar::LATITUDE;
+	else if (StartsWith(var.name, "PLANE HEADING DEGREES"))
+		simVar = SimVar::HEADING;
+	else if (name == "PLANE ALTITUDE" || name == "INDICATED ALTITUDE")
+		simVar = SimVar::ALTITUDE;
+	else if (name == "PLANE ALT ABOVE GROUND")
+		simVar = SimVar::GROUND_ALTITUDE;
+	else if (name == "GROUND VELOCITY")
+		simVar = SimVar::GROUND_SPEED;
+	else if (name == "IS USER SIM")
+		simVar = SimVar::IS_USER;
+	else if (name == "ATC MODEL")
+		simVar = SimVar::MODEL;
+	else if (name == "ATC ID")
+		simVar = SimVar::CALLSIGN;
+	else if (name == "ATC AIRLINE")
+		simVar = SimVar::AIRLINE;
+	else if (name == "ATC FLIGHT NUMBER")
+		simVar = SimVar::FLIGHT_NUMBER;
+	else if (name == "TITLE")
+		simVar = SimVar::TITLE;
+
+	model.fields.push_back({ simVar, var.type, model.size, size });
+	model.size += size;
+	return true;
+}
+
+void StandInTransport::ClearDataDefinition(ModelId modelId)
+{
+	++lastPacketId;
+	if (modelId < models.size())
+		models[modelId] = {};
+}
+
+bool StandInTransport::SubscribeToSystemEvent(EventId eventId, const char* name)
+{
+	++lastPacketId;
+	std::string_view str = name;
+	if (str == "ObjectAdded")
+		eventObjectAdded = eventId;
+	else if (str == "ObjectRemoved")
+		eventObjectRemoved = eventId;
+	return true;
+}
+
+bool StandInTransport::RequestDataOnSimObject(RequestId requestId, ModelId modelId, ObjectId objectId, RequestPeriod period)
+{
+	auto packetId = ++lastPacketId;
+
+	for (size_t i = 0; i < periodic.size(); ++i)
+	{
+		if (periodic[i].requestId == requestId)
+		{
+			periodic[i] = periodic.back();
+			periodic.pop_back();
+			break;
+		}
+	}
+
+	if (period == RequestPeriod::NEVER)
+		return true;
+
+	auto* object = FindObject(objectId);
+	if (!object || modelId >= models.size())
+	{
+		QueueException(ExceptionUnrecognizedId, packetId);
+		return true;
+	}
+
+	if (period == RequestPeriod::ONCE)
+	{
+		QueueData(PacketType::SIMOBJECT_DATA, requestId, modelId, object->objectId, 1, 1);
+		return true;
+	}
+
+	long long interval = 0;
+	if (period == RequestPeriod::SECOND)
+		interval = 1000 / std::max(scenario.dataRate, 1u);
+	periodic.push_back({ requestId, modelId, object->objectId, interval, Time::SteadyNowInt() });
+	return true;
+}
+
+bool StandInTransport::RequestDataOnSimObjectType(RequestId requestId, ModelId modelId, unsigned int radius, ObjectType type)
+{
+	auto packetId = ++lastPacketId;
+	if (modelId >= models.size())
+	{
+		QueueException(ExceptionUnrecognizedId, packetId);
+		return true;
+	}
+
+	auto& user = objects[UserObjectId];
+	std::vector<ObjectId> found;
+	for (auto& [objectId, object] : objects)
+	{
+		bool match = false;
+		switch (type)
+		{
+			case ObjectType::USER:
+				match = object.isUser;
+				break;
+			case ObjectType::ALL:
+				match = true;
+				break;
+			default:
+				match = object.type == type;
+				break;
+		}
+		if (!match)
+			continue;
+
+		double dy = (object.latitude - user.latitude) * MetersPerDegree;
+		double dx = (object.longitude - user.longitude) * MetersPerDegree * std::cos(user.latitude * std::numbers::pi / 180.0);
+		if (!object.isUser && dx * dx + dy * dy > double(radius) * radius)
+			continue;
+		found.push_back(objectId);
+	}
+
+	// an empty sweep still completes with a single entry-less packet
+	if (found.empty())
+	{
+		QueueData(PacketType::SIMOBJECT_DATA_BYTYPE, requestId, modelId, 0, 0, 0);
+		return true;
+	}
+
+	auto count = (unsigned int)found.size();
+	for (unsigned int i = 0; i < count; ++i)
+		QueueData(PacketType::SIMOBJECT_DATA_BYTYPE, requestId, modelId, found[i], i + 1, count);
+	return true;
+}
+
+bool StandInTransport::MapClientEventToSimEvent(EventId eventId, const char* name)
+{
+	++lastPacketId;
+	return true;
+}
+
+bool StandInTransport::AddClientEventToNotificationGroup(GroupId groupId, EventId eventId)
+{
+	++lastPacketId;
+	return true;
+}
+
+bool StandInTransport::TransmitClientEvent(ObjectId objectId, EventId eventId, unsigned int value)
+{
+	++lastPacketId;
+	return true;
+}
+
+bool StandInTransport::TransmitClientEventEx1(ObjectId objectId, EventId eventId, const unsigned int data[5])
+{
+	++lastPacketId;
+	return true;
+}
@@ -0,0 +1,160 @@
+#pragma once
+#include <deque>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "Transport.h"
+
+namespace SimConnect
+{
+	// In-process simulator stand-in. Emits the same packet stream as a running sim
+	// (OPEN/QUIT, ObjectAdded/Removed, SIMOBJECT_DATA, BYTYPE) for a scripted fleet of objects,
+	// so the radar and WebCast can be driven without SimConnect.
+	class StandInTransport : public Transport
+	{
+	public:
+		struct Scenario
+		{
+			unsigned int objectCount = 100; // AI objects kept alive
+			unsigned int spawnRate = 100; // ObjectAdded per second until objectCount is reached
+			unsigned int churnRate = 0; // objects despawned per second (respawned by spawnRate)
+			unsigned int dataRate = 1; // packets per second for RequestPeriod::SECOND
+			unsigned int helicopterRatio = 10; // every n-th object is a helicopter, 0 - none
+			long long quitAfter = 0; // ms after open, 0 - never
+
+			double latitude = 52.166;
+			double longitude = 20.967;
+			double spread = 1.5; // degrees around origin
+		};
+
+		StandInTransport();
+		explicit StandInTransport(const Scenario& scenario);
+		~StandInTransport() override;
+
+		// scripting
+		void Spawn(unsigned int count, ObjectType type = ObjectType::AIRCRAFT);
+		void Despawn(unsigned int count);
+		void Quit();
+
+		bool Open(const char* name) override;
+		void Close() override;
+		bool IsOpen() const override { return open; }
+
+		bool GetNextDispatch(Packet& packet) override;
+		unsigned int GetLastSentPacketId() override { return lastPacketId; }
+
+		bool AddToDataDefinition(ModelId modelId, const DataModel::VarDef& var) override;
+		void ClearDataDefinition(ModelId modelId) override;
+		bool SubscribeToSystemEvent(EventId eventId, const char* name) override;
+		bool RequestDataOnSimObject(RequestId requestId, ModelId modelId, ObjectId objectId, RequestPeriod period) override;
+		bool RequestDataOnSimObjectType(RequestId requestId, ModelId modelId, unsigned int radius, ObjectType type) override;
+
+		bool MapClientEventToSimEvent(EventId eventId, const char* name) override;
+		bool AddClientEventToNotificationGroup(GroupId groupId, EventId eventId) override;
+		bool TransmitClientEvent(ObjectId objectId, EventId eventId, unsigned int value) override;
+		bool TransmitClientEventEx1(ObjectId objectId, EventId eventId, const unsigned int data[5]) override;
+
+	private:
+		enum class SimVar
+		{
+			NONE,
+			LONGITUDE,
+			LATITUDE,
+			HEADING,
+			ALTITUDE,
+			GROUND_ALTITUDE,
+			GROUND_SPEED,
+			IS_USER,
+			MODEL,
+			CALLSIGN,
+			AIRLINE,
+			FLIGHT_NUMBER,
+			TITLE,
+		};
+
+		struct Field
+		{
+			SimVar var;
+			DataModel::VarType type;
+			unsigned int offset;
+			unsigned int size;
+		};
+
+		struct Model
+		{
+			std::vector<Field> fields;
+			unsigned int size = 0;
+		};
+
+		struct SimObject
+		{
+			ObjectId objectId;
+			ObjectType type;
+			bool isUser;
+			double longitude;
+			double latitude;
+			double heading;
+			int altitude;
+			int groundSpeed;
+			long long lastMove;
+			char model[8];
+			char callsign[8];
+		};
+
+		struct Periodic
+		{
+			RequestId requestId;
+			ModelId modelId;
+			ObjectId objectId;
+			long long period; // 0 - every pump
+			long long nextDue;
+		};
+
+		struct Pending
+		{
+			PacketType type;
+			EventId eventId;
+			ObjectType objectType;
+			ObjectId objectId;
+			RequestId requestId;
+			ModelId modelId;
+			unsigned int entryNumber;
+			unsigned int outOf;
+			unsigned int exception;
+			unsigned int sendId;
+		};
+
+		Scenario scenario;
+		bool open;
+		bool quitQueued;
+		bool pumped;
+		long long openTime;
+		long long lastPump;
+		double spawnBudget;
+		double churnBudget;
+		unsigned int lastPacketId;
+		ObjectId nextObjectId;
+		unsigned int spawnedCount;
+		std::mt19937 random;
+
+		EventId eventObjectAdded;
+		EventId eventObjectRemoved;
+
+		std::vector<Model> models;
+		std::unordered_map<ObjectId, SimObject> objects;
+		std::deque<ObjectId> spawnOrder;
+		std::vector<Periodic> periodic;
+		std::deque<Pending> pending;
+		std::vector<char> dataBuffer;
+
+		void Reset();
+		void Pump();
+		SimObject& CreateObject(ObjectType type, bool isUser);
+		void RemoveObject(ObjectId objectId);
+		void Move(SimObject& object, long long now);
+		void QueueData(PacketType type, RequestId requestId, ModelId modelId, ObjectId objectId, unsigned int entryNumber, unsigned int outOf);
+		void QueueException(unsigned int exception, unsigned int sendId);
+		void WriteData(const Model& model, const SimObject* object);
+		SimObject* FindObject(ObjectId objectId);
+	};
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "SimConnect.h"
+
+namespace SimConnect
+{
+	enum class PacketType
+	{
+		NONE,
+		EXCEPTION,
+		OPEN,
+		QUIT,
+		EVENT,
+		EVENT_OBJECT_ADDREMOVE,
+		EVENT_EX1,
+		SIMOBJECT_DATA,
+		SIMOBJECT_DATA_BYTYPE,
+		UNKNOWN,
+	};
+
+	// Transport-neutral view of a single dispatched message.
+	// Pointers stay valid until the next GetNextDispatch call.
+	struct Packet
+	{
+		PacketType type;
+		unsigned int nativeId; // raw message id, for diagnostics
+
+		EventServer server; // OPEN
+		EventException exception; // EXCEPTION
+		unsigned int sendId; // EXCEPTION - id of the packet that caused it
+
+		EventId eventId; // EVENT, EVENT_OBJECT_ADDREMOVE, EVENT_EX1
+		ObjectType objectType; // EVENT_OBJECT_ADDREMOVE
+		unsigned int data[5]; // EVENT, EVENT_EX1; data[0] is object id for EVENT_OBJECT_ADDREMOVE
+
+		RequestId requestId; // SIMOBJECT_DATA, SIMOBJECT_DATA_BYTYPE
+		ObjectId objectId;
+		unsigned int entryNumber; // 1-based
+		unsigned int outOf;
+		void* objectData;
+	};
+
+	class Transport
+	{
+	public:
+		virtual ~Transport() = default;
+
+		virtual bool Open(const char* name) = 0;
+		virtual void Close() = 0;
+		virtual bool IsOpen() const = 0;
+		// Called from any thread when packets arrive; transports without a wait handle never call it
+		virtual void SetDataPendingCallback(std::function<void()> callback) {}
+
+		// Returns false when there is nothing to dispatch
+		virtual bool GetNextDispatch(Packet& packet) = 0;
+		virtual unsigned int GetLastSentPacketId() = 0;
+
+		virtual bool AddToDataDefinition(ModelId modelId, const DataModel::VarDef& var) = 0;
+		virtual void ClearDataDefinition(ModelId modelId) = 0;
+		virtual bool SubscribeToSystemEvent(EventId eventId, const char* name) = 0;
+		virtual bool RequestDataOnSimObject(RequestId requestId, ModelId modelId, ObjectId objectId, RequestPeriod period) = 0;
+		virtual bool RequestDataOnSimObjectType(RequestId requestId, ModelId modelId, unsigned int radius, ObjectType type) = 0;
+
+		virtual bool MapClientEventToSimEvent(EventId eventId, const char* name) = 0;
+		virtual bool AddClientEventToNotificationGroup(GroupId groupId, EventId eventId) = 0;
+		virtual bool TransmitClientEvent(ObjectId objectId, EventId eventId, unsigned int value) = 0;
+		virtual bool TransmitClientEventEx1(ObjectId objectId, EventId eventId, const unsigned int data[5]) = 0;
+	};
+
+	std::unique_ptr<Transport> CreateDefaultTransport();
+}
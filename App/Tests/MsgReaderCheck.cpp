@@ -0,0 +1,105 @@
+// MsgReader on hostile input: every truncation of a message covering all types, lengths and counts far
+// beyond the buffer, and nesting past MaxDepth. A read that fails must leave the cursor where it was.
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include "WebCast/MsgReader.hpp"
+
+static unsigned int failures = 0;
+
+static void Check(bool ok, const char* what)
+{
+	if (!ok)
+	{
+		std::printf("FAIL %s\n", what);
+		++failures;
+	}
+}
+
+static std::string Bytes(std::initializer_list<int> bytes)
+{
+	std::string data;
+	for (auto b : bytes)
+		data.push_back((char)b);
+	return data;
+}
+
+int main()
+{
+	// { 0: 300, "1": "abc", 2: [1.5, nil, true, -2], 3: bin "xy", 4: fixext1 }
+	auto message = Bytes({
+		0x85,
+		0x00, 0xcd, 0x01, 0x2c,
+		0xa1, '1', 0xa3, 'a', 'b', 'c',
+		0x02, 0x94, 0xcb, 0x3f, 0xf8, 0, 0, 0, 0, 0, 0, 0xc0, 0xc3, 0xfe,
+		0x03, 0xc4, 0x02, 'x', 'y',
+		0x04, 0xd4, 0x01, 0x7f,
+	});
+
+	{
+		MsgReader reader(message.data(), message.size());
+		unsigned long long value = 0;
+		std::string_view text;
+		double number = 0;
+		bool fields = reader.ForEachField([&](int key, MsgReader& field)
+			{
+				uint32_t count;
+				bool flag;
+				long long last;
+				if (key == 0)
+					field.ReadUInt(value);
+				else if (key == 1)
+					field.ReadString(text);
+				else if (key == 2 && field.ReadArray(count) && count == 4)
+					field.ReadNumber(number) && field.ReadNil() && field.ReadBool(flag) && field.ReadInt(last);
+			});
+		Check(fields && reader.AtEnd(), "well-formed message read to the end");
+		Check(value == 300 && text == "abc" && number == 1.5, "well-formed message values");
+	}
+
+	for (size_t size = 0; size < message.size(); size++)
+	{
+		MsgReader reader(message.data(), size);
+		Check(!reader.Skip() && reader.Remaining() == size, "truncated message not skipped");
+
+		MsgReader fields(message.data(), size);
+		Check(!fields.ForEachField([](int, MsgReader&) {}), "truncated message not read");
+	}
+
+	// lengths and counts that claim more than the buffer holds
+	const std::string oversized[] = {
+		Bytes({ 0xdb, 0xff, 0xff, 0xff, 0xff, 'a' }), // str32
+		Bytes({ 0xda, 0xff, 0xff }), // str16
+		Bytes({ 0xc6, 0xff, 0xff, 0xff, 0xff, 'a' }), // bin32
+		Bytes({ 0xc9, 0xff, 0xff, 0xff, 0xff, 0x01, 'a' }), // ext32
+		Bytes({ 0xdd, 0xff, 0xff, 0xff, 0xff, 0xc0 }), // array32
+		Bytes({ 0xdf, 0xff, 0xff, 0xff, 0xff, 0x00, 0xc0 }), // map32
+	};
+	for (auto& data : oversized)
+	{
+		MsgReader reader(data.data(), data.size());
+		std::string_view view;
+		Check(!reader.ReadString(view) && !reader.ReadBinary(view) && reader.Remaining() == data.size(), "oversized string or binary read");
+		Check(!reader.Skip() && reader.Remaining() == data.size(), "oversized value skipped");
+
+		MsgReader fields(data.data(), data.size());
+		Check(!fields.ForEachField([](int, MsgReader&) {}), "oversized map read");
+	}
+
+	// nesting: MaxDepth levels below the top one are skipped, one more is rejected without recursing further
+	auto nested = [](size_t depth)
+		{
+			return std::string(depth, (char)0x91) + (char)0xc0;
+		};
+	for (size_t depth : { 32, 33, 100000 })
+	{
+		auto data = nested(depth);
+		MsgReader reader(data.data(), data.size());
+		bool skipped = reader.Skip();
+		Check(depth <= 32 ? skipped && reader.AtEnd() : !skipped && reader.Remaining() == data.size(), "nesting depth limit");
+	}
+
+	if (failures)
+		std::printf("%u failed checks\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,98 @@
+// SpatialGrid queries against a brute-force scan of the same points, with boxes and radii that cross the
+// antimeridian and reach the poles, and with non-finite or far out of range coordinates, which must be
+// ignored rather than cast to a cell.
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+#include "TrafficRadar/SpatialGrid.h"
+
+struct Point
+{
+	double latitude;
+	double longitude;
+};
+
+static unsigned int failures = 0;
+
+static void Expect(const char* what, std::vector<unsigned int> actual, std::vector<unsigned int> expected)
+{
+	std::sort(actual.begin(), actual.end());
+	std::sort(expected.begin(), expected.end());
+	if (actual != expected)
+	{
+		std::printf("FAIL %s: %zu results, expected %zu\n", what, actual.size(), expected.size());
+		++failures;
+	}
+}
+
+int main()
+{
+	std::mt19937 random(7);
+	std::uniform_real_distribution<double> latitude(-90, 90), longitude(-180, 180);
+	std::vector<Point> points;
+	SpatialGrid grid;
+	for (unsigned int i = 0; i < 5000; i++)
+	{
+		auto& point = points.emplace_back(latitude(random), longitude(random));
+		grid.Update(i, i, point.longitude, point.latitude);
+	}
+
+	// non-finite positions take the entry out of the grid, huge finite ones land in a clamped cell
+	const double inf = std::numeric_limits<double>::infinity();
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	const Point invalid[] = { { nan, 0 }, { 0, nan }, { inf, 0 }, { 0, -inf }, { 1e300, 1e300 } };
+	for (auto point : invalid)
+	{
+		auto index = (unsigned int)points.size();
+		grid.Update(index, index, 0, 0);
+		grid.Update(index, index, point.longitude, point.latitude);
+		if (std::isfinite(point.latitude) && std::isfinite(point.longitude))
+			points.push_back(point);
+	}
+
+	const Point centers[] = { { 0, 0 }, { 52.2, 21.0 }, { 10, 179.5 }, { -20, -179.9 }, { 89.5, 0 }, { -89.9, 90 } };
+	for (auto center : centers)
+	{
+		for (double radius : { 10.0, 300.0, 3000.0 })
+		{
+			std::vector<unsigned int> actual, expected;
+			grid.QueryRadius(center.latitude, center.longitude, radius, actual);
+			for (unsigned int i = 0; i < points.size(); i++)
+			{
+				if (SpatialGrid::Distance(center.latitude, center.longitude, points[i].latitude, points[i].longitude) <= radius)
+					expected.push_back(i);
+			}
+			Expect("radius", actual, expected);
+		}
+	}
+
+	const double boxes[][4] = { { 40, 10, 60, 30 }, { -10, 170, 10, -170 }, { -90, -180, 90, 180 } };
+	for (auto& box : boxes)
+	{
+		std::vector<unsigned int> actual, expected;
+		grid.QueryBox(box[0], box[1], box[2], box[3], actual);
+		for (unsigned int i = 0; i < points.size(); i++)
+		{
+			auto& p = points[i];
+			bool inLongitude = box[1] > box[3] ? p.longitude >= box[1] || p.longitude <= box[3] : p.longitude >= box[1] && p.longitude <= box[3];
+			if (p.latitude >= box[0] && p.latitude <= box[2] && inLongitude)
+				expected.push_back(i);
+		}
+		Expect("box", actual, expected);
+	}
+
+	// non-finite bounds find nothing, huge ones must not overflow the column count
+	std::vector<unsigned int> result;
+	grid.QueryRadius(nan, 0, 100, result);
+	grid.QueryRadius(0, 0, nan, result);
+	grid.QueryBox(-inf, 0, 10, 10, result);
+	Expect("non-finite", result, {});
+	grid.QueryBox(-1e300, -1e300, 1e300, 1e300, result);
+
+	if (failures)
+		std::printf("%u failed queries\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,84 @@
+// TrackStore::Project kernels against each other: AVX2 and SSE2 followed by the scalar tail, as Project
+// runs them, must match ProjectScalar for every count, including those that are not a multiple of the
+// vector width, and keep longitude in [-180, 180) across the antimeridian.
+// Built from the kernels' own source to reach the file-local functions.
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "TrafficRadar/TrackStore.cpp"
+
+struct Fleet
+{
+	std::vector<double> longitude, latitude, velocityLongitude, velocityLatitude, sampleTime;
+
+	explicit Fleet(size_t count, std::mt19937& random)
+	{
+		std::uniform_real_distribution<double> lon(-180, 180), lat(-80, 80), speed(-0.0002, 0.0002), age(-1000, 20000);
+		for (size_t i = 0; i < count; i++)
+		{
+			// every other track sits next to the antimeridian so the projection crosses it
+			longitude.push_back(i % 2 ? lon(random) : (i % 4 ? 179.999 : -179.999));
+			latitude.push_back(lat(random));
+			velocityLongitude.push_back(speed(random));
+			velocityLatitude.push_back(speed(random));
+			sampleTime.push_back(100000 - age(random));
+		}
+	}
+
+	ProjectArgs Args(std::vector<double>& outLongitude, std::vector<double>& outLatitude) const
+	{
+		outLongitude.assign(longitude.size(), NAN);
+		outLatitude.assign(longitude.size(), NAN);
+		return { longitude.data(), latitude.data(), velocityLongitude.data(), velocityLatitude.data(), sampleTime.data(),
+			outLongitude.data(), outLatitude.data(), 100000, 10000 };
+	}
+};
+
+static unsigned int failures = 0;
+
+static void Compare(const char* kernel, size_t count, const std::vector<double>& expected, const std::vector<double>& actual, bool isLongitude)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		// FMA rounds once, the other kernels twice
+		if (!(std::abs(expected[i] - actual[i]) <= 1e-9) || (isLongitude && (actual[i] < -180 || actual[i] >= 180)))
+		{
+			std::printf("FAIL %s count %zu index %zu %s: %.12f, scalar %.12f\n", kernel, count, i, isLongitude ? "longitude" : "latitude", actual[i], expected[i]);
+			++failures;
+		}
+	}
+}
+
+int main()
+{
+	std::mt19937 random(7);
+	for (size_t count = 0; count <= 37; count++)
+	{
+		Fleet fleet(count, random);
+		std::vector<double> expectedLongitude, expectedLatitude, outLongitude, outLatitude;
+		ProjectScalar(fleet.Args(expectedLongitude, expectedLatitude), 0, count);
+		Compare("scalar", count, expectedLongitude, expectedLongitude, true);
+
+#ifdef TRACKSTORE_X64
+		auto args = fleet.Args(outLongitude, outLatitude);
+		ProjectScalar(args, ProjectSSE2(args, count), count);
+		Compare("SSE2", count, expectedLongitude, outLongitude, true);
+		Compare("SSE2", count, expectedLatitude, outLatitude, false);
+
+		if (hasAVX2)
+		{
+			args = fleet.Args(outLongitude, outLatitude);
+			ProjectScalar(args, ProjectAVX2(args, count), count);
+			Compare("AVX2", count, expectedLongitude, outLongitude, true);
+			Compare("AVX2", count, expectedLatitude, outLatitude, false);
+		}
+		else if (count == 0)
+			std::printf("AVX2 not supported on this CPU, skipped\n");
+#endif
+	}
+
+	if (failures)
+		std::printf("%u mismatches\n", failures);
+	return failures ? 1 : 0;
+}
@@ -1,6 +1,8 @@
+#include <algorithm>
 #include "AirplaneRadar.h"
 #include "SimCom/SimCom.h"
 #include "Utils/Logger.h"
+#include "Utils/Metrics.h"
 #include "Utils/Time.h"
 #include "LocalAircraft.h"
 
@@ -8,6 +10,11 @@ using namespace SimConnect;
 extern SimCom simcom;
 extern LocalAircraft aircraft;
 
+static auto& AircraftKnown = Metrics::AddGauge("radar_aircraft", "Aircraft reported by the simulator, spawned or still being identified");
+static auto& AircraftSpawned = Metrics::AddCounter("radar_aircraft_spawned_total", "Aircraft that got their first position and were announced");
+static auto& AircraftRemoved = Metrics::AddCounter("radar_aircraft_removed_total", "Announced aircraft that were removed");
+static auto& PositionUpdates = Metrics::AddCounter("radar_position_updates_total", "Position samples received for spawned aircraft");
+
 struct RadarIdent_Model : DataModel
 {
 	struct RadarIdent
@@ -76,6 +83,7 @@ static RadarInfo_Model infoModel;
 
 struct Airplane
 {
+	SlotHandle handle{};
 	ObjectId objId{};
 	double spawnTime{};
 	bool isUser = false;
@@ -86,10 +94,20 @@ struct Airplane
 	char model[8]{};
 
 	RequestId radarId{};
-	RadarInfo_Model::RadarInfo radarInfo{};
+	bool tracked = false;
 };
 
-AirplaneRadar::AirplaneRadar()
+struct AirplaneRadar::SweepEntry
+{
+	ObjectId objId;
+	RadarInfo_Model::RadarInfo info;
+};
+
+static constexpr unsigned int SweepRadius = 200000; // meters, SimConnect limit
+static constexpr long long SweepTimeout = Time::SecondToMs(10);
+
+AirplaneRadar::AirplaneRadar() : trackingMode(TrackingMode::PerObject), sweepInterval(1000), nextSweep(0), sweepDeadline(0), sweepPending(0), sweepSerial(0), identSerial(0),
+	predictInterval(0), nextPredict(0)
 {
 }
 
@@ -105,10 +123,15 @@ void AirplaneRadar::Initialize()
 
 	RemoveAll();
 	aircraft.Initialize();
+	nextSweep = 0;
+	sweepPending = 0;
+	sweepBatch.clear();
 
-	auto callback = [this](void* data, SimConnect::ObjectId objId)
+	// Own serial: sweeps bump sweepSerial from the first update, which must not drop these replies
+	auto serial = ++identSerial;
+	auto callback = [this, serial](void* data, SimConnect::ObjectId objId)
 		{
-			if (objId == 0)
+			if (objId == 0 || serial != identSerial)
 				return;
 
 			auto& object = Add(objId);
@@ -128,6 +151,9 @@ void AirplaneRadar::Initialize()
 					Add(event.objectId);
 					break;
 				}
+
+				default:
+					break;
 			}
 		});
 	client.SubscribeToObjectRemoved([this](SimConnect::EventObject event)
@@ -140,6 +166,9 @@ void AirplaneRadar::Initialize()
 					Remove(event.objectId);
 					break;
 				}
+
+				default:
+					break;
 			}
 		});
 }
@@ -150,15 +179,64 @@ void AirplaneRadar::Shutdown()
 	aircraft.Remove();
 }
 
-Airplane& AirplaneRadar::Add(unsigned int id)
+void AirplaneRadar::SetTrackingMode(TrackingMode mode, unsigned int intervalMs)
 {
+	sweepInterval = intervalMs > 0 ? intervalMs : 1000;
+	if (trackingMode == mode)
+		return;
+
+	for (auto& airplane : airplanes)
+		Untrack(airplane);
+
+	trackingMode = mode;
+	nextSweep = 0;
+	// replies of a sweep still in flight belong to the old mode
+	++sweepSerial;
+	sweepPending = 0;
+	sweepBatch.clear();
+	Logger::Log("Radar tracking mode: {}", mode == TrackingMode::Sweep ? "sweep" : "per object");
+
 	for (auto& airplane : airplanes)
 	{
-		if (airplane.objId == id)
-			return airplane;
+		if (airplane.tracked)
+			Track(airplane);
 	}
+}
 
-	auto& airplane = airplanes.emplace_back();
+void AirplaneRadar::SetPrediction(unsigned int rate, bool smoothing, double alpha, double beta)
+{
+	tracks.SetSmoothing(smoothing, alpha, beta);
+
+	if (rate == 0)
+		predictInterval = 0;
+	else
+		predictInterval = 1000 / std::clamp(rate, 5u, 20u);
+	nextPredict = 0;
+
+	if (predictInterval)
+		Logger::Log("Radar prediction: {} Hz, smoothing {}", 1000 / predictInterval, smoothing ? "on" : "off");
+	else
+		Logger::Log("Radar prediction: off, smoothing {}", smoothing ? "on" : "off");
+}
+
+Airplane* AirplaneRadar::Find(unsigned int id)
+{
+	auto i = airplaneIndex.find(id);
+	if (i == airplaneIndex.end())
+		return nullptr;
+	return airplanes.Get(i->second);
+}
+
+Airplane& AirplaneRadar::Add(unsigned int id)
+{
+	if (auto airplane = Find(id))
+		return *airplane;
+
+	auto handle = airplanes.Insert({});
+	airplaneIndex[id] = handle;
+
+	auto& airplane = *airplanes.Get(handle);
+	airplane.handle = handle;
 	airplane.objId = id;
 	airplane.spawnTime = Time::SteadyNow() + Time::SecondToMs(5);
 	airplane.isUser = false;
@@ -167,15 +245,20 @@ Airplane& AirplaneRadar::Add(unsigned int id)
 
 void AirplaneRadar::Remove(unsigned int id)
 {
-	for (auto i = airplanes.begin(); i != airplanes.end(); ++i)
+	auto i = airplaneIndex.find(id);
+	if (i == airplaneIndex.end())
+		return;
+
+	auto handle = i->second;
+	airplaneIndex.erase(i);
+
+	if (auto airplane = airplanes.Get(handle))
 	{
-		auto& airplane = *i;
-		if (airplane.objId == id)
-		{
-			OnRemove(airplane);
-			airplanes.erase(i);
-			return;
-		}
+		OnRemove(*airplane);
+		Untrack(*airplane);
+		tracks.Clear(handle.index);
+		grid.Remove(handle.index);
+		airplanes.Remove(handle);
 	}
 }
 
@@ -185,7 +268,10 @@ void AirplaneRadar::RemoveAll()
 	{
 		OnRemove(airplane);
 	}
-	airplanes.clear();
+	airplanes.Clear();
+	airplaneIndex.clear();
+	tracks.Reset();
+	grid.Clear();
 }
 
 void AirplaneRadar::OnRemove(Airplane& airplane)
@@ -194,17 +280,22 @@ void AirplaneRadar::OnRemove(Airplane& airplane)
 	{
 		aircraft.Remove();
 	}
-	else if (airplane.spawned && OnPlaneRemove)
+	else if (airplane.spawned)
 	{
-		PlaneRemoveArgs e;
-		e.id = airplane.objId;
-		OnPlaneRemove(e);
+		AircraftRemoved.Add();
+		if (OnPlaneRemove)
+		{
+			PlaneRemoveArgs e;
+			e.id = airplane.objId;
+			OnPlaneRemove(e);
+		}
 	}
 }
 
 static void StrCpy_Safe(const char* src, size_t srcSize, char* dest, size_t destSize)
 {
-	auto size = strnlen_s(src, srcSize);
+	auto end = static_cast<const char*>(memchr(src, 0, srcSize));
+	size_t size = end ? end - src : srcSize;
 	if (size >= destSize)
 		size = destSize - 1;
 	memcpy(dest, src, size);
@@ -215,16 +306,12 @@ void AirplaneRadar::Ident(Airplane& airplane)
 {
 	auto& client = simcom.GetSimConnect();
 	
-	airplane.identId = client.RequestDataOnSimObject(airplane.objId, identModel, [this](void* data, unsigned int objId)
+	airplane.identId = client.RequestDataOnSimObject(airplane.objId, identModel, [this, handle = airplane.handle](void* data, unsigned int objId)
 		{
-			for (auto& airplane : airplanes)
+			if (auto airplane = airplanes.Get(handle))
 			{
-				if (airplane.objId == objId)
-				{
-					airplane.identId = 0;
-					OnIdent(data, airplane);
-					return;
-				}
+				airplane->identId = 0;
+				OnIdent(data, *airplane);
 			}
 		});
 }
@@ -249,70 +336,137 @@ void AirplaneRadar::OnIdent(void* data, Airplane& airplane)
 
 void AirplaneRadar::Track(Airplane& airplane)
 {
+	airplane.tracked = true;
+	if (trackingMode == TrackingMode::Sweep)
+		return;
+
 	auto& client = simcom.GetSimConnect();
 
-	airplane.radarId = client.RequestDataOnSimObject(airplane.objId, infoModel, [this](void* data, SimConnect::ObjectId objId)
+	airplane.radarId = client.RequestDataOnSimObject(airplane.objId, infoModel, [this, handle = airplane.handle](void* data, SimConnect::ObjectId objId)
 		{
-			auto& info = *reinterpret_cast<RadarInfo_Model::RadarInfo*>(data);
-
-			for (auto& airplane : airplanes)
-			{
-				if (airplane.objId == objId)
-				{
-					if (info.longitude < 1 && info.longitude > -1 &&
-						info.latitude < 1 && info.latitude > -1 &&
-						info.altitude < 1000)
-						return;
-
-					airplane.radarInfo = info;
-
-					if (!airplane.spawned)
-					{
-						airplane.spawned = true;
-						Logger::Log("Spawned aircraft {}", airplane.objId);
-
-						if (OnPlaneAdd)
-						{
-							PlaneAddArgs e;
-							e.id = airplane.objId;
-							e.model = airplane.model;
-							e.callsign = airplane.callsign;
-
-							e.longitude = info.longitude;
-							e.latitude = info.latitude;
-							e.heading = info.heading;
-
-							e.altitude = info.altitude;
-							e.groundAltitude = info.groundAltitude;
-							e.groundSpeed = info.groundSpeed;
-							OnPlaneAdd(e);
-						}
-						return;
-					}
-
-					if (OnPlaneUpdate)
-					{
-						PlaneUpdateArgs e;
-						e.id = objId;
-						e.longitude = info.longitude;
-						e.latitude = info.latitude;
-						e.heading = info.heading;
-
-						e.altitude = info.altitude;
-						e.groundAltitude = info.groundAltitude;
-
-						e.groundSpeed = info.groundSpeed;
-						OnPlaneUpdate(e);
-					}
-					return;
-				}
-			}
+			if (auto airplane = airplanes.Get(handle))
+				OnTrack(data, *airplane);
 		}, RequestPeriod::SECOND);
 }
 
+void AirplaneRadar::Untrack(Airplane& airplane)
+{
+	if (airplane.radarId == 0)
+		return;
+
+	simcom.GetSimConnect().CancelDataOnSimObject(airplane.radarId);
+	airplane.radarId = 0;
+}
+
+void AirplaneRadar::OnTrack(const void* data, Airplane& airplane)
+{
+	auto& info = *reinterpret_cast<const RadarInfo_Model::RadarInfo*>(data);
+
+	if (info.longitude < 1 && info.longitude > -1 &&
+		info.latitude < 1 && info.latitude > -1 &&
+		info.altitude < 1000)
+		return;
+
+	TrackStore::Sample sample
+	{
+		info.longitude,
+		info.latitude,
+		info.heading,
+		info.altitude,
+		info.groundAltitude,
+		info.groundSpeed,
+	};
+	tracks.Set(airplane.handle.index, sample, Time::SteadyNow());
+	grid.Update(airplane.handle.index, airplane.objId, info.longitude, info.latitude);
+
+	if (!airplane.spawned)
+	{
+		airplane.spawned = true;
+		AircraftSpawned.Add();
+		Logger::Log("Spawned aircraft {}", airplane.objId);
+
+		if (OnPlaneAdd)
+		{
+			PlaneAddArgs e;
+			e.id = airplane.objId;
+			e.model = airplane.model;
+			e.callsign = airplane.callsign;
+
+			e.longitude = info.longitude;
+			e.latitude = info.latitude;
+			e.heading = info.heading;
+
+			e.altitude = info.altitude;
+			e.groundAltitude = info.groundAltitude;
+			e.groundSpeed = info.groundSpeed;
+			OnPlaneAdd(e);
+		}
+		return;
+	}
+
+	PositionUpdates.Add();
+	if (OnPlaneUpdate)
+	{
+		PlaneUpdateArgs e;
+		e.id = airplane.objId;
+		e.longitude = info.longitude;
+		e.latitude = info.latitude;
+		e.heading = info.heading;
+
+		e.altitude = info.altitude;
+		e.groundAltitude = info.groundAltitude;
+
+		e.groundSpeed = info.groundSpeed;
+		OnPlaneUpdate(e);
+	}
+}
+
+void AirplaneRadar::StartSweep(long long now)
+{
+	auto& client = simcom.GetSimConnect();
+
+	auto serial = ++sweepSerial;
+	auto callback = [this, serial](void* data, SimConnect::ObjectId objId)
+		{
+			if (objId == 0 || serial != sweepSerial)
+				return;
+
+			auto& entry = sweepBatch.emplace_back();
+			entry.objId = objId;
+			entry.info = *reinterpret_cast<RadarInfo_Model::RadarInfo*>(data);
+		};
+	auto complete = [this, serial]()
+		{
+			if (serial == sweepSerial && sweepPending > 0 && --sweepPending == 0)
+				OnSweepComplete();
+		};
+
+	sweepBatch.clear();
+	sweepPending = 0;
+	sweepDeadline = now + SweepTimeout;
+	nextSweep = now + sweepInterval;
+
+	if (client.RequestDataOnSimObjectType(SimConnect::ObjectType::AIRCRAFT, infoModel, callback, SweepRadius, complete))
+		++sweepPending;
+	if (client.RequestDataOnSimObjectType(SimConnect::ObjectType::HELICOPTER, infoModel, callback, SweepRadius, complete))
+		++sweepPending;
+}
+
+void AirplaneRadar::OnSweepComplete()
+{
+	for (auto& entry : sweepBatch)
+	{
+		auto airplane = Find(entry.objId);
+		if (airplane && airplane->tracked)
+			OnTrack(&entry.info, *airplane);
+	}
+	sweepBatch.clear();
+}
+
 void AirplaneRadar::OnUpdate()
 {
 	auto now = Time::SteadyNow();
+	AircraftKnown.Set((int64_t)airplanes.Size());
 
 	for (auto& airplane : airplanes)
 	{
@@ -322,30 +476,107 @@ void AirplaneRadar::OnUpdate()
 			Ident(airplane);
 		}
 	}
+
+	if (trackingMode == TrackingMode::Sweep && simcom.IsConnected())
+	{
+		auto time = Time::SteadyNowInt();
+		if (sweepPending > 0 && time >= sweepDeadline)
+		{
+			Logger::LogWarn("Radar sweep timed out");
+			sweepPending = 0;
+		}
+
+		if (sweepPending == 0 && time >= nextSweep)
+			StartSweep(time);
+	}
+
+	if (predictInterval && OnPlanePredict)
+	{
+		auto time = Time::SteadyNowInt();
+		if (time >= nextPredict)
+		{
+			nextPredict = time + predictInterval;
+			Predict();
+		}
+	}
 }
 
-std::vector<AirplaneRadar::PlaneAddArgs> AirplaneRadar::CreateSnapshot()
+void AirplaneRadar::Predict()
 {
-	std::vector<PlaneAddArgs> list;
-	list.reserve(airplanes.size());
+	auto capacity = tracks.GetCapacity();
+	if (projectedLongitude.size() < capacity)
+	{
+		projectedLongitude.resize(capacity);
+		projectedLatitude.resize(capacity);
+	}
+	tracks.Project(Time::SteadyNow(), projectedLongitude.data(), projectedLatitude.data());
+
+	predictions.clear();
 	for (auto& airplane : airplanes)
 	{
-		if (!airplane.spawned)
+		auto index = airplane.handle.index;
+		if (!airplane.spawned || !tracks.IsActive(index))
 			continue;
 
-		auto& e = list.emplace_back();
+		auto sample = tracks.Get(index);
+		auto& e = predictions.emplace_back();
 		e.id = airplane.objId;
-		e.model = airplane.model;
-		e.callsign = airplane.callsign;
+		e.longitude = projectedLongitude[index];
+		e.latitude = projectedLatitude[index];
+		e.heading = sample.heading;
+		e.altitude = sample.altitude;
+	}
 
-		auto& info = airplane.radarInfo;
-		e.longitude = info.longitude;
-		e.latitude = info.latitude;
-		e.heading = info.heading;
+	if (predictions.empty())
+		return;
 
-		e.altitude = info.altitude;
-		e.groundAltitude = info.groundAltitude;
-		e.groundSpeed = info.groundSpeed;
+	PlanePredictArgs e;
+	e.timestamp = Time::UnixNowInt();
+	e.planes = predictions.data();
+	e.count = predictions.size();
+	OnPlanePredict(e);
+}
+
+static void SetPlaneArgs(AirplaneRadar::PlaneAddArgs& e, const Airplane& airplane, const TrackStore::Sample& info)
+{
+	e.id = airplane.objId;
+	e.model = airplane.model;
+	e.callsign = airplane.callsign;
+
+	e.longitude = info.longitude;
+	e.latitude = info.latitude;
+	e.heading = info.heading;
+
+	e.altitude = info.altitude;
+	e.groundAltitude = info.groundAltitude;
+	e.groundSpeed = info.groundSpeed;
+}
+
+std::vector<AirplaneRadar::PlaneAddArgs> AirplaneRadar::CreateSnapshot()
+{
+	std::vector<PlaneAddArgs> list;
+	list.reserve(airplanes.Size());
+	for (auto& airplane : airplanes)
+	{
+		if (!airplane.spawned)
+			continue;
+
+		SetPlaneArgs(list.emplace_back(), airplane, tracks.Get(airplane.handle.index));
 	}
 	return list;
 }
+
+bool AirplaneRadar::GetPlane(unsigned int id, PlaneAddArgs& e)
+{
+	auto airplane = Find(id);
+	if (!airplane || !airplane->spawned)
+		return false;
+
+	SetPlaneArgs(e, *airplane, tracks.Get(airplane->handle.index));
+	return true;
+}
+
+void AirplaneRadar::FindInBox(double minLatitude, double minLongitude, double maxLatitude, double maxLongitude, std::vector<unsigned int>& ids) const
+{
+	grid.QueryBox(minLatitude, minLongitude, maxLatitude, maxLongitude, ids);
+}
@@ -1,29 +1,78 @@
 #pragma once
 #include <vector>
 #include <string_view>
+#include <unordered_map>
 #include "Utils/Function.hpp"
 #include "Utils/FixedArray.h"
+#include "Utils/SlotMap.h"
+#include "TrackStore.h"
+#include "SpatialGrid.h"
 
 struct Airplane;
 
 class AirplaneRadar
 {
+public:
+	enum class TrackingMode
+	{
+		PerObject, // one RequestPeriod::SECOND request per airplane
+		Sweep, // periodic by-type requests covering all airplanes
+	};
+
+	struct PlanePrediction
+	{
+		unsigned int id;
+		double longitude;
+		double latitude;
+		double heading;
+		int altitude;
+	};
+
 private:
-	std::vector<Airplane> airplanes;
+	SlotMap<Airplane> airplanes;
+	std::unordered_map<unsigned int, SlotHandle> airplaneIndex; // ObjectId -> handle
+	TrackStore tracks; // indexed by SlotHandle::index
+	SpatialGrid grid; // spawned airplanes by last sample, indexed by SlotHandle::index
+
+	struct SweepEntry;
+	TrackingMode trackingMode;
+	long long sweepInterval;
+	long long nextSweep;
+	long long sweepDeadline;
+	unsigned int sweepPending;
+	unsigned int sweepSerial; // position sweeps only
+	unsigned int identSerial; // initial identification, see Initialize
+	std::vector<SweepEntry> sweepBatch;
 
+	long long predictInterval; // 0 - off
+	long long nextPredict;
+	std::vector<double> projectedLongitude;
+	std::vector<double> projectedLatitude;
+	std::vector<PlanePrediction> predictions;
+
+	Airplane* Find(unsigned int id);
 	void Ident(Airplane& airplane);
 	void Track(Airplane& airplane);
+	void Untrack(Airplane& airplane);
 
 	void OnIdent(void* data, Airplane& airplane);
+	void OnTrack(const void* data, Airplane& airplane);
 	void RemoveAll();
 	void OnRemove(Airplane& airplane);
 
+	void StartSweep(long long now);
+	void OnSweepComplete();
+	void Predict();
+
 public:
 	AirplaneRadar();
 	~AirplaneRadar();
 
 	void Initialize();
 	void Shutdown();
+	void SetTrackingMode(TrackingMode mode, unsigned int intervalMs = 1000);
+	auto GetTrackingMode() const { return trackingMode; }
+	void SetPrediction(unsigned int rate, bool smoothing, double alpha = 0.5, double beta = 0.1);
 	
 	void OnUpdate();
 	Airplane& Add(unsigned int id);
@@ -51,9 +100,22 @@ public:
 		std::string_view callsign;
 	};
 
+	struct PlanePredictArgs
+	{
+		long long timestamp; // unix ms the positions are predicted for
+		const PlanePrediction* planes;
+		size_t count;
+	};
+
 	Function<void(const PlaneAddArgs& e)> OnPlaneAdd;
 	Function<void(const PlaneRemoveArgs& e)> OnPlaneRemove;
 	Function<void(const PlaneUpdateArgs& e)> OnPlaneUpdate;
+	Function<void(const PlanePredictArgs& e)> OnPlanePredict;
 
 	std::vector<PlaneAddArgs> CreateSnapshot();
+	bool GetPlane(unsigned int id, PlaneAddArgs& e);
+	const TrackStore& GetTracks() const { return tracks; }
+
+	// Object ids of spawned airplanes, appended to 'ids'. Positions are the last received samples.
+	void FindInBox(double minLatitude, double minLongitude, double maxLatitude, double maxLongitude, std::vector<unsigned int>& ids) const;
 };
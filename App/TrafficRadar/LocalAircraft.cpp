@@ -87,15 +87,6 @@ void LocalAircraft::Initialize()
 		Remove();
 }
 
-static void StringCopy(const char* src, size_t srcSize, char* dest, size_t destSize)
-{
-	auto size = strnlen_s(src, srcSize);
-	if (size >= destSize)
-		size = destSize - 1;
-	memcpy(dest, src, size);
-	dest[size] = 0;
-}
-
 void LocalAircraft::Set(unsigned int objId)
 {
 	if (objectId == objId)
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include "SpatialGrid.h"
+
+static constexpr double DegToRad = std::numbers::pi / 180.0;
+static constexpr double EarthRadius = 3440.065; // nm
+
+SpatialGrid::SpatialGrid(double cellSize) : cellSize(cellSize)
+{
+	rows = (int)std::ceil(180.0 / cellSize);
+	columns = (int)std::ceil(360.0 / cellSize);
+}
+
+// Both take finite input only; range is enforced in double, before the cast
+int SpatialGrid::GetRow(double latitude) const
+{
+	return (int)std::clamp(std::floor((latitude + 90.0) / cellSize), 0.0, rows - 1.0);
+}
+
+int SpatialGrid::GetColumn(double longitude) const
+{
+	auto column = std::floor(std::fmod(longitude + 180.0, 360.0) / cellSize);
+	if (column < 0)
+		column += columns;
+	return (int)std::clamp(column, 0.0, columns - 1.0);
+}
+
+void SpatialGrid::Update(unsigned int index, unsigned int value, double longitude, double latitude)
+{
+	if (!std::isfinite(longitude) || !std::isfinite(latitude))
+	{
+		// no cell to file it under, out of the grid until a valid position comes
+		Remove(index);
+		return;
+	}
+
+	if (index >= entries.size())
+		entries.resize(std::max<size_t>(index + 1, entries.size() * 2), Entry{ -1 });
+
+	auto cell = (long long)GetRow(latitude) * columns + GetColumn(longitude);
+	auto& entry = entries[index];
+	entry.value = value;
+	entry.longitude = longitude;
+	entry.latitude = latitude;
+
+	if (entry.cell == cell)
+		return;
+
+	Unlink(index);
+
+	auto& members = cells[cell];
+	entry.cell = cell;
+	entry.position = (unsigned int)members.size();
+	members.push_back(index);
+}
+
+void SpatialGrid::Unlink(unsigned int index)
+{
+	auto& entry = entries[index];
+	if (entry.cell < 0)
+		return;
+
+	auto i = cells.find(entry.cell);
+	auto& members = i->second;
+	auto last = members.back();
+	members[entry.position] = last;
+	entries[last].position = entry.position;
+	members.pop_back();
+
+	if (members.empty())
+		cells.erase(i);
+	entry.cell = -1;
+}
+
+void SpatialGrid::Remove(unsigned int index)
+{
+	if (index < entries.size())
+		Unlink(index);
+}
+
+void SpatialGrid::Clear()
+{
+	entries.clear();
+	cells.clear();
+}
+
+template <typename F>
+void SpatialGrid::VisitBox(double minLatitude, double minLongitude, double maxLatitude, double maxLongitude, F&& visit) const
+{
+	if (!std::isfinite(minLatitude) || !std::isfinite(minLongitude) || !std::isfinite(maxLatitude) || !std::isfinite(maxLongitude))
+		return;
+
+	bool wraps = minLongitude > maxLongitude;
+	auto contains = [=](const Entry& entry)
+		{
+			if (entry.latitude < minLatitude || entry.latitude > maxLatitude)
+				return false;
+			if (wraps)
+				return entry.longitude >= minLongitude || entry.longitude <= maxLongitude;
+			return entry.longitude >= minLongitude && entry.longitude <= maxLongitude;
+		};
+	auto visitCell = [&](const std::vector<unsigned int>& members)
+		{
+			for (auto index : members)
+			{
+				auto& entry = entries[index];
+				if (contains(entry))
+					visit(entry);
+			}
+		};
+
+	auto row0 = GetRow(minLatitude);
+	auto row1 = GetRow(maxLatitude);
+	auto column0 = GetColumn(minLongitude);
+	auto span = wraps ? maxLongitude - minLongitude + 360.0 : maxLongitude - minLongitude;
+	auto start = std::floor((minLongitude + 180.0) / cellSize);
+	auto columnCount = (int)std::min(std::floor((minLongitude + 180.0 + span) / cellSize) - start + 1, (double)columns);
+
+	// large areas - cheaper to walk the occupied cells than every cell of the box
+	if ((long long)(row1 - row0 + 1) * columnCount >= (long long)cells.size())
+	{
+		for (auto& [cell, members] : cells)
+			visitCell(members);
+		return;
+	}
+
+	for (auto row = row0; row <= row1; ++row)
+	{
+		for (int c = 0; c < columnCount; ++c)
+		{
+			auto column = (column0 + c) % columns;
+			auto i = cells.find((long long)row * columns + column);
+			if (i != cells.end())
+				visitCell(i->second);
+		}
+	}
+}
+
+void SpatialGrid::QueryBox(double minLatitude, double minLongitude, double maxLatitude, double maxLongitude, std::vector<unsigned int>& result) const
+{
+	VisitBox(minLatitude, minLongitude, maxLatitude, maxLongitude, [&](const Entry& entry)
+		{
+			result.push_back(entry.value);
+		});
+}
+
+void SpatialGrid::QueryRadius(double latitude, double longitude, double radius, std::vector<unsigned int>& result) const
+{
+	// bounding box of the spherical cap
+	auto angle = radius / EarthRadius;
+	auto deltaLatitude = angle / DegToRad;
+	auto minLatitude = latitude - deltaLatitude;
+	auto maxLatitude = latitude + deltaLatitude;
+	auto minLongitude = -180.0;
+	auto maxLongitude = 180.0;
+
+	auto scale = std::cos(latitude * DegToRad);
+	if (minLatitude > -90.0 && maxLatitude < 90.0 && std::sin(angle) < scale)
+	{
+		auto deltaLongitude = std::asin(std::sin(angle) / scale) / DegToRad;
+		minLongitude = std::remainder(longitude - deltaLongitude, 360.0);
+		maxLongitude = std::remainder(longitude + deltaLongitude, 360.0);
+	}
+
+	VisitBox(minLatitude, minLongitude, maxLatitude, maxLongitude, [&](const Entry& entry)
+		{
+			if (Distance(latitude, longitude, entry.latitude, entry.longitude) <= radius)
+				result.push_back(entry.value);
+		});
+}
+
+double SpatialGrid::Distance(double latitude1, double longitude1, double latitude2, double longitude2)
+{
+	auto dLatitude = (latitude2 - latitude1) * DegToRad;
+	auto dLongitude = (longitude2 - longitude1) * DegToRad;
+	auto a = std::sin(dLatitude / 2) * std::sin(dLatitude / 2) +
+		std::cos(latitude1 * DegToRad) * std::cos(latitude2 * DegToRad) * std::sin(dLongitude / 2) * std::sin(dLongitude / 2);
+	return 2 * EarthRadius * std::asin(std::sqrt(std::min(a, 1.0)));
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+
+// Uniform lat/lon grid over tracked objects. Entries are keyed by a caller-chosen dense index
+// (airplane slot) and carry a value (object id) returned by queries.
+// Update/Remove are O(1); queries visit only the cells overlapping the searched area.
+class SpatialGrid
+{
+private:
+	struct Entry
+	{
+		long long cell; // -1 - not in grid
+		unsigned int position; // index inside the cell
+		unsigned int value;
+		double longitude;
+		double latitude;
+	};
+
+	double cellSize; // degrees
+	int rows;
+	int columns;
+	std::vector<Entry> entries;
+	std::unordered_map<long long, std::vector<unsigned int>> cells; // cell -> entry indices
+
+	int GetRow(double latitude) const;
+	int GetColumn(double longitude) const;
+	void Unlink(unsigned int index);
+	template <typename F>
+	void VisitBox(double minLatitude, double minLongitude, double maxLatitude, double maxLongitude, F&& visit) const;
+
+public:
+	explicit SpatialGrid(double cellSize = 0.5);
+
+	void Update(unsigned int index, unsigned int value, double longitude, double latitude);
+	void Remove(unsigned int index);
+	void Clear();
+	size_t GetCellCount() const { return cells.size(); }
+
+	// Box may cross the antimeridian (minLongitude > maxLongitude). Appends values to 'result'.
+	void QueryBox(double minLatitude, double minLongitude, double maxLatitude, double maxLongitude, std::vector<unsigned int>& result) const;
+	// Great-circle radius in nautical miles. Appends values to 'result'.
+	void QueryRadius(double latitude, double longitude, double radius, std::vector<unsigned int>& result) const;
+
+	static double Distance(double latitude1, double longitude1, double latitude2, double longitude2); // nm
+};
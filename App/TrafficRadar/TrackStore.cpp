@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include "TrackStore.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define TRACKSTORE_X64 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+static constexpr double KnotToDegreePerMs = 1.0 / (60.0 * 3600000.0); // 1 nm = 1/60 deg of latitude
+static constexpr double DegToRad = std::numbers::pi / 180.0;
+static constexpr double FilterResetAfter = 15000; // ms without samples
+static constexpr double FilterResetDistance = 0.5; // degrees of residual, teleport or antimeridian
+
+TrackStore::TrackStore() : smoothing(false), alpha(0.5), beta(0.1)
+{
+}
+
+void TrackStore::SetSmoothing(bool enabled, double alpha, double beta)
+{
+	smoothing = enabled;
+	this->alpha = std::clamp(alpha, 0.01, 1.0);
+	this->beta = std::clamp(beta, 0.0, 1.0);
+}
+
+void TrackStore::Set(unsigned int index, const Sample& sample, double time)
+{
+	if (index >= active.size())
+	{
+		auto size = std::max<size_t>(index + 1, active.size() * 2);
+		longitude.resize(size);
+		latitude.resize(size);
+		heading.resize(size);
+		altitude.resize(size);
+		groundAltitude.resize(size);
+		groundSpeed.resize(size);
+		stateLongitude.resize(size);
+		stateLatitude.resize(size);
+		velocityLongitude.resize(size);
+		velocityLatitude.resize(size);
+		sampleTime.resize(size);
+		active.resize(size);
+	}
+
+	longitude[index] = sample.longitude;
+	latitude[index] = sample.latitude;
+	heading[index] = sample.heading;
+	altitude[index] = sample.altitude;
+	groundAltitude[index] = sample.groundAltitude;
+	groundSpeed[index] = sample.groundSpeed;
+
+	if (smoothing && active[index])
+	{
+		auto dt = time - sampleTime[index];
+		if (dt > 0 && dt < FilterResetAfter)
+		{
+			auto predictedLongitude = stateLongitude[index] + velocityLongitude[index] * dt;
+			auto predictedLatitude = stateLatitude[index] + velocityLatitude[index] * dt;
+			auto residualLongitude = sample.longitude - predictedLongitude;
+			auto residualLatitude = sample.latitude - predictedLatitude;
+
+			if (std::abs(residualLongitude) < FilterResetDistance && std::abs(residualLatitude) < FilterResetDistance)
+			{
+				stateLongitude[index] = predictedLongitude + alpha * residualLongitude;
+				stateLatitude[index] = predictedLatitude + alpha * residualLatitude;
+				velocityLongitude[index] += beta * residualLongitude / dt;
+				velocityLatitude[index] += beta * residualLatitude / dt;
+				sampleTime[index] = time;
+				return;
+			}
+		}
+	}
+
+	// first sample or filter off - start from the sample with velocity from heading and ground speed
+	auto speed = sample.groundSpeed * KnotToDegreePerMs;
+	auto radians = sample.heading * DegToRad;
+	auto scale = std::cos(sample.latitude * DegToRad);
+
+	stateLongitude[index] = sample.longitude;
+	stateLatitude[index] = sample.latitude;
+	velocityLatitude[index] = speed * std::cos(radians);
+	velocityLongitude[index] = scale > 0.01 ? speed * std::sin(radians) / scale : 0;
+	sampleTime[index] = time;
+	active[index] = 1;
+}
+
+void TrackStore::Clear(unsigned int index)
+{
+	if (index >= active.size())
+		return;
+
+	active[index] = 0;
+	velocityLongitude[index] = 0;
+	velocityLatitude[index] = 0;
+}
+
+void TrackStore::Reset()
+{
+	longitude.clear();
+	latitude.clear();
+	heading.clear();
+	altitude.clear();
+	groundAltitude.clear();
+	groundSpeed.clear();
+	stateLongitude.clear();
+	stateLatitude.clear();
+	velocityLongitude.clear();
+	velocityLatitude.clear();
+	sampleTime.clear();
+	active.clear();
+}
+
+TrackStore::Sample TrackStore::Get(unsigned int index) const
+{
+	return
+	{
+		longitude[index],
+		latitude[index],
+		heading[index],
+		altitude[index],
+		groundAltitude[index],
+		groundSpeed[index],
+	};
+}
+
+struct ProjectArgs
+{
+	const double* longitude;
+	const double* latitude;
+	const double* velocityLongitude;
+	const double* velocityLatitude;
+	const double* sampleTime;
+	double* outLongitude;
+	double* outLatitude;
+	double time;
+	double maxAhead;
+};
+
+// Samples are in [-180, 180] and maxAhead keeps the step far below a full turn, so crossing the
+// antimeridian needs at most one correction
+static void ProjectScalar(const ProjectArgs& args, size_t begin, size_t end)
+{
+	for (auto i = begin; i < end; ++i)
+	{
+		auto dt = std::clamp(args.time - args.sampleTime[i], 0.0, args.maxAhead);
+		auto lon = args.longitude[i] + args.velocityLongitude[i] * dt;
+		if (lon >= 180)
+			lon -= 360;
+		else if (lon < -180)
+			lon += 360;
+		args.outLongitude[i] = lon;
+		args.outLatitude[i] = args.latitude[i] + args.velocityLatitude[i] * dt;
+	}
+}
+
+#ifdef TRACKSTORE_X64
+static size_t ProjectSSE2(const ProjectArgs& args, size_t count)
+{
+	auto time = _mm_set1_pd(args.time);
+	auto zero = _mm_setzero_pd();
+	auto maxAhead = _mm_set1_pd(args.maxAhead);
+	auto east = _mm_set1_pd(180);
+	auto west = _mm_set1_pd(-180);
+	auto turn = _mm_set1_pd(360);
+
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2)
+	{
+		auto dt = _mm_sub_pd(time, _mm_loadu_pd(args.sampleTime + i));
+		dt = _mm_min_pd(_mm_max_pd(dt, zero), maxAhead);
+
+		auto lon = _mm_add_pd(_mm_loadu_pd(args.longitude + i), _mm_mul_pd(_mm_loadu_pd(args.velocityLongitude + i), dt));
+		lon = _mm_sub_pd(lon, _mm_and_pd(_mm_cmpge_pd(lon, east), turn));
+		lon = _mm_add_pd(lon, _mm_and_pd(_mm_cmplt_pd(lon, west), turn));
+		auto lat = _mm_add_pd(_mm_loadu_pd(args.latitude + i), _mm_mul_pd(_mm_loadu_pd(args.velocityLatitude + i), dt));
+		_mm_storeu_pd(args.outLongitude + i, lon);
+		_mm_storeu_pd(args.outLatitude + i, lat);
+	}
+	return i;
+}
+
+TARGET_AVX2 static size_t ProjectAVX2(const ProjectArgs& args, size_t count)
+{
+	auto time = _mm256_set1_pd(args.time);
+	auto zero = _mm256_setzero_pd();
+	auto maxAhead = _mm256_set1_pd(args.maxAhead);
+	auto east = _mm256_set1_pd(180);
+	auto west = _mm256_set1_pd(-180);
+	auto turn = _mm256_set1_pd(360);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		auto dt = _mm256_sub_pd(time, _mm256_loadu_pd(args.sampleTime + i));
+		dt = _mm256_min_pd(_mm256_max_pd(dt, zero), maxAhead);
+
+		auto lon = _mm256_fmadd_pd(_mm256_loadu_pd(args.velocityLongitude + i), dt, _mm256_loadu_pd(args.longitude + i));
+		lon = _mm256_sub_pd(lon, _mm256_and_pd(_mm256_cmp_pd(lon, east, _CMP_GE_OQ), turn));
+		lon = _mm256_add_pd(lon, _mm256_and_pd(_mm256_cmp_pd(lon, west, _CMP_LT_OQ), turn));
+		auto lat = _mm256_fmadd_pd(_mm256_loadu_pd(args.velocityLatitude + i), dt, _mm256_loadu_pd(args.latitude + i));
+		_mm256_storeu_pd(args.outLongitude + i, lon);
+		_mm256_storeu_pd(args.outLatitude + i, lat);
+	}
+	return i;
+}
+
+static bool HasAVX2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	__cpuid(info, 1);
+	bool fma = (info[2] & (1 << 12)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	if (!fma || !osxsave || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+static const bool hasAVX2 = HasAVX2();
+#endif
+
+void TrackStore::Project(double time, double* outLongitude, double* outLatitude, double maxAhead) const
+{
+	ProjectArgs args
+	{
+		stateLongitude.data(),
+		stateLatitude.data(),
+		velocityLongitude.data(),
+		velocityLatitude.data(),
+		sampleTime.data(),
+		outLongitude,
+		outLatitude,
+		time,
+		maxAhead,
+	};
+
+	auto count = active.size();
+	size_t done = 0;
+#ifdef TRACKSTORE_X64
+	if (hasAVX2)
+		done = ProjectAVX2(args, count);
+	else
+		done = ProjectSSE2(args, count);
+#endif
+	ProjectScalar(args, done, count);
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <vector>
+
+// Columnar storage of radar tracks, indexed by airplane slot.
+// Hot kinematic fields live in separate arrays so whole-fleet passes (dead reckoning, spatial queries)
+// only touch the bytes they need.
+// Projection runs from a per-track state which is either the last sample (smoothing off) or
+// the output of an alpha-beta filter fed with the samples.
+class TrackStore
+{
+public:
+	struct Sample
+	{
+		double longitude;
+		double latitude;
+		double heading; // degrees true
+		int altitude;
+		int groundAltitude;
+		int groundSpeed; // knots
+	};
+
+private:
+	std::vector<double> longitude;
+	std::vector<double> latitude;
+	std::vector<double> heading;
+	std::vector<int> altitude;
+	std::vector<int> groundAltitude;
+	std::vector<int> groundSpeed;
+
+	// projection state; velocity in degrees per ms
+	std::vector<double> stateLongitude;
+	std::vector<double> stateLatitude;
+	std::vector<double> velocityLongitude;
+	std::vector<double> velocityLatitude;
+	std::vector<double> sampleTime;
+	std::vector<unsigned char> active;
+
+	bool smoothing;
+	double alpha;
+	double beta;
+
+public:
+	TrackStore();
+
+	// alpha - position gain, beta - velocity gain; both in (0, 1]
+	void SetSmoothing(bool enabled, double alpha = 0.5, double beta = 0.1);
+
+	void Set(unsigned int index, const Sample& sample, double time);
+	void Clear(unsigned int index);
+	void Reset();
+
+	bool IsActive(unsigned int index) const { return index < active.size() && active[index]; }
+	unsigned int GetCapacity() const { return (unsigned int)active.size(); }
+	Sample Get(unsigned int index) const;
+
+	// Projects every track to 'time' (ms, Time::SteadyNow clock) along its last heading and ground speed.
+	// Writes GetCapacity() entries to outLongitude/outLatitude, inactive slots hold unspecified values.
+	// Extrapolation is capped at maxAhead ms past the sample; longitude is wrapped to [-180, 180).
+	void Project(double time, double* outLongitude, double* outLatitude, double maxAhead = 10000) const;
+};
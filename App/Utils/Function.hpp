@@ -64,9 +64,9 @@ public:
 	template <class Fp>
 	Function(Fp func)
 	{
-		if constexpr (std::is_convertible_v<Fp, void*>)
+		if constexpr (std::is_pointer_v<Fp>)
 		{
-			param = func;
+			param = reinterpret_cast<void*>(func);
 			wrap = [](void* param, Args... args)
 				{
 					auto func = reinterpret_cast<Func*>(param);
@@ -79,7 +79,7 @@ public:
 			wrap = reinterpret_cast<Wrap*>(DYNAMIC);
 		}
 		else
-			static_assert(false, "Function supports only non/member functions and non/capturing lambdas");
+			static_assert(sizeof(Fp) == 0, "Function supports only non/member functions and non/capturing lambdas");
 	}
 
 	template <class FpT, FpT Fp, class Ip>
@@ -177,9 +177,9 @@ public:
 	template <class Fp>
 	FunctionS(Fp func)
 	{
-		if constexpr (std::is_convertible_v<Fp, void*>)
+		if constexpr (std::is_pointer_v<Fp>)
 		{
-			param = func;
+			param = reinterpret_cast<void*>(func);
 			wrap = [](void* param, Args... args)
 				{
 					auto func = reinterpret_cast<Func*>(param);
@@ -187,7 +187,7 @@ public:
 				};
 		}
 		else
-			static_assert(false, "FunctionS supports only non/member functions and non-capturing lambdas");
+			static_assert(sizeof(Fp) == 0, "FunctionS supports only non/member functions and non-capturing lambdas");
 	}
 
 	template <class FpT, FpT Fp, class Ip>
@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include "Histogram.h"
+
+unsigned int Histogram::GetBucket(uint64_t value)
+{
+	if (value < SubCount)
+		return (unsigned int)value;
+
+	// keep the top SubBits + 1 bits: leading one selects the power of two, the rest the sub-bucket
+	auto shift = (unsigned int)std::bit_width(value) - (SubBits + 1);
+	auto sub = (unsigned int)(value >> shift) - SubCount;
+	return SubCount + shift * SubCount + sub;
+}
+
+uint64_t Histogram::GetBucketLimit(unsigned int bucket)
+{
+	if (bucket < SubCount)
+		return bucket;
+
+	auto shift = (bucket - SubCount) / SubCount;
+	auto sub = (bucket - SubCount) % SubCount;
+	return ((uint64_t(SubCount + sub + 1)) << shift) - 1;
+}
+
+void Histogram::Record(uint64_t value)
+{
+	value = std::min(value, MaxValue);
+	++buckets[GetBucket(value)];
+	++count;
+	sum += value;
+	max = std::max(max, value);
+}
+
+void Histogram::Add(const Histogram& other)
+{
+	for (unsigned int i = 0; i < BucketCount; ++i)
+		buckets[i] += other.buckets[i];
+	count += other.count;
+	sum += other.sum;
+	max = std::max(max, other.max);
+}
+
+void Histogram::Reset()
+{
+	buckets.fill(0);
+	count = 0;
+	sum = 0;
+	max = 0;
+}
+
+uint64_t Histogram::GetPercentile(double p) const
+{
+	if (!count)
+		return 0;
+
+	auto rank = (uint64_t)std::ceil(std::clamp(p, 0.0, 100.0) / 100.0 * double(count));
+	rank = std::max<uint64_t>(rank, 1);
+
+	uint64_t seen = 0;
+	for (unsigned int i = 0; i < BucketCount; ++i)
+	{
+		seen += buckets[i];
+		if (seen >= rank)
+			return std::min(GetBucketLimit(i), max);
+	}
+	return max;
+}
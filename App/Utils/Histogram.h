@@ -0,0 +1,35 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+// Log-linear histogram of non-negative integer samples (microseconds by convention), HDR style:
+// exact below 16, then 16 buckets per power of two, so a reported percentile is within 1/16 of the sample.
+// Samples above MaxValue are clamped. Not thread safe.
+class Histogram
+{
+public:
+	static constexpr unsigned int SubBits = 4;
+	static constexpr unsigned int SubCount = 1 << SubBits;
+	static constexpr unsigned int MaxShift = 22;
+	static constexpr uint64_t MaxValue = (uint64_t(SubCount * 2) << MaxShift) - 1; // ~134 s in us
+	static constexpr unsigned int BucketCount = SubCount + (MaxShift + 1) * SubCount;
+
+	void Record(uint64_t value);
+	void Add(const Histogram& other);
+	void Reset();
+
+	uint64_t GetCount() const { return count; }
+	uint64_t GetMax() const { return max; }
+	double GetMean() const { return count ? double(sum) / double(count) : 0.0; }
+	// Upper bound of the bucket holding the p-th percentile sample (0-100), 0 when empty
+	uint64_t GetPercentile(double p) const;
+
+private:
+	std::array<uint32_t, BucketCount> buckets{};
+	uint64_t count = 0;
+	uint64_t sum = 0;
+	uint64_t max = 0;
+
+	static unsigned int GetBucket(uint64_t value);
+	static uint64_t GetBucketLimit(unsigned int bucket);
+};
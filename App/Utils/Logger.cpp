@@ -1,4 +1,5 @@
 #include <chrono>
+#include <filesystem>
 #include <functional>
 #include <fstream>
 #include <iostream>
@@ -49,7 +50,7 @@ struct LoggerImpl
 	void Log(const std::string_view&, ColorEx, LogLevel);
 };
 
-static alignas(LoggerImpl) unsigned char buffer[sizeof(LoggerImpl)]{};
+alignas(LoggerImpl) static unsigned char buffer[sizeof(LoggerImpl)]{};
 static LoggerImpl* pInstance = nullptr;
 
 #if _DEBUG
@@ -128,7 +129,7 @@ void LoggerImpl::OpenLogFile(const std::wstring& name)
 	std::lock_guard lock(mutex);
 
 	file.close();
-	file.open(name, std::ofstream::app);
+	file.open(std::filesystem::path(name), std::ofstream::app);
 
 	auto const time = std::chrono::current_zone()->to_local(std::chrono::system_clock::now());
 	auto out = std::format("Starting logger - {:%c}", time);
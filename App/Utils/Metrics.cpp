@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <format>
+#include <mutex>
+#include "Metrics.h"
+
+using namespace Metrics;
+
+namespace
+{
+	enum class Type
+	{
+		Counter,
+		Gauge,
+		Histogram,
+	};
+
+	struct Metric
+	{
+		std::string name;
+		std::string help;
+		std::string labels;
+		Type type;
+
+		std::unique_ptr<Counter> counter;
+		std::unique_ptr<Gauge> gauge;
+		std::unique_ptr<Histogram> histogram;
+		std::function<double()> read;
+	};
+
+	// function local, so metrics can be registered from static initializers of any translation unit;
+	// never destroyed, globals such as webcast still update their metrics while statics go away
+	struct Registry
+	{
+		std::mutex mutex;
+		std::vector<std::unique_ptr<Metric>> metrics;
+	};
+
+	Registry& GetRegistry()
+	{
+		static auto& registry = *new Registry;
+		return registry;
+	}
+
+	// Existing metric of that name and labels, or a new one; caller holds the registry lock
+	Metric& Find(Registry& registry, std::string_view name, std::string_view help, std::string_view labels, Type type)
+	{
+		for (auto& metric : registry.metrics)
+		{
+			if (metric->name == name && metric->labels == labels)
+				return *metric;
+		}
+
+		auto& metric = registry.metrics.emplace_back(std::make_unique<Metric>());
+		metric->name = name;
+		metric->help = help;
+		metric->labels = labels;
+		metric->type = type;
+		return *metric;
+	}
+
+	thread_local unsigned int shard = []()
+		{
+			static std::atomic<unsigned int> nextShard(0);
+			return nextShard.fetch_add(1, std::memory_order_relaxed) % Counter::Shards;
+		}();
+}
+
+void Counter::Add(uint64_t value)
+{
+	shards[shard].value.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t Counter::Get() const
+{
+	uint64_t total = 0;
+	for (auto& s : shards)
+		total += s.value.load(std::memory_order_relaxed);
+	return total;
+}
+
+Histogram::Histogram(std::vector<double> bounds) : bounds(std::move(bounds)), counts(new std::atomic<uint64_t>[this->bounds.size() + 1])
+{
+	std::sort(this->bounds.begin(), this->bounds.end());
+	for (size_t i = 0; i <= this->bounds.size(); ++i)
+		counts[i] = 0;
+}
+
+void Histogram::Observe(double value)
+{
+	auto bucket = std::lower_bound(bounds.begin(), bounds.end(), value) - bounds.begin();
+	counts[bucket].fetch_add(1, std::memory_order_relaxed);
+	sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::GetCumulative(size_t i) const
+{
+	uint64_t total = 0;
+	for (size_t j = 0; j <= i && j <= bounds.size(); ++j)
+		total += counts[j].load(std::memory_order_relaxed);
+	return total;
+}
+
+Counter& Metrics::AddCounter(std::string_view name, std::string_view help, std::string_view labels)
+{
+	auto& registry = GetRegistry();
+	std::lock_guard lock(registry.mutex);
+	auto& metric = Find(registry, name, help, labels, Type::Counter);
+	if (!metric.counter)
+		metric.counter = std::make_unique<Counter>();
+	return *metric.counter;
+}
+
+Gauge& Metrics::AddGauge(std::string_view name, std::string_view help, std::string_view labels)
+{
+	auto& registry = GetRegistry();
+	std::lock_guard lock(registry.mutex);
+	auto& metric = Find(registry, name, help, labels, Type::Gauge);
+	if (!metric.gauge)
+		metric.gauge = std::make_unique<Gauge>();
+	return *metric.gauge;
+}
+
+Histogram& Metrics::AddHistogram(std::string_view name, std::string_view help, const std::vector<double>& bounds, std::string_view labels)
+{
+	auto& registry = GetRegistry();
+	std::lock_guard lock(registry.mutex);
+	auto& metric = Find(registry, name, help, labels, Type::Histogram);
+	if (!metric.histogram)
+		metric.histogram = std::make_unique<Histogram>(bounds);
+	return *metric.histogram;
+}
+
+void Metrics::AddCounterCallback(std::string_view name, std::string_view help, std::function<double()> read, std::string_view labels)
+{
+	auto& registry = GetRegistry();
+	std::lock_guard lock(registry.mutex);
+	Find(registry, name, help, labels, Type::Counter).read = std::move(read);
+}
+
+void Metrics::AddGaugeCallback(std::string_view name, std::string_view help, std::function<double()> read, std::string_view labels)
+{
+	auto& registry = GetRegistry();
+	std::lock_guard lock(registry.mutex);
+	Find(registry, name, help, labels, Type::Gauge).read = std::move(read);
+}
+
+static std::string_view TypeName(Type type)
+{
+	switch (type)
+	{
+		case Type::Counter: return "counter";
+		case Type::Gauge: return "gauge";
+		default: return "histogram";
+	}
+}
+
+static std::string JoinLabels(std::string_view labels, std::string_view extra)
+{
+	if (labels.empty() && extra.empty())
+		return {};
+	if (labels.empty() || extra.empty())
+		return std::format("{{{}{}}}", labels, extra);
+	return std::format("{{{},{}}}", labels, extra);
+}
+
+std::string Metrics::Format()
+{
+	auto& registry = GetRegistry();
+	std::lock_guard lock(registry.mutex);
+
+	// a family's HELP and TYPE come once, before all of its series
+	std::vector<const Metric*> sorted;
+	for (auto& metric : registry.metrics)
+		sorted.push_back(metric.get());
+	std::stable_sort(sorted.begin(), sorted.end(), [](auto a, auto b) { return a->name < b->name; });
+
+	std::string out;
+	std::string_view family;
+	for (auto metric : sorted)
+	{
+		if (metric->name != family)
+		{
+			family = metric->name;
+			out += std::format("# HELP {} {}\n# TYPE {} {}\n", metric->name, metric->help, metric->name, TypeName(metric->type));
+		}
+
+		auto labels = JoinLabels(metric->labels, {});
+		if (metric->read)
+			out += std::format("{}{} {}\n", metric->name, labels, metric->read());
+		else if (metric->counter)
+			out += std::format("{}{} {}\n", metric->name, labels, metric->counter->Get());
+		else if (metric->gauge)
+			out += std::format("{}{} {}\n", metric->name, labels, metric->gauge->Get());
+		else if (metric->histogram)
+		{
+			auto& histogram = *metric->histogram;
+			auto& bounds = histogram.GetBounds();
+			for (size_t i = 0; i < bounds.size(); ++i)
+				out += std::format("{}_bucket{} {}\n", metric->name, JoinLabels(metric->labels, std::format("le=\"{}\"", bounds[i])), histogram.GetCumulative(i));
+
+			auto count = histogram.GetCumulative(bounds.size());
+			out += std::format("{}_bucket{} {}\n", metric->name, JoinLabels(metric->labels, "le=\"+Inf\""), count);
+			out += std::format("{}_sum{} {}\n", metric->name, labels, histogram.GetSum());
+			out += std::format("{}_count{} {}\n", metric->name, labels, count);
+		}
+	}
+	return out;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Process-wide metrics in Prometheus text format (served on GET /metrics).
+// Metrics are registered once, usually into a static reference next to the code that updates them,
+// and live until exit. Updates are lock free from any thread; only registration and Format take a lock.
+namespace Metrics
+{
+	// Monotonic count, sharded by thread so hot paths on different threads do not share a cache line
+	class Counter
+	{
+	public:
+		static constexpr unsigned int Shards = 16;
+
+		void Add(uint64_t value = 1);
+		uint64_t Get() const;
+
+	private:
+		struct alignas(64) Shard
+		{
+			std::atomic<uint64_t> value{ 0 };
+		};
+		std::array<Shard, Shards> shards;
+	};
+
+	class Gauge
+	{
+	public:
+		void Set(int64_t value) { this->value.store(value, std::memory_order_relaxed); }
+		void Add(int64_t delta) { value.fetch_add(delta, std::memory_order_relaxed); }
+		int64_t Get() const { return value.load(std::memory_order_relaxed); }
+
+	private:
+		std::atomic<int64_t> value{ 0 };
+	};
+
+	// Cumulative buckets with fixed upper bounds, as Prometheus expects them
+	class Histogram
+	{
+	public:
+		explicit Histogram(std::vector<double> bounds);
+
+		void Observe(double value);
+
+		const std::vector<double>& GetBounds() const { return bounds; }
+		// count of samples <= bounds[i]; i == bounds.size() - all samples
+		uint64_t GetCumulative(size_t i) const;
+		double GetSum() const { return sum.load(std::memory_order_relaxed); }
+
+	private:
+		std::vector<double> bounds;
+		std::unique_ptr<std::atomic<uint64_t>[]> counts; // per bucket, last one above every bound
+		std::atomic<double> sum{ 0.0 };
+	};
+
+	// name - metric family, labels - label list without braces (e.g. type="open"), empty for none.
+	// Registering the same name and labels again returns the existing metric.
+	Counter& AddCounter(std::string_view name, std::string_view help, std::string_view labels = {});
+	Gauge& AddGauge(std::string_view name, std::string_view help, std::string_view labels = {});
+	Histogram& AddHistogram(std::string_view name, std::string_view help, const std::vector<double>& bounds, std::string_view labels = {});
+
+	// Value read at scrape time, for state that is already counted elsewhere; read must be thread safe
+	void AddCounterCallback(std::string_view name, std::string_view help, std::function<double()> read, std::string_view labels = {});
+	void AddGaugeCallback(std::string_view name, std::string_view help, std::function<double()> read, std::string_view labels = {});
+
+	// Exposition format 0.0.4
+	std::string Format();
+	static constexpr std::string_view ContentType = "text/plain; version=0.0.4; charset=utf-8";
+}
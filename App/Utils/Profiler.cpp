@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <format>
+#include <iterator>
+#include "Profiler.h"
+
+static const char* PhaseNames[] = { "tick", "simconnect", "radar", "webdriver", "webcast_send" };
+static_assert(std::size(PhaseNames) == Profiler::PhaseCount);
+
+Profiler::Profiler() : tickTotals{}, tickMask(0), second(Time::SteadyNowInt() / 1000), filled(0), snapshot{}
+{
+}
+
+void Profiler::EndTick()
+{
+	auto now = Time::SteadyNowInt() / 1000;
+	if (now != second)
+	{
+		// drop the seconds that left the window, the current slot among them, then publish the rest
+		auto elapsed = (unsigned long long)(now - second);
+		for (unsigned long long i = 1; i <= std::min<unsigned long long>(elapsed, SlotCount); ++i)
+		{
+			for (auto& histogram : window[(second + i) % SlotCount])
+				histogram.Reset();
+		}
+		filled = (unsigned int)std::min<unsigned long long>(filled + elapsed, WindowSeconds);
+		second = now;
+		Publish();
+	}
+
+	auto& slot = window[second % SlotCount];
+	for (size_t i = 0; i < PhaseCount; ++i)
+	{
+		if (tickMask & (1u << i))
+			slot[i].Record((uint64_t)(tickTotals[i] * 1000.0));
+	}
+	tickTotals = {};
+	tickMask = 0;
+}
+
+void Profiler::Publish()
+{
+	Snapshot result{ filled };
+	for (size_t i = 0; i < PhaseCount; ++i)
+	{
+		Histogram merged;
+		for (auto& slot : window)
+			merged.Add(slot[i]);
+		result.phases[i] = { merged.GetCount(), merged.GetPercentile(50), merged.GetPercentile(99), merged.GetMax(), merged.GetMean() };
+	}
+
+	std::lock_guard lock(mutex);
+	snapshot = result;
+}
+
+Profiler::Snapshot Profiler::GetSnapshot() const
+{
+	std::lock_guard lock(mutex);
+	return snapshot;
+}
+
+std::string Profiler::ToJson() const
+{
+	auto stats = GetSnapshot();
+	auto json = std::format("{{\"window_s\":{},\"unit\":\"us\",\"phases\":{{", stats.seconds);
+	for (size_t i = 0; i < PhaseCount; ++i)
+	{
+		auto& phase = stats.phases[i];
+		json += std::format("{}\"{}\":{{\"ticks\":{},\"p50\":{},\"p99\":{},\"max\":{},\"mean\":{:.1f}}}",
+			i ? "," : "", PhaseNames[i], phase.ticks, phase.p50, phase.p99, phase.max, phase.mean);
+	}
+	json += "}}";
+	return json;
+}
+
+const char* Profiler::GetName(ProfilePhase phase)
+{
+	return PhaseNames[(size_t)phase];
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "Histogram.h"
+#include "Time.h"
+
+enum class ProfilePhase
+{
+	Tick, // whole OnTick
+	SimCallbacks, // simcom.RunCallbacks
+	RadarUpdate, // radar.OnUpdate
+	WebDriver, // packing radar changes into messages, sends included
+	WebCastSend, // handing frames to the sockets
+	Count,
+};
+
+// Time spent per tick in each phase, kept as 1 s histograms over a rolling window.
+// Phases nest (a phase includes the phases it calls), repeated scopes within a tick add up.
+// Add and EndTick are called on the tick thread only; GetSnapshot and ToJson from any thread.
+class Profiler
+{
+public:
+	static constexpr unsigned int WindowSeconds = 10;
+	static constexpr size_t PhaseCount = (size_t)ProfilePhase::Count;
+
+	struct PhaseStats
+	{
+		uint64_t ticks; // ticks the phase ran in
+		uint64_t p50; // us
+		uint64_t p99;
+		uint64_t max;
+		double mean;
+	};
+
+	struct Snapshot
+	{
+		unsigned int seconds; // length of the window the stats cover
+		std::array<PhaseStats, PhaseCount> phases;
+	};
+
+	Profiler();
+
+	void Add(ProfilePhase phase, double ms)
+	{
+		tickTotals[(size_t)phase] += ms;
+		tickMask |= 1u << (size_t)phase;
+	}
+	// Records the totals of the finished tick; once a second rotates the window and publishes a snapshot
+	void EndTick();
+
+	Snapshot GetSnapshot() const;
+	std::string ToJson() const;
+
+	static const char* GetName(ProfilePhase phase);
+
+private:
+	std::array<double, PhaseCount> tickTotals;
+	unsigned int tickMask; // phases that ran in the current tick
+	static constexpr unsigned int SlotCount = WindowSeconds + 1; // the complete seconds and the current one
+
+	std::array<std::array<Histogram, PhaseCount>, SlotCount> window; // slot per second
+	long long second; // of the current slot
+	unsigned int filled; // complete seconds in the window
+
+	mutable std::mutex mutex;
+	Snapshot snapshot;
+
+	void Publish();
+};
+
+// Adds the lifetime of the scope to a phase
+class ProfileScope
+{
+private:
+	Profiler& profiler;
+	ProfilePhase phase;
+	double start;
+
+public:
+	ProfileScope(Profiler& profiler, ProfilePhase phase) : profiler(profiler), phase(phase), start(Time::SteadyNow()) {}
+	~ProfileScope() { profiler.Add(phase, Time::SteadyNow() - start); }
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+};
@@ -0,0 +1,117 @@
+#include <bit>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
+#include "SharedBuffer.h"
+
+static constexpr unsigned int MinClassBits = 6; // 64 B
+static constexpr unsigned int ClassCount = 11; // up to 64 KB
+static constexpr unsigned int Unpooled = ClassCount;
+static constexpr size_t MaxCachedPerClass = 64;
+
+struct SharedBufferPool
+{
+	std::mutex mutex;
+	std::vector<void*> blocks[ClassCount];
+
+	~SharedBufferPool()
+	{
+		for (auto& list : blocks)
+		{
+			for (auto block : list)
+				::operator delete(block);
+		}
+	}
+};
+
+static SharedBufferPool& GetPool()
+{
+	// Never destroyed: buffers held by globals (webcast journal, socket queues) are released after statics go away
+	static auto& pool = *new SharedBufferPool;
+	return pool;
+}
+
+static unsigned int GetSizeClass(size_t size)
+{
+	if (size <= (size_t(1) << MinClassBits))
+		return 0;
+	auto bits = (unsigned int)std::bit_width(size - 1);
+	return bits - MinClassBits < ClassCount ? bits - MinClassBits : Unpooled;
+}
+
+SharedBuffer::Block* SharedBuffer::Allocate(size_t size)
+{
+	auto sizeClass = GetSizeClass(size);
+	void* memory = nullptr;
+
+	if (sizeClass != Unpooled)
+	{
+		auto& pool = GetPool();
+		std::lock_guard lock(pool.mutex);
+		auto& list = pool.blocks[sizeClass];
+		if (!list.empty())
+		{
+			memory = list.back();
+			list.pop_back();
+		}
+	}
+
+	if (!memory)
+	{
+		auto capacity = sizeClass != Unpooled ? size_t(1) << (sizeClass + MinClassBits) : size;
+		memory = ::operator new(sizeof(Block) + capacity);
+	}
+
+	auto block = new (memory) Block;
+	block->refs.store(1, std::memory_order_relaxed);
+	block->sizeClass = sizeClass;
+	block->size = size;
+	return block;
+}
+
+void SharedBuffer::Release(Block* block)
+{
+	auto sizeClass = block->sizeClass;
+	block->~Block();
+
+	if (sizeClass != Unpooled)
+	{
+		auto& pool = GetPool();
+		std::lock_guard lock(pool.mutex);
+		auto& list = pool.blocks[sizeClass];
+		if (list.size() < MaxCachedPerClass)
+		{
+			list.push_back(block);
+			return;
+		}
+	}
+	::operator delete(block);
+}
+
+SharedBuffer SharedBuffer::Copy(std::initializer_list<std::string_view> parts)
+{
+	size_t size = 0;
+	for (auto& part : parts)
+		size += part.size();
+
+	auto block = Allocate(size);
+	auto out = block->Data();
+	for (auto& part : parts)
+	{
+		if (!part.empty())
+			memcpy(out, part.data(), part.size());
+		out += part.size();
+	}
+	return SharedBuffer(block);
+}
+
+size_t SharedBuffer::GetPooledCount()
+{
+	auto& pool = GetPool();
+	std::lock_guard lock(pool.mutex);
+	size_t count = 0;
+	for (auto& list : pool.blocks)
+		count += list.size();
+	return count;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <initializer_list>
+#include <string_view>
+#include <utility>
+#include "FixedArray.h"
+
+// Immutable byte buffer with an atomic reference count, for handing one encoded frame to many receivers.
+// Copies share the storage; blocks come from a size-class pool and go back to it when the last reference is dropped.
+class SharedBuffer
+{
+private:
+	struct Block
+	{
+		std::atomic<unsigned int> refs;
+		unsigned int sizeClass;
+		size_t size;
+
+		char* Data() { return reinterpret_cast<char*>(this + 1); }
+	};
+
+	Block* block;
+
+	explicit SharedBuffer(Block* block) : block(block)
+	{
+	}
+
+	static Block* Allocate(size_t size);
+	static void Release(Block* block);
+
+public:
+	SharedBuffer() : block(nullptr)
+	{
+	}
+
+	SharedBuffer(const SharedBuffer& other) : block(other.block)
+	{
+		if (block)
+			block->refs.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	SharedBuffer(SharedBuffer&& other) noexcept : block(other.block)
+	{
+		other.block = nullptr;
+	}
+
+	SharedBuffer& operator=(const SharedBuffer& other)
+	{
+		SharedBuffer copy(other);
+		std::swap(block, copy.block);
+		return *this;
+	}
+
+	SharedBuffer& operator=(SharedBuffer&& other) noexcept
+	{
+		std::swap(block, other.block);
+		return *this;
+	}
+
+	~SharedBuffer()
+	{
+		if (block && block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			Release(block);
+	}
+
+	const char* data() const { return block ? block->Data() : nullptr; }
+	size_t size() const { return block ? block->size : 0; }
+	bool empty() const { return size() == 0; }
+
+	// New buffer holding the parts one after another
+	static SharedBuffer Copy(std::initializer_list<std::string_view> parts);
+	static SharedBuffer Copy(const char* data, size_t size) { return Copy({ std::string_view(data, size) }); }
+	static SharedBuffer Copy(const FixedArrayCharS& data) { return Copy(data, data.size()); }
+
+	// Blocks currently cached by the pool, for diagnostics
+	static size_t GetPooledCount();
+};
@@ -0,0 +1,107 @@
+#pragma once
+#include <vector>
+
+struct SlotHandle
+{
+	unsigned int index = 0;
+	unsigned int generation = 0; // 0 - invalid handle
+
+	explicit operator bool() const { return generation != 0; }
+	bool operator==(const SlotHandle&) const = default;
+};
+
+// Dense storage with stable generation-checked handles.
+// Insert/Get/Remove are O(1); Remove swaps the last element into the hole, so element order is not preserved
+// and references are invalidated by Insert and Remove - keep handles instead.
+template <typename T>
+class SlotMap
+{
+private:
+	struct Slot
+	{
+		unsigned int dense;
+		unsigned int generation;
+	};
+
+	std::vector<T> values;
+	std::vector<unsigned int> owners; // dense index -> slot index
+	std::vector<Slot> slots;
+	std::vector<unsigned int> freeSlots;
+
+public:
+	SlotHandle Insert(T&& value)
+	{
+		unsigned int index;
+		if (!freeSlots.empty())
+		{
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else
+		{
+			index = (unsigned int)slots.size();
+			slots.push_back({ 0, 1 });
+		}
+
+		auto& slot = slots[index];
+		slot.dense = (unsigned int)values.size();
+		values.emplace_back(std::move(value));
+		owners.push_back(index);
+		return { index, slot.generation };
+	}
+
+	T* Get(SlotHandle handle)
+	{
+		if (handle.index >= slots.size())
+			return nullptr;
+
+		auto& slot = slots[handle.index];
+		if (slot.generation != handle.generation)
+			return nullptr;
+		return &values[slot.dense];
+	}
+
+	bool Remove(SlotHandle handle)
+	{
+		if (!Get(handle))
+			return false;
+
+		auto& slot = slots[handle.index];
+		auto last = (unsigned int)values.size() - 1;
+		if (slot.dense != last)
+		{
+			values[slot.dense] = std::move(values[last]);
+			owners[slot.dense] = owners[last];
+			slots[owners[last]].dense = slot.dense;
+		}
+		values.pop_back();
+		owners.pop_back();
+
+		if (++slot.generation == 0)
+			slot.generation = 1;
+		freeSlots.push_back(handle.index);
+		return true;
+	}
+
+	void Clear()
+	{
+		values.clear();
+		owners.clear();
+		for (auto& slot : slots)
+		{
+			if (++slot.generation == 0)
+				slot.generation = 1;
+		}
+		freeSlots.clear();
+		for (auto i = (unsigned int)slots.size(); i > 0; --i)
+			freeSlots.push_back(i - 1);
+	}
+
+	size_t Size() const { return values.size(); }
+	bool Empty() const { return values.empty(); }
+
+	auto begin() { return values.begin(); }
+	auto end() { return values.end(); }
+	auto begin() const { return values.begin(); }
+	auto end() const { return values.end(); }
+};
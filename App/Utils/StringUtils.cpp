@@ -1,11 +1,16 @@
+#include <cstdint>
 #include <format>
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
-#if _DEBUG
-	#include <comdef.h>
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+	#if _DEBUG
+		#include <comdef.h>
+	#endif
 #endif
 #include "StringUtils.h"
 
+#ifdef _WIN32
+
 std::wstring StringUtils::Utf8ToWideString(const std::string_view& str)
 {
 	std::wstring out;
@@ -53,8 +58,78 @@ std::string StringUtils::WideStringToUtf8(const std::wstring_view& str)
 
 	return out;
 }
+#else
+// wchar_t is UTF-32 outside Windows; invalid sequences decode byte by byte like the Windows fallback
+std::wstring StringUtils::Utf8ToWideString(const std::string_view& str)
+{
+	std::wstring out;
+	out.reserve(str.size());
+
+	for (size_t i = 0; i < str.size();)
+	{
+		auto lead = (unsigned char)str[i];
+		size_t count = lead < 0x80 ? 0 : (lead >> 5) == 0x6 ? 1 : (lead >> 4) == 0xE ? 2 : (lead >> 3) == 0x1E ? 3 : SIZE_MAX;
+		if (count == SIZE_MAX || i + count >= str.size())
+		{
+			out.push_back((wchar_t)lead);
+			i++;
+			continue;
+		}
+
+		char32_t code = count == 0 ? lead : lead & (0x3F >> count);
+		size_t n = 1;
+		for (; n <= count && ((unsigned char)str[i + n] >> 6) == 0x2; n++)
+			code = (code << 6) | ((unsigned char)str[i + n] & 0x3F);
+
+		if (n <= count)
+		{
+			out.push_back((wchar_t)lead);
+			i++;
+			continue;
+		}
+
+		out.push_back((wchar_t)code);
+		i += count + 1;
+	}
+
+	return out;
+}
+
+std::string StringUtils::WideStringToUtf8(const std::wstring_view& str)
+{
+	std::string out;
+	out.reserve(str.size());
+
+	for (wchar_t ch : str)
+	{
+		auto code = (char32_t)ch;
+		if (code < 0x80)
+			out.push_back((char)code);
+		else if (code < 0x800)
+		{
+			out.push_back((char)(0xC0 | (code >> 6)));
+			out.push_back((char)(0x80 | (code & 0x3F)));
+		}
+		else if (code < 0x10000)
+		{
+			out.push_back((char)(0xE0 | (code >> 12)));
+			out.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+			out.push_back((char)(0x80 | (code & 0x3F)));
+		}
+		else
+		{
+			out.push_back((char)(0xF0 | ((code >> 18) & 0x07)));
+			out.push_back((char)(0x80 | ((code >> 12) & 0x3F)));
+			out.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+			out.push_back((char)(0x80 | (code & 0x3F)));
+		}
+	}
+
+	return out;
+}
+#endif
 
-#if _DEBUG
+#if defined(_WIN32) && _DEBUG
 std::string StringUtils::Format(HRESULT hr)
 {
 	if (hr == E_FAIL)
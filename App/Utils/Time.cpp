@@ -1,9 +1,12 @@
 #include <chrono>
 #include <thread>
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
+#endif
 #include "Time.h"
 
+#ifdef _WIN32
 // guaranteed 1MHz+ (<1us)
 static long long GetFrequency()
 {
@@ -29,6 +32,25 @@ long long Time::SteadyNowInt()
 	QueryPerformanceCounter(&ctr);
 	return ctr.QuadPart / FrequencyMilli;
 }
+#else
+double Time::SteadyNow()
+{
+	auto now = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration<double, std::milli>(now).count();
+}
+
+long long Time::SteadyNowInt()
+{
+	auto now = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+}
+#endif
+
+long long Time::UnixNowInt()
+{
+	auto now = std::chrono::system_clock::now().time_since_epoch();
+	return std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+}
 
 void Time::Sleep(unsigned int ms)
 {
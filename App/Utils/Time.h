@@ -12,6 +12,11 @@ namespace Time
 	/// </summary>
 	long long SteadyNowInt();
 
+	/// <summary>
+	/// Wall clock timestamp in milliseconds since Unix epoch
+	/// </summary>
+	long long UnixNowInt();
+
 	/// <summary>
 	/// Sleep for at least specified time in ms
 	/// </summary>
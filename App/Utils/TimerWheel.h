@@ -0,0 +1,56 @@
+#pragma once
+#include <vector>
+
+// Hashed timer wheel with coarse resolution. Entries are handed back once their bucket passes;
+// the owner re-checks the real deadline and reschedules if needed, so deadlines can be extended
+// without touching the wheel.
+template <typename T, unsigned int BucketCount = 64>
+class TimerWheel
+{
+private:
+	std::vector<T> buckets[BucketCount];
+	std::vector<T> expired;
+	long long resolution;
+	long long current;
+
+public:
+	explicit TimerWheel(long long resolution) : resolution(resolution), current(-1)
+	{
+	}
+
+	void Schedule(const T& value, long long deadline)
+	{
+		auto tick = deadline / resolution;
+		if (current >= 0 && tick < current)
+			tick = current;
+		buckets[tick % BucketCount].push_back(value);
+	}
+
+	template <typename F>
+	void Advance(long long now, F&& onExpired)
+	{
+		auto tick = now / resolution;
+		if (current < 0 || tick - current >= BucketCount)
+			current = tick - BucketCount + 1;
+
+		while (current < tick)
+		{
+			auto& bucket = buckets[current % BucketCount];
+			++current;
+			if (bucket.empty())
+				continue;
+
+			expired.swap(bucket);
+			for (auto& value : expired)
+				onExpired(value);
+			expired.clear();
+		}
+	}
+
+	void Clear()
+	{
+		for (auto& bucket : buckets)
+			bucket.clear();
+		current = -1;
+	}
+};
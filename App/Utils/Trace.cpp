@@ -0,0 +1,110 @@
+#include <format>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "Trace.h"
+
+namespace
+{
+	struct Event
+	{
+		const char* name;
+		double begin;
+		double end;
+	};
+
+	// Written by its thread only; the collector reads below head
+	struct Buffer
+	{
+		std::unique_ptr<Event[]> events{ new Event[Trace::EventsPerThread] };
+		std::atomic<unsigned long long> head{ 0 };
+		unsigned int tid;
+		const char* name;
+	};
+
+	// slots right below head may be in the middle of being overwritten by a writer that saw 'running' late
+	constexpr size_t WriteMargin = 64;
+
+	std::mutex mutex; // buffers, startTime, last
+	std::vector<std::unique_ptr<Buffer>> buffers; // kept after their threads exit
+	double startTime;
+	std::shared_ptr<const std::string> last;
+
+	thread_local Buffer* localBuffer;
+	thread_local const char* localName;
+}
+
+std::atomic_bool Trace::running(false);
+
+void Trace::Start()
+{
+	std::lock_guard lock(mutex);
+	startTime = Time::SteadyNow();
+	running = true;
+}
+
+std::shared_ptr<const std::string> Trace::Stop()
+{
+	std::lock_guard lock(mutex);
+	if (!running.exchange(false))
+		return last;
+
+	auto json = std::make_shared<std::string>("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	auto separator = [&first]() { return std::exchange(first, false) ? "" : ",\n"; };
+
+	for (auto& buffer : buffers)
+	{
+		json->append(std::format("{}{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}",
+			separator(), buffer->tid, buffer->name ? buffer->name : "thread"));
+
+		auto head = buffer->head.load(std::memory_order_acquire);
+		auto from = head > EventsPerThread - WriteMargin ? head - (EventsPerThread - WriteMargin) : 0;
+		for (auto i = from; i < head; ++i)
+		{
+			auto& event = buffer->events[i % EventsPerThread];
+			if (event.begin < startTime)
+				continue;
+
+			// microseconds from the start of the capture
+			json->append(std::format("{}{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+				separator(), event.name, buffer->tid, (event.begin - startTime) * 1000.0, (event.end - event.begin) * 1000.0));
+		}
+	}
+	json->append("\n]}\n");
+
+	last = std::move(json);
+	return last;
+}
+
+std::shared_ptr<const std::string> Trace::GetLast()
+{
+	std::lock_guard lock(mutex);
+	return last;
+}
+
+void Trace::SetThreadName(const char* name)
+{
+	localName = name;
+	if (localBuffer)
+	{
+		std::lock_guard lock(mutex);
+		localBuffer->name = name;
+	}
+}
+
+void Trace::Record(const char* name, double begin, double end)
+{
+	if (!localBuffer)
+	{
+		std::lock_guard lock(mutex);
+		auto& buffer = buffers.emplace_back(std::make_unique<Buffer>());
+		buffer->tid = (unsigned int)buffers.size();
+		buffer->name = localName;
+		localBuffer = buffer.get();
+	}
+
+	auto head = localBuffer->head.load(std::memory_order_relaxed);
+	localBuffer->events[head % EventsPerThread] = { name, begin, end };
+	localBuffer->head.store(head + 1, std::memory_order_release);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <string>
+#include "Time.h"
+
+// Timeline capture in Chrome trace event format, opens in ui.perfetto.dev or chrome://tracing.
+// Every thread records complete events (begin + duration) into its own ring buffer without locks;
+// Stop() collects the buffers into one JSON document.
+// The TRACE_* macros record only in builds with TRACE_ENABLE and compile to nothing otherwise.
+namespace Trace
+{
+	static constexpr size_t EventsPerThread = 1 << 16; // the oldest events are overwritten
+
+	extern std::atomic_bool running;
+	inline bool IsRunning() { return running.load(std::memory_order_relaxed); }
+
+	void Start();
+	// Returns the captured trace, which is also kept for GetLast
+	std::shared_ptr<const std::string> Stop();
+	std::shared_ptr<const std::string> GetLast();
+
+	// Name of the calling thread's track; name must outlive the program (string literal)
+	void SetThreadName(const char* name);
+	// begin, end - Time::SteadyNow; name must be a string literal
+	void Record(const char* name, double begin, double end);
+
+	class Scope
+	{
+	private:
+		const char* name;
+		double begin;
+
+	public:
+		Scope(const char* name) : name(name), begin(IsRunning() ? Time::SteadyNow() : 0.0) {}
+		~Scope()
+		{
+			if (begin != 0.0)
+				Record(name, begin, Time::SteadyNow());
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	};
+}
+
+#ifdef TRACE_ENABLE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) Trace::SetThreadName(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <system_error>
+#include <vector>
+#include "Utils/Boost.h"
+#include <boost/beast/zlib/deflate_stream.hpp>
+#include <boost/crc.hpp>
+#include "AssetCache.hpp"
+#include "Utils/Logger.h"
+#ifdef EMBED_ASSETS
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include "EmbeddedAssets.h" // generated into $(IntDir)Embedded by the pre-build step
+#endif
+
+static constexpr uintmax_t MaxAssetSize = 16 << 20; // larger files are streamed from disk
+static constexpr size_t MinCompressSize = 256;
+
+static std::string Gzip(const std::string& data)
+{
+	namespace zlib = boost::beast::zlib;
+
+	zlib::deflate_stream stream;
+	stream.reset(9, 15, 8, zlib::Strategy::normal);
+
+	// gzip member: header, raw deflate data, crc32 and size of the input
+	static const char header[10] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 2, '\xff' };
+	std::string out(header, sizeof(header));
+	out.resize(sizeof(header) + stream.upper_bound(data.size()) + 8);
+
+	zlib::z_params params;
+	params.next_in = data.data();
+	params.avail_in = data.size();
+	params.next_out = out.data() + sizeof(header);
+	params.avail_out = out.size() - sizeof(header) - 8;
+
+	boost::beast::error_code ec;
+	stream.write(params, zlib::Flush::finish, ec);
+	if (ec != zlib::error::end_of_stream)
+		return {};
+
+	boost::crc_32_type crc;
+	crc.process_bytes(data.data(), data.size());
+
+	auto trailer = out.data() + sizeof(header) + params.total_out;
+	uint32_t values[2]{ crc.checksum(), (uint32_t)data.size() };
+	for (int i = 0; i < 8; ++i)
+		trailer[i] = (char)(values[i / 4] >> (i % 4 * 8));
+	out.resize(sizeof(header) + params.total_out + 8);
+	return out;
+}
+
+static std::string CreateEtag(const std::string& data, std::string_view suffix)
+{
+	// FNV-1a over the content
+	uint64_t hash = 14695981039346656037ull;
+	for (unsigned char c : data)
+		hash = (hash ^ c) * 1099511628211ull;
+	return std::format("\"{:016x}-{:x}{}\"", hash, data.size(), suffix);
+}
+
+static bool IsCompressible(std::string_view contentType)
+{
+	return contentType.starts_with("text/") || contentType.starts_with("application/javascript") ||
+		contentType.starts_with("application/json") || contentType.starts_with("image/svg+xml") ||
+		contentType.starts_with("application/wasm");
+}
+
+std::string_view AssetCache::GetContentType(std::string_view path)
+{
+	static const std::pair<std::string_view, std::string_view> types[] =
+	{
+		{ ".html", "text/html; charset=utf-8" },
+		{ ".htm", "text/html; charset=utf-8" },
+		{ ".js", "application/javascript; charset=utf-8" },
+		{ ".mjs", "application/javascript; charset=utf-8" },
+		{ ".css", "text/css; charset=utf-8" },
+		{ ".json", "application/json" },
+		{ ".map", "application/json" },
+		{ ".txt", "text/plain; charset=utf-8" },
+		{ ".svg", "image/svg+xml" },
+		{ ".png", "image/png" },
+		{ ".jpg", "image/jpeg" },
+		{ ".jpeg", "image/jpeg" },
+		{ ".gif", "image/gif" },
+		{ ".webp", "image/webp" },
+		{ ".ico", "image/x-icon" },
+		{ ".woff", "font/woff" },
+		{ ".woff2", "font/woff2" },
+		{ ".ttf", "font/ttf" },
+		{ ".wasm", "application/wasm" },
+	};
+
+	auto dot = path.rfind('.');
+	if (dot == path.npos)
+		return "application/octet-stream";
+
+	auto extension = path.substr(dot);
+	for (auto& [ext, type] : types)
+	{
+		if (std::ranges::equal(extension, ext, [](char a, char b) { return std::tolower((unsigned char)a) == b; }))
+			return type;
+	}
+	return "application/octet-stream";
+}
+
+void AssetCache::Add(const std::string& path, std::string&& content, std::filesystem::file_time_type modified)
+{
+	auto asset = std::make_shared<Asset>();
+	asset->contentType = GetContentType(path);
+	asset->etag = CreateEtag(content, "");
+	asset->modified = modified;
+
+	auto size = content.size();
+	if (size >= MinCompressSize && IsCompressible(asset->contentType))
+	{
+		auto gzip = Gzip(content);
+		if (!gzip.empty() && gzip.size() < size * 9 / 10)
+		{
+			asset->gzipEtag = CreateEtag(content, "-gz");
+			content += gzip;
+		}
+	}
+
+	// both variants share one allocation
+	asset->storage = std::move(content);
+	asset->content = std::string_view(asset->storage).substr(0, size);
+	asset->gzip = std::string_view(asset->storage).substr(size);
+
+	std::lock_guard lock(mutex);
+	assets[path] = std::move(asset);
+}
+
+static bool ReadFile(const std::filesystem::path& path, std::string& content)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return !file.bad();
+}
+
+void AssetCache::Load(const std::filesystem::path& root)
+{
+	this->root = root;
+	embedded = false;
+	{
+		std::lock_guard lock(mutex);
+		assets.clear();
+	}
+	Refresh();
+
+	size_t size = 0;
+	size_t compressed = 0;
+	for (auto& [path, asset] : assets)
+	{
+		size += asset->content.size();
+		compressed += asset->gzip.empty() ? asset->content.size() : asset->gzip.size();
+	}
+	Logger::Log("Asset cache: {} files, {} KB, {} KB compressed", assets.size(), size / 1024, compressed / 1024);
+}
+
+void AssetCache::Refresh()
+{
+	if (embedded)
+		return;
+
+	std::error_code ec;
+	std::vector<std::string> found;
+
+	for (std::filesystem::recursive_directory_iterator i(root, ec), end; !ec && i != end; i.increment(ec))
+	{
+		std::error_code fileError;
+		if (!i->is_regular_file(fileError))
+			continue;
+		auto size = i->file_size(fileError);
+		if (fileError || size > MaxAssetSize)
+			continue;
+
+		auto path = "/" + std::filesystem::relative(i->path(), root, fileError).generic_string();
+		auto modified = i->last_write_time(fileError);
+		if (fileError)
+			continue;
+		found.push_back(path);
+
+		// a copy within the timestamp resolution may keep the mtime
+		auto cached = assets.find(path);
+		if (cached != assets.end() && cached->second->modified == modified && cached->second->content.size() == size)
+			continue;
+
+		std::string content;
+		if (!ReadFile(i->path(), content))
+			continue;
+		Add(path, std::move(content), modified);
+	}
+
+	if (ec)
+		return;
+
+	// drop deleted files
+	std::sort(found.begin(), found.end());
+	std::lock_guard lock(mutex);
+	std::erase_if(assets, [&](auto& asset) { return !std::binary_search(found.begin(), found.end(), asset.first); });
+}
+
+#ifdef EMBED_ASSETS
+bool AssetCache::LoadEmbedded()
+{
+	// RCDATA resource from WebCast/EmbeddedAssets.rc, mapped with the image
+	auto module = GetModuleHandleW(nullptr);
+	auto resource = FindResourceW(module, L"EMBEDDED_ASSETS", RT_RCDATA);
+	auto handle = resource ? LoadResource(module, resource) : nullptr;
+	auto blob = handle ? static_cast<const char*>(LockResource(handle)) : nullptr;
+	if (!blob || SizeofResource(module, resource) < EmbeddedBlobSize)
+	{
+		Logger::LogError("Embedded assets resource is missing");
+		return false;
+	}
+
+	root.clear();
+	std::lock_guard lock(mutex);
+	assets.clear();
+	size_t compressed = 0;
+	for (auto& entry : EmbeddedAssets)
+	{
+		auto asset = std::make_shared<Asset>();
+		asset->contentType = GetContentType(entry.path);
+		asset->etag = entry.etag;
+		asset->gzipEtag = entry.gzipEtag;
+		asset->content = std::string_view(blob + entry.offset, entry.size);
+		if (entry.gzipSize)
+			asset->gzip = std::string_view(blob + entry.gzipOffset, entry.gzipSize);
+		assets[entry.path] = std::move(asset);
+		compressed += entry.gzipSize ? entry.gzipSize : entry.size;
+	}
+
+	embedded = true;
+	Logger::Log("Asset cache: {} embedded files, {} KB compressed", assets.size(), compressed / 1024);
+	return true;
+}
+#else
+bool AssetCache::LoadEmbedded()
+{
+	return false;
+}
+#endif
+
+std::shared_ptr<const AssetCache::Asset> AssetCache::Find(std::string_view target) const
+{
+	auto query = target.find_first_of("?#");
+	if (query != target.npos)
+		target = target.substr(0, query);
+
+	std::string path(target);
+	if (path.empty() || path.back() == '/')
+		path += "index.html";
+
+	std::lock_guard lock(mutex);
+	auto i = assets.find(path);
+	return i != assets.end() ? i->second : nullptr;
+}
+
+size_t AssetCache::GetCount() const
+{
+	std::lock_guard lock(mutex);
+	return assets.size();
+}
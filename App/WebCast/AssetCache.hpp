@@ -0,0 +1,60 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// In-memory copy of the static files served over HTTP, with a precompressed gzip variant,
+// strong ETags and Content-Type computed once at load. Refresh() reloads files whose mtime or size changed.
+// Builds with EMBED_ASSETS can instead serve the client bundle linked into the executable (LoadEmbedded).
+// Find may run on any thread; Load, Refresh and Add on one thread at a time.
+class AssetCache
+{
+public:
+	struct Asset
+	{
+		std::string contentType;
+		std::string etag; // quoted, identity encoding
+		std::string gzipEtag; // quoted, gzip encoding
+		std::string_view content; // into 'storage' or the embedded blob
+		std::string_view gzip; // empty when compression does not pay off
+		std::string storage;
+		std::filesystem::file_time_type modified;
+	};
+
+	// Entry of the generated index of the embedded bundle, see ux-js/scripts/embed-assets.mjs
+	struct EmbeddedAsset
+	{
+		const char* path;
+		size_t offset; // into the blob
+		size_t size;
+		size_t gzipOffset;
+		size_t gzipSize; // 0 when not compressed
+		const char* etag;
+		const char* gzipEtag;
+	};
+
+	void Load(const std::filesystem::path& root);
+	void Refresh();
+	// Serves the bundle linked into the executable, no file I/O. False when the build has none
+	bool LoadEmbedded();
+	bool IsEmbedded() const { return embedded; }
+
+	// 'target' is the request target, "/" and "/dir/" map to index.html; null when not cached
+	std::shared_ptr<const Asset> Find(std::string_view target) const;
+	size_t GetCount() const;
+
+	// Adds or replaces an asset under an url path ("/index.html")
+	void Add(const std::string& path, std::string&& content, std::filesystem::file_time_type modified);
+
+	static std::string_view GetContentType(std::string_view path);
+
+private:
+	std::filesystem::path root;
+	bool embedded = false;
+	mutable std::mutex mutex; // guards 'assets' against Find, the writer reads it without locking
+	std::unordered_map<std::string, std::shared_ptr<const Asset>> assets; // by url path
+};
@@ -0,0 +1,401 @@
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include "MsgReader.hpp"
+
+static constexpr int MaxDepth = 32;
+
+template <typename T>
+static T Load(const unsigned char* p)
+{
+	T value;
+	memcpy(&value, p, sizeof(T));
+	if constexpr (std::endian::native == std::endian::little && sizeof(T) > 1)
+		value = std::byteswap(value);
+	return value;
+}
+
+static double LoadFloat32(const unsigned char* p)
+{
+	return std::bit_cast<float>(Load<uint32_t>(p));
+}
+
+static double LoadFloat64(const unsigned char* p)
+{
+	return std::bit_cast<double>(Load<uint64_t>(p));
+}
+
+MsgReader::MsgReader(const char* data, size_t size) :
+	pos(reinterpret_cast<const unsigned char*>(data)),
+	end(reinterpret_cast<const unsigned char*>(data) + size)
+{
+}
+
+MsgReader::Type MsgReader::PeekType() const
+{
+	if (AtEnd())
+		return Type::None;
+
+	auto b = *pos;
+	if (b <= 0x7f || b >= 0xe0)
+		return Type::Integer;
+	if (b <= 0x8f)
+		return Type::Map;
+	if (b <= 0x9f)
+		return Type::Array;
+	if (b <= 0xbf)
+		return Type::String;
+
+	switch (b)
+	{
+		case 0xc0: return Type::Nil;
+		case 0xc2: case 0xc3: return Type::Boolean;
+		case 0xc4: case 0xc5: case 0xc6: return Type::Binary;
+		case 0xc7: case 0xc8: case 0xc9: return Type::Extension;
+		case 0xca: case 0xcb: return Type::Float;
+		case 0xd4: case 0xd5: case 0xd6: case 0xd7: case 0xd8: return Type::Extension;
+		case 0xd9: case 0xda: case 0xdb: return Type::String;
+		case 0xdc: case 0xdd: return Type::Array;
+		case 0xde: case 0xdf: return Type::Map;
+		default:
+			return b >= 0xcc && b <= 0xd3 ? Type::Integer : Type::None;
+	}
+}
+
+// Big endian length of 'bytes' bytes at pos + offset
+bool MsgReader::ReadLength(size_t bytes, size_t& value, size_t offset) const
+{
+	if ((size_t)(end - pos) < offset + bytes)
+		return false;
+
+	auto p = pos + offset;
+	switch (bytes)
+	{
+		case 1: value = *p; break;
+		case 2: value = Load<uint16_t>(p); break;
+		case 4: value = Load<uint32_t>(p); break;
+		default: return false;
+	}
+	return true;
+}
+
+bool MsgReader::ReadNil()
+{
+	if (AtEnd() || *pos != 0xc0)
+		return false;
+	++pos;
+	return true;
+}
+
+bool MsgReader::ReadBool(bool& value)
+{
+	if (AtEnd() || (*pos != 0xc2 && *pos != 0xc3))
+		return false;
+	value = *pos++ == 0xc3;
+	return true;
+}
+
+bool MsgReader::ReadInt(long long& value)
+{
+	if (AtEnd())
+		return false;
+
+	auto b = *pos;
+	if (b <= 0x7f || b >= 0xe0)
+	{
+		value = (int8_t)b;
+		++pos;
+		return true;
+	}
+
+	size_t size;
+	switch (b)
+	{
+		case 0xcc: case 0xd0: size = 1; break;
+		case 0xcd: case 0xd1: size = 2; break;
+		case 0xce: case 0xd2: size = 4; break;
+		case 0xcf: case 0xd3: size = 8; break;
+		default: return false;
+	}
+	if (Remaining() < 1 + size)
+		return false;
+
+	auto p = pos + 1;
+	switch (b)
+	{
+		case 0xcc: value = *p; break;
+		case 0xcd: value = Load<uint16_t>(p); break;
+		case 0xce: value = Load<uint32_t>(p); break;
+		case 0xcf:
+		{
+			auto u = Load<uint64_t>(p);
+			if (u > (uint64_t)INT64_MAX)
+				return false;
+			value = (long long)u;
+			break;
+		}
+		case 0xd0: value = (int8_t)*p; break;
+		case 0xd1: value = Load<int16_t>(p); break;
+		case 0xd2: value = Load<int32_t>(p); break;
+		case 0xd3: value = Load<int64_t>(p); break;
+	}
+	pos += 1 + size;
+	return true;
+}
+
+bool MsgReader::ReadUInt(unsigned long long& value)
+{
+	if (!AtEnd() && *pos == 0xcf)
+	{
+		if (Remaining() < 9)
+			return false;
+		value = Load<uint64_t>(pos + 1);
+		pos += 9;
+		return true;
+	}
+
+	auto start = pos;
+	long long v;
+	if (!ReadInt(v))
+		return false;
+	if (v < 0)
+	{
+		pos = start;
+		return false;
+	}
+	value = (unsigned long long)v;
+	return true;
+}
+
+bool MsgReader::ReadNumber(double& value)
+{
+	if (AtEnd())
+		return false;
+
+	double v;
+	if (*pos == 0xca && Remaining() >= 5)
+		v = LoadFloat32(pos + 1);
+	else if (*pos == 0xcb && Remaining() >= 9)
+		v = LoadFloat64(pos + 1);
+	else
+	{
+		long long i;
+		unsigned long long u;
+		if (ReadInt(i))
+			value = (double)i;
+		else if (ReadUInt(u))
+			value = (double)u;
+		else
+			return false;
+		return true;
+	}
+
+	if (!std::isfinite(v))
+		return false;
+	pos += *pos == 0xca ? 5 : 9;
+	value = v;
+	return true;
+}
+
+bool MsgReader::ReadString(std::string_view& value)
+{
+	if (AtEnd())
+		return false;
+
+	auto b = *pos;
+	size_t header;
+	size_t size;
+	if (b >= 0xa0 && b <= 0xbf)
+	{
+		header = 1;
+		size = b & 0x1f;
+	}
+	else
+	{
+		auto bytes = b == 0xd9 ? 1 : b == 0xda ? 2 : b == 0xdb ? 4 : 0;
+		if (!bytes || !ReadLength(bytes, size))
+			return false;
+		header = 1 + bytes;
+	}
+
+	if (Remaining() < header || Remaining() - header < size)
+		return false;
+	value = std::string_view(reinterpret_cast<const char*>(pos + header), size);
+	pos += header + size;
+	return true;
+}
+
+bool MsgReader::ReadBinary(std::string_view& value)
+{
+	if (AtEnd())
+		return false;
+
+	auto b = *pos;
+	auto bytes = b == 0xc4 ? 1 : b == 0xc5 ? 2 : b == 0xc6 ? 4 : 0;
+	size_t size;
+	if (!bytes || !ReadLength(bytes, size))
+		return false;
+	if (Remaining() - 1 - bytes < size)
+		return false;
+
+	value = std::string_view(reinterpret_cast<const char*>(pos + 1 + bytes), size);
+	pos += 1 + bytes + size;
+	return true;
+}
+
+bool MsgReader::ReadArray(uint32_t& count)
+{
+	if (AtEnd())
+		return false;
+
+	auto b = *pos;
+	if (b >= 0x90 && b <= 0x9f)
+	{
+		count = b & 0x0f;
+		++pos;
+		return true;
+	}
+
+	auto bytes = b == 0xdc ? 2 : b == 0xdd ? 4 : 0;
+	size_t size;
+	if (!bytes || !ReadLength(bytes, size))
+		return false;
+	count = (uint32_t)size;
+	pos += 1 + bytes;
+	return true;
+}
+
+bool MsgReader::ReadMap(uint32_t& count)
+{
+	if (AtEnd())
+		return false;
+
+	auto b = *pos;
+	if (b >= 0x80 && b <= 0x8f)
+	{
+		count = b & 0x0f;
+		++pos;
+		return true;
+	}
+
+	auto bytes = b == 0xde ? 2 : b == 0xdf ? 4 : 0;
+	size_t size;
+	if (!bytes || !ReadLength(bytes, size))
+		return false;
+	count = (uint32_t)size;
+	pos += 1 + bytes;
+	return true;
+}
+
+bool MsgReader::ReadKey(int& key)
+{
+	long long value;
+	std::string_view str;
+	auto start = pos;
+
+	if (ReadInt(value))
+	{
+		if (value >= 0 && value <= INT32_MAX)
+		{
+			key = (int)value;
+			return true;
+		}
+	}
+	else if (ReadString(str))
+	{
+		auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), key);
+		if (ec == std::errc() && ptr == str.data() + str.size() && key >= 0)
+			return true;
+	}
+
+	pos = start;
+	return false;
+}
+
+bool MsgReader::Skip()
+{
+	return SkipDepth(0);
+}
+
+bool MsgReader::SkipDepth(int depth)
+{
+	if (depth > MaxDepth)
+		return false;
+
+	auto start = pos;
+	uint32_t count;
+	std::string_view data;
+	long long i;
+	unsigned long long u;
+	bool b;
+
+	switch (PeekType())
+	{
+		case Type::Nil:
+			return ReadNil();
+		case Type::Boolean:
+			return ReadBool(b);
+		case Type::Integer:
+			return ReadInt(i) || ReadUInt(u);
+		case Type::Float:
+			if (Remaining() < (*pos == 0xca ? 5u : 9u))
+				return false;
+			pos += *pos == 0xca ? 5 : 9;
+			return true;
+		case Type::String:
+			return ReadString(data);
+		case Type::Binary:
+			return ReadBinary(data);
+		case Type::Array:
+			if (!ReadArray(count))
+				return false;
+			for (uint32_t n = 0; n < count; ++n)
+			{
+				if (!SkipDepth(depth + 1))
+				{
+					pos = start;
+					return false;
+				}
+			}
+			return true;
+		case Type::Map:
+			if (!ReadMap(count))
+				return false;
+			for (uint32_t n = 0; n < count * 2ull; ++n)
+			{
+				if (!SkipDepth(depth + 1))
+				{
+					pos = start;
+					return false;
+				}
+			}
+			return true;
+		case Type::Extension:
+		{
+			size_t size;
+			size_t header;
+			switch (*pos)
+			{
+				case 0xd4: size = 1; header = 2; break;
+				case 0xd5: size = 2; header = 2; break;
+				case 0xd6: size = 4; header = 2; break;
+				case 0xd7: size = 8; header = 2; break;
+				case 0xd8: size = 16; header = 2; break;
+				default:
+				{
+					auto bytes = *pos == 0xc7 ? 1 : *pos == 0xc8 ? 2 : 4;
+					if (!ReadLength(bytes, size))
+						return false;
+					header = 2 + bytes;
+				}
+			}
+			if (Remaining() < header || Remaining() - header < size)
+				return false;
+			pos += header + size;
+			return true;
+		}
+		default:
+			return false;
+	}
+}
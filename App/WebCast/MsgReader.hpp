@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include "Utils/FixedArray.h"
+
+// Forward-only msgpack cursor over a borrowed buffer, allocation free.
+// Read* functions consume one value and return true, or leave the cursor untouched and return false
+// when the next value has a different type or is truncated.
+class MsgReader
+{
+public:
+	enum class Type
+	{
+		None, // end of buffer or malformed data
+		Nil,
+		Boolean,
+		Integer,
+		Float,
+		String,
+		Binary,
+		Array,
+		Map,
+		Extension,
+	};
+
+	MsgReader(const char* data, size_t size);
+	explicit MsgReader(const FixedArrayCharS& buffer) : MsgReader(buffer, buffer.size())
+	{
+	}
+
+	bool AtEnd() const { return pos >= end; }
+	size_t Remaining() const { return end - pos; }
+	Type PeekType() const;
+
+	bool ReadNil();
+	bool ReadBool(bool& value);
+	bool ReadInt(long long& value);
+	bool ReadUInt(unsigned long long& value);
+	bool ReadNumber(double& value); // any integer or float, rejects NaN/inf
+	bool ReadString(std::string_view& value);
+	bool ReadBinary(std::string_view& value);
+	bool ReadArray(uint32_t& count);
+	bool ReadMap(uint32_t& count);
+	bool Skip(); // next value including nested containers
+
+	// Map key as an integer; numeric string keys ("0") are accepted since JS clients send them
+	bool ReadKey(int& key);
+
+	// Reads a map, calling f(key, reader) for each entry. f reads the value with this reader;
+	// values it leaves unread are skipped. Entries with non-integer keys are skipped.
+	template <typename F>
+	bool ForEachField(F&& f)
+	{
+		uint32_t count;
+		if (!ReadMap(count))
+			return false;
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			int key;
+			if (!ReadKey(key))
+			{
+				if (!Skip())
+					return false;
+			}
+			else
+			{
+				auto start = pos;
+				f(key, *this);
+				if (pos != start)
+					continue;
+			}
+			if (!Skip())
+				return false;
+		}
+		return true;
+	}
+
+private:
+	const unsigned char* pos;
+	const unsigned char* end;
+
+	bool ReadLength(size_t bytes, size_t& value, size_t offset = 1) const;
+	bool SkipDepth(int depth);
+};
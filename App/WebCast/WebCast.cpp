@@ -1,13 +1,22 @@
 #include <filesystem>
 #include "WebCast.hpp"
 #include "HttpServer/HttpMessage.hpp"
-#include "MsgPacker.hpp"
+#include "App/NetworkPool.h"
 #include "App/RealTimeThread.h"
 #include "Utils/Logger.h"
+#include "Utils/Metrics.h"
+#include "Utils/Profiler.h"
+#include "Utils/Trace.h"
 
 extern RealTimeThread thread;
+extern NetworkPool network;
+extern Profiler profiler;
 
-WebCast::WebCast()
+static constexpr size_t JournalSize = 16384;
+
+static auto& ClientsConnected = Metrics::AddGauge("webcast_clients", "Connected WebSocket clients");
+
+WebCast::WebCast() : journal(JournalSize), journalSeq(0), nextClientId(1)
 {
 }
 
@@ -35,9 +44,37 @@ void WebCast::Start()
 		};
 
 	wss.onOpen = std::bind(&WebCast::OnWebsocketOpen, this, _1);
+	RegisterMetrics();
+
+	if (!assets.LoadEmbedded())
+	{
+		assets.Load(std::filesystem::current_path() / "html");
+		network.Dispatch(RefreshAssets());
+	}
 
+	// sockets and their callbacks stay with the tick thread, HTTP and WebSocket I/O run on the network pool
+	wss.SetOwner(thread.GetExecutor());
 	thread.Dispatch(wss.Run());
-	thread.Dispatch(server.Run(std::move(endpoint)));
+	network.Dispatch(server.Run(std::move(endpoint), network.GetThreadCount()));
+}
+
+// Connection counters the servers already keep, read on scrape
+void WebCast::RegisterMetrics()
+{
+	Metrics::AddCounterCallback("http_connections_accepted_total", "Accepted HTTP connections", [this]() { return (double)server.GetStats().accepted; });
+	Metrics::AddCounterCallback("http_connections_rejected_total", "HTTP connections closed right away, over the connection limit", [this]() { return (double)server.GetStats().rejected; });
+	Metrics::AddCounterCallback("http_connections_timed_out_total", "HTTP connections closed by a read or write deadline", [this]() { return (double)server.GetStats().timedOut; });
+	Metrics::AddGaugeCallback("http_connections_active", "Open HTTP connections, including ones being upgraded", [this]() { return (double)server.GetStats().active; });
+	Metrics::AddGaugeCallback("websocket_open", "Open WebSocket connections", [this]() { return (double)wss.GetStats().open; });
+	Metrics::AddCounterCallback("websocket_rejected_total", "WebSocket upgrades answered with 503, over the socket limit", [this]() { return (double)wss.GetStats().rejected; });
+}
+
+void WebCast::LogNetworkStats() const
+{
+	auto httpStats = server.GetStats();
+	auto wssStats = wss.GetStats();
+	Logger::Log("HTTP: {} active, {} accepted, {} rejected, {} timed out", httpStats.active, httpStats.accepted, httpStats.rejected, httpStats.timedOut);
+	Logger::Log("WSS: {} open, {} rejected", wssStats.open, wssStats.rejected);
 }
 
 static void LogHttpResponse(const HttpConnection& connection, int status)
@@ -51,12 +88,201 @@ static void LogHttpResponse(const HttpConnection& connection, int status)
 
 boost::asio::awaitable<void> WebCast::ProcessRequest(HttpConnection& connection)
 {
-	if (co_await ProcessGetFile(connection))
+	if (co_await ProcessGetMetrics(connection))
+		co_return;
+	if (co_await ProcessGetStats(connection))
+		co_return;
+	if (co_await ProcessGetTrace(connection))
+		co_return;
+	if (co_await ProcessGetAsset(connection))
+		co_return;
+	// the embedded bundle is complete, nothing is read from disk
+	if (!assets.IsEmbedded() && co_await ProcessGetFile(connection))
 		co_return;
 	LogHttpResponse(connection, 404);
 	co_await server.RespondNotFound(connection);
 }
 
+boost::asio::awaitable<void> WebCast::RefreshAssets()
+{
+	using namespace std::chrono_literals;
+	auto ctx = co_await boost::asio::this_coro::executor;
+
+	boost::asio::steady_timer timer(ctx);
+	while (true)
+	{
+		timer.expires_after(2s);
+		co_await timer.async_wait(boost::asio::use_awaitable);
+		assets.Refresh();
+	}
+}
+
+static std::string_view Trim(std::string_view str)
+{
+	auto begin = str.find_first_not_of(" \t");
+	if (begin == str.npos)
+		return {};
+	return str.substr(begin, str.find_last_not_of(" \t") - begin + 1);
+}
+
+// Accept-Encoding lists gzip (or *) without q=0
+static bool AcceptsGzip(std::string_view header)
+{
+	while (!header.empty())
+	{
+		auto comma = header.find(',');
+		auto item = header.substr(0, comma);
+		header = comma == header.npos ? std::string_view() : header.substr(comma + 1);
+
+		auto semicolon = item.find(';');
+		auto coding = Trim(item.substr(0, semicolon));
+		if (coding != "gzip" && coding != "*")
+			continue;
+		if (semicolon == item.npos)
+			return true;
+
+		auto params = item.substr(semicolon + 1);
+		auto q = params.find("q=");
+		return q == params.npos || Trim(params.substr(q + 2)).find_first_not_of("0.") != std::string_view::npos;
+	}
+	return false;
+}
+
+static bool MatchesEtag(std::string_view header, std::string_view etag)
+{
+	while (!header.empty())
+	{
+		auto comma = header.find(',');
+		auto tag = Trim(header.substr(0, comma));
+		header = comma == header.npos ? std::string_view() : header.substr(comma + 1);
+
+		if (tag.starts_with("W/"))
+			tag.remove_prefix(2);
+		if (tag == etag || tag == "*")
+			return true;
+	}
+	return false;
+}
+
+boost::asio::awaitable<bool> WebCast::ProcessGetAsset(HttpConnection& connection)
+{
+	auto method = connection.request.method();
+	if (method != http::verb::get && method != http::verb::head)
+		co_return false;
+
+	auto target = connection.request.target();
+	auto asset = assets.Find(std::string_view(target.data(), target.size()));
+	if (!asset)
+		co_return false;
+
+	auto acceptEncoding = connection.request[http::field::accept_encoding];
+	bool gzip = !asset->gzip.empty() && AcceptsGzip(std::string_view(acceptEncoding.data(), acceptEncoding.size()));
+	auto& etag = gzip ? asset->gzipEtag : asset->etag;
+	auto& body = gzip ? asset->gzip : asset->content;
+
+	auto setHeaders = [&](auto& response)
+		{
+			response.set(http::field::etag, etag);
+			response.set(http::field::cache_control, "no-cache");
+			if (!asset->gzip.empty())
+				response.set(http::field::vary, "Accept-Encoding");
+		};
+
+	auto ifNoneMatch = connection.request[http::field::if_none_match];
+	if (MatchesEtag(std::string_view(ifNoneMatch.data(), ifNoneMatch.size()), etag))
+	{
+		LogHttpResponse(connection, 304);
+		auto response = HttpMessage::Create<http::empty_body>(connection.request, http::status::not_modified);
+		setHeaders(response);
+		co_await connection.Write(std::move(response));
+		co_return true;
+	}
+
+	LogHttpResponse(connection, 200);
+	if (method == http::verb::head)
+	{
+		auto response = HttpMessage::Create<http::empty_body>(connection.request, http::status::ok);
+		setHeaders(response);
+		response.set(http::field::content_type, asset->contentType);
+		if (gzip)
+			response.set(http::field::content_encoding, "gzip");
+		response.content_length(body.size());
+		co_await connection.Write(std::move(response));
+	}
+	else
+	{
+		// body points into the cached asset, kept alive by 'asset' until written
+		auto response = HttpMessage::Create<http::span_body<const char>>(connection.request, http::status::ok);
+		setHeaders(response);
+		response.set(http::field::content_type, asset->contentType);
+		if (gzip)
+			response.set(http::field::content_encoding, "gzip");
+		response.body() = { body.data(), body.size() };
+		response.content_length(body.size());
+		co_await connection.Write(std::move(response));
+	}
+
+	co_return true;
+}
+
+// Prometheus scrape, see Utils/Metrics.h
+boost::asio::awaitable<bool> WebCast::ProcessGetMetrics(HttpConnection& connection)
+{
+	if (connection.request.method() != http::verb::get || connection.request.target() != "/metrics")
+		co_return false;
+
+	// not logged, scrapers ask every few seconds
+	auto response = HttpMessage::Create<http::string_body>(connection.request, http::status::ok);
+	response.set(http::field::content_type, Metrics::ContentType);
+	response.set(http::field::cache_control, "no-store");
+	response.body() = Metrics::Format();
+	response.prepare_payload();
+	co_await connection.Write(std::move(response));
+	co_return true;
+}
+
+// Tick phase profile as JSON, see Profiler::ToJson
+boost::asio::awaitable<bool> WebCast::ProcessGetStats(HttpConnection& connection)
+{
+	if (connection.request.method() != http::verb::get || connection.request.target() != "/stats")
+		co_return false;
+
+	LogHttpResponse(connection, 200);
+	auto response = HttpMessage::Create<http::string_body>(connection.request, http::status::ok);
+	response.set(http::field::content_type, "application/json");
+	response.set(http::field::cache_control, "no-store");
+	response.body() = profiler.ToJson();
+	response.prepare_payload();
+	co_await connection.Write(std::move(response));
+	co_return true;
+}
+
+// Last captured trace, see Trace::Stop
+boost::asio::awaitable<bool> WebCast::ProcessGetTrace(HttpConnection& connection)
+{
+	if (connection.request.method() != http::verb::get || connection.request.target() != "/trace")
+		co_return false;
+
+	auto trace = Trace::GetLast();
+	if (!trace)
+	{
+		LogHttpResponse(connection, 404);
+		co_await server.RespondNotFound(connection);
+		co_return true;
+	}
+
+	// body points into the trace, kept alive by 'trace' until written
+	LogHttpResponse(connection, 200);
+	auto response = HttpMessage::Create<http::span_body<const char>>(connection.request, http::status::ok);
+	response.set(http::field::content_type, "application/json");
+	response.set(http::field::content_disposition, "attachment; filename=\"trace.json\"");
+	response.set(http::field::cache_control, "no-store");
+	response.body() = { trace->data(), trace->size() };
+	response.content_length(trace->size());
+	co_await connection.Write(std::move(response));
+	co_return true;
+}
+
 boost::asio::awaitable<bool> WebCast::ProcessGetFile(HttpConnection& connection)
 {
 	auto method = connection.request.method();
@@ -94,6 +320,20 @@ boost::asio::awaitable<bool> WebCast::ProcessGetFile(HttpConnection& connection)
 		response.content_length(file.size());
 		co_await connection.Write(std::move(response));
 	}
+#ifdef __linux__
+	else
+	{
+		// header from here, body from the sender thread
+		auto size = file.size();
+		auto response = HttpMessage::Create<http::empty_body>(connection.request, http::status::ok);
+		response.content_length(size);
+		co_await connection.Write(std::move(response));
+
+		ec = co_await files.Send(connection.socket, file.file().native_handle(), 0, size, connection.writeTimeout);
+		if (ec)
+			throw boost::system::system_error(ec); // the body is cut short, the connection can not be reused
+	}
+#else
 	else
 	{
 		auto size = file.size();
@@ -108,6 +348,7 @@ boost::asio::awaitable<bool> WebCast::ProcessGetFile(HttpConnection& connection)
 		response.content_length(size);
 		co_await connection.Write(std::move(response));
 	}
+#endif
 
 	co_return true;
 }
@@ -117,58 +358,131 @@ void WebCast::OnWebsocketOpen(WebSocket& ws)
 	auto ep = ws.GetEndpoint();
 	Logger::Log("WSS: {}:{} connected", ep.address().to_string(), ep.port());
 
-	ws.onReceive = [this](auto& ws, const auto& message)
+	auto& client = clients.emplace_back();
+	client.id = nextClientId++;
+	client.ws = &ws;
+	client.features = 0;
+	ClientsConnected.Set((int64_t)clients.size());
+
+	ws.onReceive = [this, &client](auto& ws, const auto& message)
 		{
 			if (message.isText)
 				return;
 			auto buffer = message.Binary();
 
-			size_t offset = 0;
-			auto handle = msgpack::unpack(buffer, buffer.size(), offset);
-			auto& obj = handle.get();
-			if (obj.type != msgpack::type::POSITIVE_INTEGER)
+			MsgReader reader(buffer);
+			unsigned long long type;
+			if (!reader.ReadUInt(type))
 				return;
 
-			auto type = obj.as<uint8_t>();
-
-			auto i = callbacks.find(static_cast<MsgId>(type));
-			if (i == callbacks.end())
+			if (type >= callbacks.size() || !callbacks[type])
 			{
-				auto ep = ws.GetEndpoint();
 				Logger::LogWarn("WSS: Message {} has been discarded", type);
 				return;
 			}
 
-			if (offset >= buffer.size())
-				i->second({});
-			else
-				i->second(FixedArrayCharS::CreateArrayRef(buffer + offset, buffer.size() - offset));
+			callbacks[type](client, reader);
 		};
-	ws.onClose = [](auto& ws)
+	ws.onClose = [this](auto& ws)
 		{
 			auto& ep = ws.GetEndpoint();
 			Logger::Log("WSS: {}:{} disconnected", ep.address().to_string(), ep.port());
+
+			for (auto i = clients.begin(); i != clients.end(); ++i)
+			{
+				if (i->ws == &ws)
+				{
+					if (onClientClose)
+						onClientClose(*i);
+					clients.erase(i);
+					ClientsConnected.Set((int64_t)clients.size());
+					break;
+				}
+			}
 		};
+
+	if (onClientOpen)
+		onClientOpen(client);
 }
 
 void WebCast::RegisterHandler(MsgId id, const Callback& callback)
 {
-	callbacks[id] = callback;
+	callbacks[static_cast<size_t>(id)] = callback;
+}
+
+// Frame is the msgpack message id followed by the payload; ids are positive fixints, so the id is one byte.
+// It is encoded once and shared by every recipient's send queue.
+SharedBuffer WebCast::CreateFrame(MsgId id, const FixedArrayCharS& buffer)
+{
+	static_assert(sizeof(MsgId) == 1);
+	auto type = static_cast<char>(id);
+	return SharedBuffer::Copy({ std::string_view(&type, 1), std::string_view(buffer, buffer.size()) });
 }
 
-void WebCast::Send(MsgId id, const FixedArrayCharS& buffer)
+void WebCast::Send(MsgId id, const FixedArrayCharS& buffer, unsigned long long conflationKey)
 {
-	if (wss.wss.empty())
+	ProfileScope scope(profiler, ProfilePhase::WebCastSend);
+	if (clients.empty())
 		return;
 
-	MsgPacker packer;
-	packer.pack(static_cast<uint8_t>(id));
-	if (!buffer.empty())
-		packer.write_raw(buffer);
-	auto data = packer.view();
+	auto frame = CreateFrame(id, buffer);
+	for (auto& client : clients)
+	{
+		client.ws->Send(frame, conflationKey);
+	}
+}
+
+void WebCast::Send(MsgId id, const FixedArrayCharS& buffer, const std::function<bool(WebClient& client)>& filter, unsigned long long conflationKey)
+{
+	ProfileScope scope(profiler, ProfilePhase::WebCastSend);
+	SharedBuffer frame;
+	for (auto& client : clients)
+	{
+		if (!filter(client))
+			continue;
+		if (frame.empty())
+			frame = CreateFrame(id, buffer);
+		client.ws->Send(frame, conflationKey);
+	}
+}
+
+void WebCast::Send(WebClient& client, MsgId id, const FixedArrayCharS& buffer, unsigned long long conflationKey)
+{
+	ProfileScope scope(profiler, ProfilePhase::WebCastSend);
+	client.ws->Send(CreateFrame(id, buffer), conflationKey);
+}
+
+void WebCast::Send(WebClient& client, const SharedBuffer& frame)
+{
+	ProfileScope scope(profiler, ProfilePhase::WebCastSend);
+	client.ws->Send(frame);
+}
+
+void WebCast::Publish(MsgId id, const FixedArrayCharS& buffer, const std::function<bool(WebClient& client)>& filter, unsigned long long conflationKey)
+{
+	ProfileScope scope(profiler, ProfilePhase::WebCastSend);
+	auto frame = CreateFrame(id, buffer);
+	for (auto& client : clients)
+	{
+		if (!filter || filter(client))
+			client.ws->Send(frame, conflationKey);
+	}
+
+	++journalSeq;
+	journal[journalSeq % journal.size()] = { std::move(frame), conflationKey };
+}
+
+bool WebCast::Replay(WebClient& client, unsigned long long seq)
+{
+	if (seq > journalSeq || journalSeq - seq > journal.size())
+		return false;
 
-	for (auto i = wss.wss.begin(); i != wss.wss.end(); ++i)
+	ProfileScope scope(profiler, ProfilePhase::WebCastSend);
+	// updates of one aircraft between adds/removes collapse in the send queue
+	for (auto i = seq + 1; i <= journalSeq; ++i)
 	{
-		i->Send(data);
+		auto& entry = journal[i % journal.size()];
+		client.ws->Send(entry.frame, entry.conflationKey);
 	}
+	return true;
 }
@@ -1,10 +1,16 @@
 #pragma once
-#include <map>
+#include <array>
+#include <list>
+#include <vector>
 #include "Utils/Boost.h"
 #include <boost/asio.hpp>
+#include "HttpServer/FileSender.hpp"
 #include "HttpServer/HttpServer.hpp"
 #include "HttpServer/WebSocketServer.hpp"
 #include "Utils/FixedArray.h"
+#include "Utils/SharedBuffer.h"
+#include "AssetCache.hpp"
+#include "MsgReader.hpp"
 
 enum class MsgId : uint8_t
 {
@@ -17,6 +23,23 @@ enum class MsgId : uint8_t
 	LocalAddAircraft = 7,
 	LocalRemoveAircraft = 8,
 	LocalUpdateAircraft = 9,
+	RadarPredictAircraft = 10,
+	SubscribeViewport = 11,
+	RadarUpdateBatch = 12,
+	ModifyClientFeatures = 13,
+	RadarUpdateCompact = 14,
+	ResyncSince = 15,
+	JournalSeq = 16,
+	SnapshotChunk = 17,
+	SnapshotEnd = 18,
+	TraceCapture = 19,
+};
+
+struct WebClient
+{
+	unsigned int id;
+	WebSocket* ws;
+	unsigned int features; // negotiated through ModifyClientFeatures
 };
 
 class WebCast
@@ -27,17 +50,62 @@ public:
 
 	void Start();
 
-	typedef std::function<void(const FixedArrayCharS& buffer)> Callback;
+	// reader is positioned at the message body, which may be empty
+	typedef std::function<void(WebClient& client, MsgReader& reader)> Callback;
 
 	void RegisterHandler(MsgId id, const Callback& callback);
-	void Send(MsgId id, const FixedArrayCharS& buffer = {});
+	// conflationKey - non-zero for state that a later message fully replaces, see WebSocket::Send and ConflationKey
+	void Send(MsgId id, const FixedArrayCharS& buffer = {}, unsigned long long conflationKey = 0);
+	void Send(WebClient& client, MsgId id, const FixedArrayCharS& buffer = {}, unsigned long long conflationKey = 0);
+	void Send(WebClient& client, const SharedBuffer& frame); // frame made by CreateFrame
+	void Send(MsgId id, const FixedArrayCharS& buffer, const std::function<bool(WebClient& client)>& filter, unsigned long long conflationKey = 0);
+	std::list<WebClient>& GetClients() { return clients; }
+	// Connection counters of the HTTP and WebSocket servers, to the console
+	void LogNetworkStats() const;
+
+	// Like Send, and also records the frame in the change journal. Used for the full-stream state changes
+	// (adds, removes, updates, system state) so a reconnecting client can replay what it missed.
+	void Publish(MsgId id, const FixedArrayCharS& buffer = {}, const std::function<bool(WebClient& client)>& filter = {}, unsigned long long conflationKey = 0);
+	unsigned long long GetJournalSeq() const { return journalSeq; }
+	// Sends the frames journaled after 'seq' to the client; false when they are not all in the journal anymore
+	bool Replay(WebClient& client, unsigned long long seq);
+
+	// Message id followed by the payload, ready to be shared by many sends. Thread safe.
+	static SharedBuffer CreateFrame(MsgId id, const FixedArrayCharS& buffer);
+
+	// Key of a message about one subject (e.g. aircraft id), queued copies of it collapse to the latest
+	static unsigned long long ConflationKey(MsgId id, unsigned int subject = 0)
+	{
+		return (unsigned long long)id << 32 | subject;
+	}
+
+	std::function<void(WebClient& client)> onClientOpen;
+	std::function<void(WebClient& client)> onClientClose;
 
 private:
 	boost::asio::awaitable<void> ProcessRequest(HttpConnection& connection);
+	boost::asio::awaitable<bool> ProcessGetAsset(HttpConnection& connection);
+	boost::asio::awaitable<bool> ProcessGetMetrics(HttpConnection& connection);
+	boost::asio::awaitable<bool> ProcessGetStats(HttpConnection& connection);
+	boost::asio::awaitable<bool> ProcessGetTrace(HttpConnection& connection);
 	boost::asio::awaitable<bool> ProcessGetFile(HttpConnection& connection);
+	boost::asio::awaitable<void> RefreshAssets();
 	void OnWebsocketOpen(WebSocket& ws);
+	void RegisterMetrics();
 	
 	HttpServer server;
+	AssetCache assets;
+	FileSender files; // bodies of files not in the asset cache
 	WebSocketServer wss;
-	std::map<MsgId, Callback> callbacks;
+	std::array<Callback, 256> callbacks; // by MsgId
+
+	struct JournalEntry
+	{
+		SharedBuffer frame;
+		unsigned long long conflationKey;
+	};
+	std::vector<JournalEntry> journal; // ring buffer, entry of sequence number n at n % size
+	unsigned long long journalSeq; // last recorded, 0 - nothing yet
+	std::list<WebClient> clients;
+	unsigned int nextClientId;
 };
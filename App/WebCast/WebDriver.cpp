@@ -1,13 +1,24 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <thread>
 #include "WebDriver.hpp"
 #include "WebCast.hpp"
+#include "App/RealTimeThread.h"
 #include "SimCom/SimCom.h"
 #include "Utils/Logger.h"
+#include "Utils/Profiler.h"
+#include "Utils/Trace.h"
 #include "MsgPacker.hpp"
 
 extern SimCom simcom;
 extern LocalAircraft aircraft;
 extern AirplaneRadar radar;
 extern WebCast webcast;
+extern RealTimeThread thread;
+extern Profiler profiler;
+
+static constexpr size_t SnapshotChunkSize = 256; // aircraft per SnapshotChunk
 
 enum class SimState : uint8_t
 {
@@ -15,7 +26,7 @@ enum class SimState : uint8_t
 	Connected = 2,
 };
 
-WebDriver::WebDriver()
+WebDriver::WebDriver() : batchClients(0), announcedSeq(0), nextSnapshotId(1)
 {
 }
 
@@ -51,7 +62,7 @@ static void SendSystemState(int simConnected)
 {
 	MsgPacker packer;
 	SetSystemState(packer, simConnected);
-	webcast.Send(MsgId::ModifySystemState, packer.view());
+	webcast.Publish(MsgId::ModifySystemState, packer.view());
 }
 
 static void SendSystemState()
@@ -63,13 +74,21 @@ void WebDriver::Initialize()
 {
 	using namespace std::placeholders;
 
-	webcast.RegisterHandler(MsgId::SendAllData, std::bind(&WebDriver::OnRequestSendAllData, this, _1));
-	webcast.RegisterHandler(MsgId::ModifySystemState, std::bind(&WebDriver::OnRequestModifySystemState, this, _1));
-	webcast.RegisterHandler(MsgId::ModifySystemProperties, std::bind(&WebDriver::OnRequestModifySystemProperties, this, _1));
+	encoders = std::make_unique<boost::asio::thread_pool>(std::clamp(std::thread::hardware_concurrency() / 2, 1u, 4u));
+
+	webcast.RegisterHandler(MsgId::SendAllData, std::bind(&WebDriver::OnRequestSendAllData, this, _1, _2));
+	webcast.RegisterHandler(MsgId::ModifySystemState, std::bind(&WebDriver::OnRequestModifySystemState, this, _1, _2));
+	webcast.RegisterHandler(MsgId::ModifySystemProperties, std::bind(&WebDriver::OnRequestModifySystemProperties, this, _1, _2));
+	webcast.RegisterHandler(MsgId::SubscribeViewport, std::bind(&WebDriver::OnRequestSubscribeViewport, this, _1, _2));
+	webcast.RegisterHandler(MsgId::ModifyClientFeatures, std::bind(&WebDriver::OnRequestModifyClientFeatures, this, _1, _2));
+	webcast.RegisterHandler(MsgId::ResyncSince, std::bind(&WebDriver::OnRequestResyncSince, this, _1, _2));
+	webcast.RegisterHandler(MsgId::TraceCapture, std::bind(&WebDriver::OnRequestTraceCapture, this, _1, _2));
+	webcast.onClientClose = std::bind(&WebDriver::OnClientClose, this, _1);
 
 	radar.OnPlaneAdd = { MemberFunc<&WebDriver::OnRadarAdd>, this };
 	radar.OnPlaneRemove = { MemberFunc<&WebDriver::OnRadarRemove>, this };
 	radar.OnPlaneUpdate = { MemberFunc<&WebDriver::OnRadarUpdate>, this };
+	radar.OnPlanePredict = { MemberFunc<&WebDriver::OnRadarPredict>, this };
 
 	aircraft.OnAdd = { MemberFunc<&WebDriver::OnUserAdd>, this };
 	aircraft.OnRemove = { MemberFunc<&WebDriver::OnUserRemove>, this };
@@ -101,6 +120,55 @@ static void PackRadarUpdate(MsgPacker& packer, const AirplaneRadar::PlaneUpdateA
 	PackPartialRadarUpdate(packer, e);
 }
 
+// RadarUpdateCompact record, little endian: it is copied to the buffer byte for byte in host order
+static_assert(std::endian::native == std::endian::little);
+#pragma pack(push, 1)
+struct CompactUpdate
+{
+	uint32_t id;
+	int32_t longitude; // 1e-6 degree
+	int32_t latitude; // 1e-6 degree
+	uint16_t heading; // 0.01 degree, 0 - 35999
+	int16_t altitude; // 10 ft
+	int16_t groundAltitude; // 10 ft
+	uint16_t groundSpeed; // knots
+};
+#pragma pack(pop)
+static_assert(sizeof(CompactUpdate) == 20);
+
+static void PackCompactUpdate(MsgPacker& packer, const AirplaneRadar::PlaneUpdateArgs& e)
+{
+	auto heading = std::lround(e.heading * 100) % 36000;
+
+	CompactUpdate record;
+	record.id = e.id;
+	record.longitude = (int32_t)std::lround(e.longitude * 1e6);
+	record.latitude = (int32_t)std::lround(e.latitude * 1e6);
+	record.heading = (uint16_t)(heading < 0 ? heading + 36000 : heading);
+	record.altitude = (int16_t)std::clamp<long>(std::lround(e.altitude / 10.0), INT16_MIN, INT16_MAX);
+	record.groundAltitude = (int16_t)std::clamp<long>(std::lround(e.groundAltitude / 10.0), INT16_MIN, INT16_MAX);
+	record.groundSpeed = (uint16_t)std::clamp(e.groundSpeed, 0, UINT16_MAX);
+	packer.buffer.write((const char*)&record, sizeof(record));
+}
+
+// Packs count updates returned by get(i), either as an array of update maps or as one bin of CompactUpdate records
+template <typename F>
+static MsgId PackUpdateBatch(MsgPacker& packer, bool compact, size_t count, F&& get)
+{
+	if (!compact)
+	{
+		packer.pack_array((uint32_t)count);
+		for (size_t i = 0; i < count; ++i)
+			PackRadarUpdate(packer, get(i));
+		return MsgId::RadarUpdateBatch;
+	}
+
+	packer.packer.pack_bin((uint32_t)(count * sizeof(CompactUpdate)));
+	for (size_t i = 0; i < count; ++i)
+		PackCompactUpdate(packer, get(i));
+	return MsgId::RadarUpdateCompact;
+}
+
 static void PackPartialLocalUpdate(MsgPacker& packer, const LocalAircraft::PlaneUpdateArgs& e)
 {
 	packer.pack(0, e.longitude);
@@ -135,62 +203,282 @@ void WebDriver::OnSimDisconnect()
 	SendSystemState(0);
 }
 
+static void PackRadarRemove(MsgPacker& packer, unsigned int id)
+{
+	packer.pack_map(1);
+	packer.pack(0, id);
+}
+
+static void SendRadarAdd(WebClient& client, const AirplaneRadar::PlaneAddArgs& e)
+{
+	MsgPacker packer;
+	PackRadarAdd(packer, e);
+	webcast.Send(client, MsgId::RadarAddAircraft, packer.view());
+}
+
+static void SendRadarRemove(WebClient& client, unsigned int id)
+{
+	MsgPacker packer;
+	PackRadarRemove(packer, id);
+	webcast.Send(client, MsgId::RadarRemoveAircraft, packer.view());
+}
+
+bool WebDriver::GeoBox::Contains(double latitude, double longitude) const
+{
+	if (latitude < minLatitude || latitude > maxLatitude)
+		return false;
+	if (minLongitude > maxLongitude)
+		return longitude >= minLongitude || longitude <= maxLongitude;
+	return longitude >= minLongitude && longitude <= maxLongitude;
+}
+
+bool WebDriver::IsViewer(WebClient& client)
+{
+	return viewers.contains(client.id);
+}
+
+static bool IsBatched(const WebClient& client)
+{
+	return (client.features & WebDriver::FeatureUpdateBatch) != 0;
+}
+
+static bool IsCompact(const WebClient& client)
+{
+	return (client.features & WebDriver::FeatureCompactUpdate) != 0;
+}
+
+void WebDriver::OnClientClose(WebClient& client)
+{
+	if (IsBatched(client))
+		--batchClients;
+	viewers.erase(client.id);
+	std::erase_if(snapshots, [&](auto& snapshot) { return snapshot.second.client == &client; });
+}
+
 void WebDriver::OnRadarAdd(const AirplaneRadar::PlaneAddArgs& e)
 {
 	MsgPacker packer;
 	PackRadarAdd(packer, e);
-	webcast.Send(MsgId::RadarAddAircraft, packer.view());
+	webcast.Publish(MsgId::RadarAddAircraft, packer.view(), [this](WebClient& client) { return !IsViewer(client); });
+
+	for (auto& [id, viewer] : viewers)
+	{
+		if (viewer.inner.Contains(e.latitude, e.longitude))
+		{
+			viewer.visible.insert(e.id);
+			webcast.Send(*viewer.client, MsgId::RadarAddAircraft, packer.view());
+		}
+	}
 }
 
 void WebDriver::OnRadarRemove(const AirplaneRadar::PlaneRemoveArgs& e)
 {
-	MsgPacker packer;
+	// batched updates of this tick must not arrive after the remove
+	FlushUpdates();
 
-	packer.pack_map(1);
-	packer.pack(0, e.id);
+	MsgPacker packer;
+	PackRadarRemove(packer, e.id);
+	webcast.Publish(MsgId::RadarRemoveAircraft, packer.view(), [this](WebClient& client) { return !IsViewer(client); });
 
-	webcast.Send(MsgId::RadarRemoveAircraft, packer.view());
+	for (auto& [id, viewer] : viewers)
+	{
+		if (viewer.visible.erase(e.id))
+			webcast.Send(*viewer.client, MsgId::RadarRemoveAircraft, packer.view());
+	}
 }
 
 void WebDriver::OnRadarUpdate(const AirplaneRadar::PlaneUpdateArgs& e)
 {
+	ProfileScope scope(profiler, ProfilePhase::WebDriver);
 	MsgPacker packer;
 	PackRadarUpdate(packer, e);
-	webcast.Send(MsgId::RadarUpdateAircraft, packer.view());
+	auto key = WebCast::ConflationKey(MsgId::RadarUpdateAircraft, e.id);
+	webcast.Publish(MsgId::RadarUpdateAircraft, packer.view(), [this](WebClient& client) { return !IsViewer(client) && !IsBatched(client); }, key);
+
+	auto index = (unsigned int)pendingUpdates.size();
+	if (batchClients > 0)
+		pendingUpdates.push_back(e);
+
+	for (auto& [id, viewer] : viewers)
+	{
+		auto i = viewer.visible.find(e.id);
+		if (i != viewer.visible.end())
+		{
+			if (!viewer.outer.Contains(e.latitude, e.longitude))
+			{
+				// leave, dropping batched updates the client would get after the remove
+				std::erase_if(viewer.pending, [&](unsigned int index) { return pendingUpdates[index].id == e.id; });
+				viewer.visible.erase(i);
+				SendRadarRemove(*viewer.client, e.id);
+			}
+			else if (IsBatched(*viewer.client))
+				viewer.pending.push_back(index);
+			else
+				webcast.Send(*viewer.client, MsgId::RadarUpdateAircraft, packer.view(), key);
+		}
+		else if (viewer.inner.Contains(e.latitude, e.longitude))
+		{
+			// enter
+			AirplaneRadar::PlaneAddArgs add;
+			if (radar.GetPlane(e.id, add))
+			{
+				viewer.visible.insert(e.id);
+				SendRadarAdd(*viewer.client, add);
+			}
+		}
+	}
+}
+
+void WebDriver::FlushUpdates()
+{
+	if (pendingUpdates.empty())
+		return;
+
+	auto all = [this](size_t i) -> auto& { return pendingUpdates[i]; };
+
+	bool batch = false;
+	bool compact = false;
+	for (auto& client : webcast.GetClients())
+	{
+		if (IsViewer(client))
+			continue;
+		compact |= IsCompact(client);
+		batch |= IsBatched(client) && !IsCompact(client);
+	}
+
+	MsgPacker packer;
+	if (batch)
+	{
+		auto id = PackUpdateBatch(packer, false, pendingUpdates.size(), all);
+		webcast.Send(id, packer.view(), [this](WebClient& client) { return !IsViewer(client) && IsBatched(client) && !IsCompact(client); });
+	}
+	if (compact)
+	{
+		packer.clear();
+		auto id = PackUpdateBatch(packer, true, pendingUpdates.size(), all);
+		webcast.Send(id, packer.view(), [this](WebClient& client) { return !IsViewer(client) && IsCompact(client); });
+	}
+
+	for (auto& [id, viewer] : viewers)
+	{
+		if (viewer.pending.empty())
+			continue;
+
+		packer.clear();
+		auto msgId = PackUpdateBatch(packer, IsCompact(*viewer.client), viewer.pending.size(), [&](size_t i) -> auto& { return pendingUpdates[viewer.pending[i]]; });
+		webcast.Send(*viewer.client, msgId, packer.view());
+		viewer.pending.clear();
+	}
+
+	pendingUpdates.clear();
+}
+
+void WebDriver::Flush()
+{
+	ProfileScope scope(profiler, ProfilePhase::WebDriver);
+	FlushUpdates();
+
+	auto seq = webcast.GetJournalSeq();
+	if (seq == announcedSeq)
+		return;
+	announcedSeq = seq;
+
+	MsgPacker packer;
+	packer.pack_map(1);
+	packer.pack(0, seq);
+	webcast.Send(MsgId::JournalSeq, packer.view(), [](WebClient& client) { return (client.features & FeatureJournal) != 0; });
+}
+
+static void PackRadarPredict(MsgPacker& packer, const AirplaneRadar::PlanePredictArgs& e, const std::unordered_set<unsigned int>* visible)
+{
+	uint32_t count = 0;
+	if (!visible)
+		count = (uint32_t)e.count;
+	else
+	{
+		for (size_t i = 0; i < e.count; ++i)
+			count += visible->contains(e.planes[i].id);
+	}
+
+	packer.pack_map(2);
+	packer.pack(0, e.timestamp);
+	packer.pack(1);
+	packer.pack_array(count);
+	for (size_t i = 0; i < e.count; ++i)
+	{
+		auto& plane = e.planes[i];
+		if (visible && !visible->contains(plane.id))
+			continue;
+
+		packer.pack_array(5);
+		packer.pack(plane.id);
+		packer.pack(plane.longitude);
+		packer.pack(plane.latitude);
+		packer.pack(plane.heading);
+		packer.pack(plane.altitude);
+	}
+}
+
+void WebDriver::OnRadarPredict(const AirplaneRadar::PlanePredictArgs& e)
+{
+	ProfileScope scope(profiler, ProfilePhase::WebDriver);
+	if (viewers.size() < webcast.GetClients().size())
+	{
+		MsgPacker packer;
+		PackRadarPredict(packer, e, nullptr);
+		webcast.Send(MsgId::RadarPredictAircraft, packer.view(), [this](WebClient& client) { return !IsViewer(client); }, WebCast::ConflationKey(MsgId::RadarPredictAircraft));
+	}
+
+	for (auto& [id, viewer] : viewers)
+	{
+		if (viewer.visible.empty())
+			continue;
+
+		MsgPacker packer;
+		PackRadarPredict(packer, e, &viewer.visible);
+		webcast.Send(*viewer.client, MsgId::RadarPredictAircraft, packer.view(), WebCast::ConflationKey(MsgId::RadarPredictAircraft));
+	}
 }
 
 void WebDriver::OnUserAdd(const LocalAircraft::PlaneAddArgs& e)
 {
 	MsgPacker packer;
 	PackLocalAdd(packer, e);
-	webcast.Send(MsgId::LocalAddAircraft, packer.view());
+	webcast.Publish(MsgId::LocalAddAircraft, packer.view());
 }
 
 void WebDriver::OnUserRemove()
 {
 	MsgPacker packer;
-	webcast.Send(MsgId::LocalRemoveAircraft, packer.view());
+	webcast.Publish(MsgId::LocalRemoveAircraft, packer.view());
 }
 
 void WebDriver::OnUserUpdate(const LocalAircraft::PlaneUpdateArgs& e)
 {
 	MsgPacker packer;
 	PackLocalUpdate(packer, e);
-	webcast.Send(MsgId::LocalUpdateAircraft, packer.view());
+	webcast.Publish(MsgId::LocalUpdateAircraft, packer.view(), {}, WebCast::ConflationKey(MsgId::LocalUpdateAircraft));
 }
 
-void WebDriver::OnRequestSendAllData(const FixedArrayCharS&)
+static void PackAllData(MsgPacker& packer, const std::vector<AirplaneRadar::PlaneAddArgs>& airplanes, const std::optional<LocalAircraft::PlaneAddArgs>& user, const std::unordered_set<unsigned int>* visible)
 {
-	auto airplanes = radar.CreateSnapshot();
-	auto user = aircraft.CreateSnapshot();
+	uint32_t count = 0;
+	if (!visible)
+		count = (uint32_t)airplanes.size();
+	else
+	{
+		for (auto& a : airplanes)
+			count += visible->contains(a.id);
+	}
 
-	MsgPacker packer;
-	packer.pack_map(3);
+	packer.pack_map(4);
 
 	packer.pack(0);
-	packer.pack_array((uint32_t)airplanes.size());
+	packer.pack_array(count);
 	for (auto& a : airplanes)
 	{
+		if (visible && !visible->contains(a.id))
+			continue;
 		PackRadarAdd(packer, a);
 	}
 
@@ -203,78 +491,341 @@ void WebDriver::OnRequestSendAllData(const FixedArrayCharS&)
 	packer.pack(2);
 	SetSystemState(packer, simcom.IsConnected());
 
-	webcast.Send(MsgId::SendAllData, packer.view());
+	packer.pack(3, webcast.GetJournalSeq());
 }
 
-void WebDriver::OnRequestModifySystemState(const FixedArrayCharS& buffer)
+void WebDriver::SendSnapshot(WebClient& client)
 {
-	auto handle = msgpack::unpack(buffer, buffer.size());
-	auto& obj = handle.get();
-	if (obj.type != msgpack::type::MAP)
+	auto viewer = viewers.find(client.id);
+
+	MsgPacker packer;
+	PackAllData(packer, radar.CreateSnapshot(), aircraft.CreateSnapshot(), viewer != viewers.end() ? &viewer->second.visible : nullptr);
+	webcast.Send(client, MsgId::SendAllData, packer.view());
+}
+
+void WebDriver::OnRequestSendAllData(WebClient& client, MsgReader&)
+{
+	// batched updates must not arrive after the snapshot
+	FlushUpdates();
+
+	if ((client.features & FeatureChunkedSnapshot) && !IsViewer(client) && StartChunkedSnapshot(client))
 		return;
+	SendSnapshot(client);
+}
 
-	std::string str;
-	auto& map = obj.via.map;
-	for (auto i = msgpack::begin(map); i != msgpack::end(map); ++i)
+// Radar snapshot owning its strings, so workers can encode it while the radar changes
+struct SnapshotData
+{
+	std::vector<AirplaneRadar::PlaneAddArgs> airplanes;
+	std::string strings;
+};
+
+bool WebDriver::StartChunkedSnapshot(WebClient& client)
+{
+	auto data = std::make_shared<SnapshotData>();
+	data->airplanes = radar.CreateSnapshot();
+	if (data->airplanes.size() <= SnapshotChunkSize)
+		return false;
+
+	size_t length = 0;
+	for (auto& a : data->airplanes)
+		length += a.model.size() + a.callsign.size();
+	data->strings.reserve(length);
+	auto own = [&](std::string_view& str)
+		{
+			auto offset = data->strings.size();
+			data->strings.append(str);
+			str = std::string_view(data->strings.data() + offset, str.size());
+		};
+	for (auto& a : data->airplanes)
 	{
-		auto& key = i->key;
-		if (key.type != msgpack::type::STR)
-			continue;
-		str.clear();
-		key.convert(str);
+		own(a.model);
+		own(a.callsign);
+	}
+
+	auto snapshotId = nextSnapshotId++;
+	auto chunkCount = (data->airplanes.size() + SnapshotChunkSize - 1) / SnapshotChunkSize;
+	auto user = aircraft.CreateSnapshot();
+
+	// {0: snapshot id, 1: chunk count, 2: local aircraft, 3: system state, 4: journal sequence number}
+	MsgPacker packer;
+	packer.pack_map(5);
+	packer.pack(0, snapshotId);
+	packer.pack(1, (uint32_t)chunkCount);
+	packer.pack(2);
+	if (user)
+		PackLocalAdd(packer, *user);
+	else
+		packer.packer.pack_nil();
+	packer.pack(3);
+	SetSystemState(packer, simcom.IsConnected());
+	packer.pack(4, webcast.GetJournalSeq());
+
+	auto& stream = snapshots[snapshotId];
+	stream.client = &client;
+	stream.seq = webcast.GetJournalSeq();
+	stream.chunks.resize(chunkCount);
+	stream.nextChunk = 0;
+	stream.end = WebCast::CreateFrame(MsgId::SnapshotEnd, packer.view());
+
+	for (size_t i = 0; i < chunkCount; ++i)
+	{
+		boost::asio::post(*encoders, [this, data, snapshotId, i]
+			{
+				auto begin = i * SnapshotChunkSize;
+				auto end = std::min(begin + SnapshotChunkSize, data->airplanes.size());
+
+				// {0: snapshot id, 1: chunk index, 2: aircraft}
+				MsgPacker packer;
+				packer.pack_map(3);
+				packer.pack(0, snapshotId);
+				packer.pack(1, (uint32_t)i);
+				packer.pack(2);
+				packer.pack_array((uint32_t)(end - begin));
+				for (auto j = begin; j < end; ++j)
+					PackRadarAdd(packer, data->airplanes[j]);
+
+				auto frame = WebCast::CreateFrame(MsgId::SnapshotChunk, packer.view());
+				thread.Post([this, snapshotId, i, frame] { OnSnapshotChunk(snapshotId, i, frame); });
+			});
+	}
+	return true;
+}
+
+void WebDriver::OnSnapshotChunk(unsigned int snapshotId, size_t index, const SharedBuffer& frame)
+{
+	auto i = snapshots.find(snapshotId);
+	if (i == snapshots.end())
+		return;
+
+	auto& stream = i->second;
+	stream.chunks[index] = frame;
+	while (stream.nextChunk < stream.chunks.size() && !stream.chunks[stream.nextChunk].empty())
+	{
+		webcast.Send(*stream.client, stream.chunks[stream.nextChunk]);
+		stream.chunks[stream.nextChunk++] = {};
+	}
+	if (stream.nextChunk < stream.chunks.size())
+		return;
+
+	auto& client = *stream.client;
+	auto seq = stream.seq;
+	webcast.Send(client, stream.end);
+	snapshots.erase(i);
 
-		auto& value = i->val;
-		if (str == "0")
+	// changes made while the chunks were encoded and sent, ordered after the snapshot
+	if (!webcast.Replay(client, seq))
+		SendSnapshot(client);
+}
+
+void WebDriver::OnRequestResyncSince(WebClient& client, MsgReader& reader)
+{
+	// {0: last journal sequence number the client has seen}
+	unsigned long long seq = 0;
+	bool known = false;
+	reader.ForEachField([&](int key, MsgReader& value)
 		{
-			if (value.type == msgpack::type::BOOLEAN)
+			if (key == 0)
+				known = value.ReadUInt(seq);
+		});
+
+	FlushUpdates();
+
+	// the journal holds the full stream, a viewport client gets a filtered snapshot instead
+	if (!known || IsViewer(client) || !webcast.Replay(client, seq))
+	{
+		SendSnapshot(client);
+		return;
+	}
+
+	MsgPacker packer;
+	packer.pack_map(1);
+	packer.pack(0, webcast.GetJournalSeq());
+	webcast.Send(client, MsgId::JournalSeq, packer.view());
+}
+
+void WebDriver::OnRequestModifySystemState(WebClient&, MsgReader& reader)
+{
+	reader.ForEachField([](int key, MsgReader& value)
+		{
+			bool v;
+			if (key != 0 || !value.ReadBool(v))
+				return;
+
+			if (v)
 			{
-				bool v = value.as<bool>();
-				if (v)
-				{
-					if (simcom.IsConnected())
-						SendSystemState();
-					else
-						simcom.Initialize();
-				}
+				if (simcom.IsConnected())
+					SendSystemState();
 				else
-				{
-					if (simcom.IsConnected())
-						simcom.Shutdown();
-					else
-						SendSystemState();
-				}
+					simcom.Initialize();
 			}
-		}
-	}
+			else
+			{
+				if (simcom.IsConnected())
+					simcom.Shutdown();
+				else
+					SendSystemState();
+			}
+		});
 }
 
-void WebDriver::OnRequestModifySystemProperties(const FixedArrayCharS& buffer)
+void WebDriver::OnRequestModifySystemProperties(WebClient&, MsgReader& reader)
 {
 	/*
-	auto handle = msgpack::unpack(buffer, buffer.size());
-	auto& obj = handle.get();
-	if (obj.type != msgpack::type::MAP)
+	reader.ForEachField([](int key, MsgReader& value)
+		{
+			bool v;
+			if (key == 0 && value.ReadBool(v))
+				simcom.AllowReconnect(v);
+		});
+	*/
+}
+
+void WebDriver::OnRequestSubscribeViewport(WebClient& client, MsgReader& reader)
+{
+	// {0: min latitude, 1: min longitude, 2: max latitude, 3: max longitude, 4: zoom}, nil or empty - unsubscribe
+	double values[5]{ NAN, NAN, NAN, NAN, 0 };
+	reader.ForEachField([&](int key, MsgReader& value)
+		{
+			if (key < 5)
+				value.ReadNumber(values[key]);
+		});
+
+	bool subscribe = !std::isnan(values[0]) && !std::isnan(values[1]) && !std::isnan(values[2]) && !std::isnan(values[3]) &&
+		values[0] <= values[2];
+	auto i = viewers.find(client.id);
+
+	if (!subscribe)
+	{
+		if (i == viewers.end())
+			return;
+
+		// back to the full stream - add everything the client does not have yet
+		auto& visible = i->second.visible;
+		for (auto& a : radar.CreateSnapshot())
+		{
+			if (!visible.contains(a.id))
+				SendRadarAdd(client, a);
+		}
+		viewers.erase(i);
 		return;
+	}
 
-	std::string str;
-	auto& map = obj.via.map;
-	for (auto i = msgpack::begin(map); i != msgpack::end(map); ++i)
+	if (i == viewers.end())
 	{
-		auto& key = i->key;
-		if (key.type != msgpack::type::STR)
-			continue;
-		str.clear();
-		key.convert(str);
+		i = viewers.emplace(client.id, Viewer{ &client }).first;
 
-		auto& value = i->val;
-		if (str == "0")
+		// client had the full stream so far
+		for (auto& a : radar.CreateSnapshot())
+			i->second.visible.insert(a.id);
+	}
+
+	auto& viewer = i->second;
+	auto normalize = [](double longitude)
 		{
-			if (value.type == msgpack::type::BOOLEAN)
-			{
-				bool v = value.as<bool>();
-				simcom.AllowReconnect(v);
-			}
+			return std::remainder(longitude, 360.0);
+		};
+
+	viewer.inner.minLatitude = std::max(values[0], -90.0);
+	viewer.inner.maxLatitude = std::min(values[2], 90.0);
+	viewer.inner.minLongitude = normalize(values[1]);
+	viewer.inner.maxLongitude = normalize(values[3]);
+	viewer.zoom = values[4];
+
+	auto spanLatitude = viewer.inner.maxLatitude - viewer.inner.minLatitude;
+	auto spanLongitude = viewer.inner.maxLongitude - viewer.inner.minLongitude;
+	if (spanLongitude < 0)
+		spanLongitude += 360.0;
+	auto marginLatitude = std::max(spanLatitude * 0.1, 0.05);
+	auto marginLongitude = std::max(spanLongitude * 0.1, 0.05);
+
+	viewer.outer.minLatitude = std::max(viewer.inner.minLatitude - marginLatitude, -90.0);
+	viewer.outer.maxLatitude = std::min(viewer.inner.maxLatitude + marginLatitude, 90.0);
+	if (spanLongitude + marginLongitude * 2 >= 360.0)
+	{
+		viewer.outer.minLongitude = -180.0;
+		viewer.outer.maxLongitude = 180.0;
+	}
+	else
+	{
+		viewer.outer.minLongitude = normalize(viewer.inner.minLongitude - marginLongitude);
+		viewer.outer.maxLongitude = normalize(viewer.inner.maxLongitude + marginLongitude);
+	}
+
+	// leave - visible aircraft outside the margin
+	std::vector<unsigned int> ids;
+	radar.FindInBox(viewer.outer.minLatitude, viewer.outer.minLongitude, viewer.outer.maxLatitude, viewer.outer.maxLongitude, ids);
+	std::unordered_set<unsigned int> kept(ids.begin(), ids.end());
+	for (auto j = viewer.visible.begin(); j != viewer.visible.end();)
+	{
+		if (kept.contains(*j))
+			++j;
+		else
+		{
+			SendRadarRemove(client, *j);
+			j = viewer.visible.erase(j);
 		}
 	}
-	*/
+
+	// enter - aircraft inside the viewport the client does not have
+	ids.clear();
+	radar.FindInBox(viewer.inner.minLatitude, viewer.inner.minLongitude, viewer.inner.maxLatitude, viewer.inner.maxLongitude, ids);
+	for (auto id : ids)
+	{
+		AirplaneRadar::PlaneAddArgs add;
+		if (!viewer.visible.contains(id) && radar.GetPlane(id, add))
+		{
+			viewer.visible.insert(id);
+			SendRadarAdd(client, add);
+		}
+	}
+}
+
+void WebDriver::OnRequestModifyClientFeatures(WebClient& client, MsgReader& reader)
+{
+	// {0: requested feature bits}, answered with the accepted subset
+	unsigned long long requested = 0;
+	reader.ForEachField([&](int key, MsgReader& value)
+		{
+			if (key == 0)
+				value.ReadUInt(requested);
+		});
+
+	FlushUpdates();
+	if (IsBatched(client))
+		--batchClients;
+
+	client.features = (unsigned int)(requested & SupportedFeatures);
+	if (IsCompact(client))
+		client.features |= FeatureUpdateBatch;
+	if (IsBatched(client))
+		++batchClients;
+
+	MsgPacker packer;
+	packer.pack_map(1);
+	packer.pack(0, client.features);
+	webcast.Send(client, MsgId::ModifyClientFeatures, packer.view());
+}
+
+void WebDriver::OnRequestTraceCapture(WebClient& client, MsgReader& reader)
+{
+	// {0: capture on/off}, answered with {0: capturing, 1: size of the last trace}; the trace is served on GET /trace
+	reader.ForEachField([](int key, MsgReader& value)
+		{
+			bool v;
+			if (key != 0 || !value.ReadBool(v))
+				return;
+
+			if (v)
+				Trace::Start();
+			else
+				Trace::Stop();
+		});
+
+	auto last = Trace::GetLast();
+	MsgPacker packer;
+	packer.pack_map(2);
+	packer.pack(0, Trace::IsRunning());
+	packer.pack(1, last ? last->size() : 0);
+	webcast.Send(client, MsgId::TraceCapture, packer.view());
 }
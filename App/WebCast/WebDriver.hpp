@@ -1,20 +1,92 @@
 #pragma once
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
 #include "TrafficRadar/AirplaneRadar.h"
 #include "TrafficRadar/LocalAircraft.h"
 #include "Utils/FixedArray.h"
+#include "Utils/SharedBuffer.h"
+
+struct WebClient;
+class MsgReader;
+namespace boost::asio { class thread_pool; }
 
 class WebDriver
 {
+public:
+	// WebClient::features bits, values are part of the protocol: 1, 2, 4 and 8
+	enum ClientFeature : unsigned int
+	{
+		FeatureUpdateBatch = 1 << 0, // radar updates of one tick in a single RadarUpdateBatch
+		FeatureCompactUpdate = 1 << 1, // batches as fixed-point RadarUpdateCompact records, implies FeatureUpdateBatch
+		FeatureJournal = 1 << 2, // JournalSeq after each tick that changed state, for ResyncSince after a reconnect
+		FeatureChunkedSnapshot = 1 << 3, // large SendAllData answered with SnapshotChunk frames and a SnapshotEnd
+	};
+	static constexpr unsigned int SupportedFeatures = FeatureUpdateBatch | FeatureCompactUpdate | FeatureJournal | FeatureChunkedSnapshot;
+
 private:
+	struct GeoBox
+	{
+		double minLatitude;
+		double minLongitude; // may be greater than maxLongitude when crossing the antimeridian
+		double maxLatitude;
+		double maxLongitude;
+
+		bool Contains(double latitude, double longitude) const;
+	};
+
+	// Client subscribed to a map viewport. Aircraft enter when inside 'inner'
+	// and leave once outside 'outer' (viewport plus margin), so edge traffic does not flicker.
+	struct Viewer
+	{
+		WebClient* client;
+		GeoBox inner;
+		GeoBox outer;
+		double zoom;
+		std::unordered_set<unsigned int> visible;
+		std::vector<unsigned int> pending; // indices into pendingUpdates
+	};
+	std::unordered_map<unsigned int, Viewer> viewers; // by WebClient::id
+
+	std::vector<AirplaneRadar::PlaneUpdateArgs> pendingUpdates; // collected for batching clients during a tick
+	unsigned int batchClients;
+	unsigned long long announcedSeq; // last JournalSeq sent
+
+	// Snapshot encoded in chunks on the worker pool and streamed to one client in chunk order
+	struct SnapshotStream
+	{
+		WebClient* client;
+		unsigned long long seq; // journal position the snapshot was taken at
+		std::vector<SharedBuffer> chunks; // frames, empty until encoded or once sent
+		size_t nextChunk;
+		SharedBuffer end;
+	};
+	std::unordered_map<unsigned int, SnapshotStream> snapshots; // by snapshot id
+	unsigned int nextSnapshotId;
+	std::unique_ptr<boost::asio::thread_pool> encoders;
+
+	bool StartChunkedSnapshot(WebClient&);
+	void OnSnapshotChunk(unsigned int snapshotId, size_t index, const SharedBuffer& frame);
+
+	void OnClientClose(WebClient&);
+	bool IsViewer(WebClient&);
+	void SendSnapshot(WebClient&);
+	void FlushUpdates();
+
 	void OnRadarAdd(const AirplaneRadar::PlaneAddArgs&);
 	void OnRadarRemove(const AirplaneRadar::PlaneRemoveArgs&);
 	void OnRadarUpdate(const AirplaneRadar::PlaneUpdateArgs&);
+	void OnRadarPredict(const AirplaneRadar::PlanePredictArgs&);
 	void OnUserAdd(const LocalAircraft::PlaneAddArgs&);
 	void OnUserRemove();
 	void OnUserUpdate(const LocalAircraft::PlaneUpdateArgs&);
-	void OnRequestSendAllData(const FixedArrayCharS&);
-	void OnRequestModifySystemState(const FixedArrayCharS&);
-	void OnRequestModifySystemProperties(const FixedArrayCharS&);
+	void OnRequestSendAllData(WebClient&, MsgReader&);
+	void OnRequestModifySystemState(WebClient&, MsgReader&);
+	void OnRequestModifySystemProperties(WebClient&, MsgReader&);
+	void OnRequestSubscribeViewport(WebClient&, MsgReader&);
+	void OnRequestModifyClientFeatures(WebClient&, MsgReader&);
+	void OnRequestResyncSince(WebClient&, MsgReader&);
+	void OnRequestTraceCapture(WebClient&, MsgReader&);
 
 public:
 	WebDriver();
@@ -23,4 +95,5 @@ public:
 	void Initialize();
 	void OnSimConnect();
 	void OnSimDisconnect();
+	void Flush(); // end of tick - batched updates and the journal position
 };
@@ -1,25 +1,54 @@
+#include <charconv>
+#include <fstream>
 #include <iostream>
 #include <string>
 #include "SimCom/SimCom.h"
+#include "SimCom/StandInTransport.h"
+#include "App/NetworkPool.h"
 #include "App/RealTimeThread.h"
 #include "TrafficRadar/LocalAircraft.h"
 #include "TrafficRadar/AirplaneRadar.h"
 #include "WebCast/WebCast.hpp"
 #include "WebCast/WebDriver.hpp"
 #include "Utils/Logger.h"
+#include "Utils/Profiler.h"
+#include "Utils/Trace.h"
 #include "Utils/version.h"
 
 SimCom simcom;
 LocalAircraft aircraft;
 AirplaneRadar radar;
 RealTimeThread thread;
+NetworkPool network;
 WebCast webcast;
 WebDriver webdriver;
+Profiler profiler;
 
 static void OnTick()
 {
+	{
+		ProfileScope tick(profiler, ProfilePhase::Tick);
+		{
+			ProfileScope scope(profiler, ProfilePhase::SimCallbacks);
+			simcom.RunCallbacks();
+		}
+		{
+			ProfileScope scope(profiler, ProfilePhase::RadarUpdate);
+			TRACE_SCOPE("radar.update");
+			radar.OnUpdate();
+		}
+		TRACE_SCOPE("webdriver.flush");
+		webdriver.Flush();
+	}
+	profiler.EndTick();
+}
+
+// SimConnect data arrived between ticks: deliver it now, radar and flush stay on the tick grid.
+// Counted with the next tick's callbacks in the profile.
+static void OnWakeup()
+{
+	ProfileScope scope(profiler, ProfilePhase::SimCallbacks);
 	simcom.RunCallbacks();
-	radar.OnUpdate();
 }
 
 static void OnSimConnect()
@@ -62,6 +91,159 @@ static void GetArguments(const std::string& line, std::string_view& cmd, std::st
 		cmd = line;
 }
 
+template <typename T>
+static bool ParseNumber(std::string_view& args, T& value)
+{
+	while (!args.empty() && args.front() == ' ')
+		args.remove_prefix(1);
+	if (args.empty())
+		return false;
+
+	auto result = std::from_chars(args.data(), args.data() + args.size(), value);
+	args.remove_prefix(result.ptr - args.data());
+	return result.ec == std::errc();
+}
+
+static void StartStandIn(std::string_view args)
+{
+	SimConnect::StandInTransport::Scenario scenario;
+	unsigned int quitAfter = 0;
+	ParseNumber(args, scenario.objectCount) &&
+		ParseNumber(args, scenario.spawnRate) &&
+		ParseNumber(args, scenario.churnRate) &&
+		ParseNumber(args, scenario.dataRate) &&
+		ParseNumber(args, scenario.helicopterRatio) &&
+		ParseNumber(args, scenario.spread) &&
+		ParseNumber(args, quitAfter);
+	scenario.quitAfter = quitAfter * 1000ll;
+
+	thread.Post([scenario]()
+		{
+			Logger::Log("Starting simulator stand-in: {} objects, spawn {}/s, churn {}/s, data {}Hz, helicopter every {}, spread {} deg, quit after {} s",
+				scenario.objectCount, scenario.spawnRate, scenario.churnRate, scenario.dataRate, scenario.helicopterRatio, scenario.spread, scenario.quitAfter / 1000);
+			simcom.SetTransport(std::make_unique<SimConnect::StandInTransport>(scenario));
+			simcom.Initialize();
+		});
+}
+
+static void SetTracking(std::string_view args)
+{
+	auto mode = AirplaneRadar::TrackingMode::PerObject;
+	if (args.starts_with("sweep"))
+	{
+		mode = AirplaneRadar::TrackingMode::Sweep;
+		args.remove_prefix(5);
+	}
+	else if (!args.starts_with("object"))
+	{
+		Logger::Log("Tracking mode: {}", radar.GetTrackingMode() == AirplaneRadar::TrackingMode::Sweep ? "sweep" : "object");
+		return;
+	}
+
+	unsigned int interval = 1000;
+	ParseNumber(args, interval);
+
+	thread.Post([mode, interval]()
+		{
+			radar.SetTrackingMode(mode, interval);
+		});
+}
+
+static void SetPrediction(std::string_view args)
+{
+	unsigned int rate = 0, alpha = 0, beta = 10;
+	ParseNumber(args, rate);
+	bool smoothing = ParseNumber(args, alpha);
+	ParseNumber(args, beta);
+
+	thread.Post([rate, smoothing, alpha, beta]()
+		{
+			radar.SetPrediction(rate, smoothing, alpha / 100.0, beta / 100.0);
+		});
+}
+
+static void ShowTickStats(std::string_view args)
+{
+	unsigned int rate = 0;
+	bool setRate = ParseNumber(args, rate);
+
+	while (!args.empty() && args.front() == ' ')
+		args.remove_prefix(1);
+	bool setPolicy = true;
+	auto policy = RealTimeThread::OverrunPolicy::Skip;
+	if (args.starts_with("catchup"))
+		policy = RealTimeThread::OverrunPolicy::CatchUp;
+	else if (!args.starts_with("skip"))
+		setPolicy = false;
+
+	thread.Post([setRate, rate, setPolicy, policy]()
+		{
+			if (setRate)
+				thread.SetRate(rate);
+			if (setPolicy)
+				thread.SetOverrunPolicy(policy);
+			if (setRate || setPolicy)
+				thread.ResetStats();
+
+			auto& stats = thread.GetStats();
+			auto policyName = thread.GetOverrunPolicy() == RealTimeThread::OverrunPolicy::CatchUp ? "catch up" : "skip";
+			Logger::Log("Tick: {} Hz, {} ticks, {} wakeups, {} skipped, {} overruns ({} late ticks)", thread.GetRate(), stats.ticks, stats.wakeups,
+				stats.skippedTicks, stats.overruns, policyName);
+			Logger::Log(" - duration us: p50 {}, p99 {}, max {}", stats.duration.GetPercentile(50), stats.duration.GetPercentile(99), stats.duration.GetMax());
+			Logger::Log(" - lateness us: p50 {}, p99 {}, max {}", stats.lateness.GetPercentile(50), stats.lateness.GetPercentile(99), stats.lateness.GetMax());
+		});
+}
+
+static void ShowProfile()
+{
+	auto stats = profiler.GetSnapshot();
+	Logger::Log("Tick phases, last {} s, us per tick:", stats.seconds);
+	for (size_t i = 0; i < Profiler::PhaseCount; ++i)
+	{
+		auto& phase = stats.phases[i];
+		Logger::Log(" - {}: {} ticks, p50 {}, p99 {}, max {}, mean {:.1f}", Profiler::GetName((ProfilePhase)i), phase.ticks, phase.p50, phase.p99, phase.max, phase.mean);
+	}
+}
+
+static void SetTrace(std::string_view args)
+{
+#ifndef TRACE_ENABLE
+	Logger::LogWarn("Trace: built without TRACE_ENABLE, no events are recorded");
+#endif
+	if (args.starts_with("start"))
+	{
+		Trace::Start();
+		Logger::Log("Trace: capturing");
+		return;
+	}
+	if (!args.starts_with("stop"))
+	{
+		Logger::Log("Trace: {}", Trace::IsRunning() ? "capturing" : "stopped");
+		return;
+	}
+
+	args.remove_prefix(4);
+	while (!args.empty() && args.front() == ' ')
+		args.remove_prefix(1);
+	std::string path = args.empty() ? "trace.json" : std::string(args);
+
+	auto trace = Trace::Stop();
+	if (!trace)
+	{
+		Logger::Log("Trace: nothing captured");
+		return;
+	}
+
+	std::ofstream file(path, std::ios::binary);
+	file << *trace;
+	if (!file)
+	{
+		Logger::LogError("Trace: can not write {}", path);
+		return;
+	}
+	Logger::Log("Trace: {} KB written to {}, open it in ui.perfetto.dev", trace->size() / 1024, path);
+}
+
 static void CommandLoop()
 {
 	std::string line;
@@ -75,10 +257,31 @@ static void CommandLoop()
 
 		if (cmd == "stop" || cmd == "exit" || cmd == "quit")
 			return;
+		else if (cmd == "standin")
+			StartStandIn(args);
+		else if (cmd == "tracking")
+			SetTracking(args);
+		else if (cmd == "predict")
+			SetPrediction(args);
+		else if (cmd == "net")
+			webcast.LogNetworkStats();
+		else if (cmd == "tick")
+			ShowTickStats(args);
+		else if (cmd == "stats")
+			ShowProfile();
+		else if (cmd == "trace")
+			SetTrace(args);
 		else if (cmd == "help")
 		{
 			Logger::Log("Available commands:");
 			Logger::Log(" - stop - stops app");
+			Logger::Log(" - standin [objects] [spawn/s] [churn/s] [data Hz] [heli every n] [spread deg] [quit s] - replaces simulator with a scripted stand-in");
+			Logger::Log(" - tracking [object|sweep] [interval ms] - radar polling: request per aircraft or by-type sweeps");
+			Logger::Log(" - predict [Hz] [alpha %] [beta %] - stream predicted radar positions (5-20 Hz, 0 - off), alpha enables smoothing");
+			Logger::Log(" - net - HTTP and WebSocket connection counters");
+			Logger::Log(" - tick [Hz] [skip|catchup] - tick duration and lateness, optionally changes the tick rate and what happens to ticks missed by an overrun");
+			Logger::Log(" - stats - time per tick in simconnect, radar, webdriver and socket sends (also GET /stats)");
+			Logger::Log(" - trace [start|stop [file]] - captures a Chrome/Perfetto timeline of all threads (also GET /trace)");
 		}
 	}
 }
@@ -88,17 +291,22 @@ int main()
 	simcom.OnConnect = &OnSimConnect;
 	simcom.OnDisconnect = &OnSimDisconnect;
 	thread.Tick = &OnTick;
+	thread.Wakeup = &OnWakeup;
+	simcom.SetDataPendingCallback([]() { thread.Wake(); });
 
 	Logger::SetConsoleOut(true);
 	Logger::SetTimestamp(false);
 	Logger::Log(Version::Title);
 
+	network.Start();
 	webdriver.Initialize();
 	webcast.Start();
 	thread.Start();
 
 	CommandLoop();
 	
+	network.Stop();
+	network.Wait();
 	thread.Stop();
 	thread.Wait();
 	simcom.Shutdown();
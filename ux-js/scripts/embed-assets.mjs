@@ -0,0 +1,104 @@
+// Packs the built client (dist) into one blob linked into the App executable, plus a header with
+// the index: url path -> offset/size of the identity and gzip variants and their ETags.
+//
+// usage: node scripts/embed-assets.mjs <dist dir> <output dir> [url base, default /Mapleberry/]
+// writes <output dir>/EmbeddedAssets.bin and <output dir>/EmbeddedAssets.h, see App/WebCast/AssetCache.cpp
+
+import { createHash } from 'node:crypto';
+import { existsSync, mkdirSync, readdirSync, readFileSync, writeFileSync } from 'node:fs';
+import { extname, join, relative, sep } from 'node:path';
+import { constants, gzipSync } from 'node:zlib';
+
+const [distDir, outDir, base = '/Mapleberry/'] = process.argv.slice(2);
+if (!distDir || !outDir) {
+  console.error('usage: embed-assets.mjs <dist dir> <output dir> [url base]');
+  process.exit(1);
+}
+
+const compressible = new Set(['.html', '.htm', '.js', '.mjs', '.css', '.json', '.map', '.txt', '.svg', '.wasm']);
+const minCompressSize = 256;
+const alignment = 16;
+
+function listFiles(dir) {
+  return readdirSync(dir, { withFileTypes: true }).flatMap((entry) => {
+    const path = join(dir, entry.name);
+    return entry.isDirectory() ? listFiles(path) : entry.isFile() ? [path] : [];
+  });
+}
+
+function etag(data, suffix) {
+  const hash = createHash('sha1').update(data).digest('hex').slice(0, 16);
+  return `"${hash}-${data.length.toString(16)}${suffix}"`;
+}
+
+// keeps the mtime of unchanged outputs so the App build does not recompile them
+function writeIfChanged(path, data) {
+  if (!existsSync(path) || !readFileSync(path).equals(data))
+    writeFileSync(path, data);
+}
+
+function cString(str) {
+  return '"' + str.replace(/[\\"]/g, (c) => '\\' + c) + '"';
+}
+
+const files = listFiles(distDir).sort();
+if (files.length === 0) {
+  console.error(`embed-assets: no files in ${distDir}, build the client first`);
+  process.exit(1);
+}
+
+const parts = [];
+let blobSize = 0;
+const append = (data) => {
+  const padding = (alignment - (blobSize % alignment)) % alignment;
+  if (padding)
+    parts.push(Buffer.alloc(padding));
+  const offset = blobSize + padding;
+  parts.push(data);
+  blobSize = offset + data.length;
+  return offset;
+};
+
+const entries = files.map((file) => {
+  const content = readFileSync(file);
+  const path = base.replace(/\/?$/, '/') + relative(distDir, file).split(sep).join('/');
+  const entry = {
+    path,
+    offset: append(content),
+    size: content.length,
+    gzipOffset: 0,
+    gzipSize: 0,
+    etag: etag(content, ''),
+    gzipEtag: '',
+  };
+
+  if (content.length >= minCompressSize && compressible.has(extname(file).toLowerCase())) {
+    const gzip = gzipSync(content, { level: constants.Z_BEST_COMPRESSION });
+    if (gzip.length < content.length * 9 / 10) {
+      entry.gzipOffset = append(gzip);
+      entry.gzipSize = gzip.length;
+      entry.gzipEtag = etag(content, '-gz');
+    }
+  }
+  return entry;
+});
+
+const header = [
+  '// Generated by ux-js/scripts/embed-assets.mjs, do not edit',
+  '#pragma once',
+  '',
+  `static constexpr size_t EmbeddedBlobSize = ${blobSize};`,
+  '',
+  'static constexpr AssetCache::EmbeddedAsset EmbeddedAssets[] =',
+  '{',
+  ...entries.map((e) => `\t{ ${cString(e.path)}, ${e.offset}, ${e.size}, ${e.gzipOffset}, ${e.gzipSize}, ${cString(e.etag)}, ${cString(e.gzipEtag)} },`),
+  '};',
+  '',
+].join('\n');
+
+mkdirSync(outDir, { recursive: true });
+writeIfChanged(join(outDir, 'EmbeddedAssets.bin'), Buffer.concat(parts));
+writeIfChanged(join(outDir, 'EmbeddedAssets.h'), Buffer.from(header));
+
+const compressed = entries.reduce((sum, e) => sum + (e.gzipSize || e.size), 0);
+console.log(`embed-assets: ${entries.length} files, ${Math.round(blobSize / 1024)} KB blob, ${Math.round(compressed / 1024)} KB served compressed`);
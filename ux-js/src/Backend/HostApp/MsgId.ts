@@ -10,6 +10,16 @@ export enum MsgId {
     LocalAddAircraft = 7,
     LocalRemoveAircraft = 8,
     LocalUpdateAircraft = 9,
+    RadarPredictAircraft = 10,
+    SubscribeViewport = 11,
+    RadarUpdateBatch = 12,
+    ModifyClientFeatures = 13,
+    RadarUpdateCompact = 14,
+    ResyncSince = 15,
+    JournalSeq = 16,
+    SnapshotChunk = 17,
+    SnapshotEnd = 18,
+    TraceCapture = 19,
 
     _last,
 };